@@ -0,0 +1,565 @@
+/* TN5250 - An implementation of the 5250 telnet protocol.
+ * Copyright (C) 1997-2008 Michael Madore
+ *
+ * This file is part of TN5250.
+ *
+ * TN5250 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1, or (at your option)
+ * any later version.
+ *
+ * TN5250 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307 USA
+ *
+ */
+
+/* scsbench - measure how fast the SCS converters turn print jobs into
+ * text, PostScript and PDF, as lp5250d does for every job.
+ *
+ *    scsbench [-n ITERATIONS] [-p PAGES] [-w SUMFILE | -c SUMFILE]
+ *             [SPOOLFILE...]
+ *
+ * Each SPOOLFILE is the SCS data of one print job, such as a .job file
+ * from lp5250d's spooldir= (see tn5250rc(5)).  With no spool files, a job
+ * of PAGES pages is made up instead, using the commands the host sends
+ * most: changes of CPI and LPI, absolute positioning, transparent data
+ * and bold done by printing over text again.
+ *
+ * A checksum of each converter's output is printed with its speed.  -w
+ * saves them in SUMFILE, and -c compares them with SUMFILE and fails if
+ * any differ, so that a converter can be made faster without changing
+ * what it prints.  The checksums depend on the jobs, so use the same
+ * arguments for both. */
+
+#include "tn5250-private.h"
+#include "scs-private.h"
+#include <time.h>
+
+#define MAX_JOBS 256
+
+/* lp5250d hands the converters a record at a time, and records are a few
+ * kilobytes, so the jobs are fed to them in pieces of this size. */
+#define RECORD_SIZE 4096
+
+typedef struct _bench_job {
+    const char* name;
+    unsigned char* data;
+    int len;
+    int pages;
+} bench_job;
+
+typedef struct _bench_converter {
+    const char* label;
+    const char* name;
+    int compress; /* scs2pdf -z */
+} bench_converter;
+
+static const bench_converter converters[] = {
+    { "scs2ascii", "scs2ascii", 0 },
+    { "scs2ps", "scs2ps", 0 },
+    { "scs2pdf", "scs2pdf", 0 },
+#ifdef HAVE_LIBZ
+    { "scs2pdf -z", "scs2pdf", 1 },
+#endif
+};
+
+#define CONVERTER_COUNT (sizeof(converters) / sizeof(converters[0]))
+
+static bench_job jobs[MAX_JOBS];
+static int job_count = 0;
+static int pages_counted = 0;
+static unsigned long random_state = 1;
+static int saved_stderr = -1;
+
+static void add_job(const char* name, unsigned char* data, int len);
+static int load_job(const char* filename);
+static void make_job(int pages);
+static unsigned long next_random(int limit);
+static void count_page(Tn5250SCS* This);
+static void quiet(int on);
+static void convert(const bench_converter* conv, bench_job* job, FILE* out);
+static unsigned long checksum(const bench_converter* conv);
+static int bench_scs(int iterations, const char* writesums,
+                     const char* checksums);
+
+int main(int argc, char* argv[]) {
+    const char* writesums = NULL;
+    const char* checksums = NULL;
+    int iterations = 20;
+    int pages = 100;
+    int i = 1;
+    int ret;
+
+    while (i + 1 < argc && argv[i][0] == '-') {
+        if (strcmp(argv[i], "-n") == 0) {
+            iterations = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-p") == 0) {
+            pages = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-w") == 0) {
+            writesums = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-c") == 0) {
+            checksums = argv[i + 1];
+        }
+        else {
+            break;
+        }
+        i += 2;
+    }
+    if (iterations <= 0 || pages <= 0 || (i < argc && argv[i][0] == '-')) {
+        fprintf(stderr, "usage: scsbench [-n ITERATIONS] [-p PAGES] "
+                        "[-w SUMFILE | -c SUMFILE] [SPOOLFILE...]\n");
+        return 1;
+    }
+
+    /* The converters translate with the map named here, which would
+     * change the checksums. */
+    setenv("TN5250_CCSIDMAP", "37", 1);
+    if ((saved_stderr = dup(2)) == -1) {
+        perror("dup");
+        return 1;
+    }
+
+    for (; i < argc; i++) {
+        if (load_job(argv[i]) == -1) {
+            return 1;
+        }
+    }
+    if (job_count == 0) {
+        make_job(pages);
+    }
+
+    ret = bench_scs(iterations, writesums, checksums);
+
+    for (i = 0; i < job_count; i++) {
+        free(jobs[i].data);
+    }
+    return ret;
+}
+
+/****i* bench/add_job
+ * NAME
+ *    add_job
+ * SYNOPSIS
+ *    add_job (name, data, len);
+ * INPUTS
+ *    const char *         name       -
+ *    unsigned char *      data       - Taken over by the job.
+ *    int                  len        -
+ * DESCRIPTION
+ *    Keep a job to run the benchmark over, and count its pages.
+ *****/
+static void add_job(const char* name, unsigned char* data, int len) {
+    Tn5250SCS* scs;
+    FILE* out;
+
+    if (job_count == MAX_JOBS) {
+        free(data);
+        return;
+    }
+
+    /* The pages are whatever the parser takes to be form feeds. */
+    pages_counted = 0;
+    if ((out = fopen("/dev/null", "w")) != NULL) {
+        quiet(1);
+        scs = tn5250_scs_new();
+        scs->output = out;
+        scs->ff = count_page;
+        scs->rff = count_page;
+        tn5250_scs_begin(scs);
+        tn5250_scs_feed(scs, data, len);
+        tn5250_scs_end(scs);
+        tn5250_scs_destroy(scs);
+        fclose(out);
+        quiet(0);
+    }
+
+    jobs[job_count].name = name;
+    jobs[job_count].data = data;
+    jobs[job_count].len = len;
+    jobs[job_count].pages = pages_counted > 0 ? pages_counted : 1;
+    job_count++;
+    return;
+}
+
+static void count_page(Tn5250SCS* This) {
+    pages_counted++;
+    return;
+}
+
+/****i* bench/quiet
+ * NAME
+ *    quiet
+ * SYNOPSIS
+ *    quiet (on);
+ * INPUTS
+ *    int                  on         -
+ * DESCRIPTION
+ *    Send stderr to /dev/null while on is set.  The converters write
+ *    debugging output there, such as every transparent data command,
+ *    which would swamp the report.
+ *****/
+static void quiet(int on) {
+    int fd;
+
+    fflush(stderr);
+    if (!on) {
+        dup2(saved_stderr, 2);
+    }
+    else if ((fd = open("/dev/null", O_WRONLY)) != -1) {
+        dup2(fd, 2);
+        close(fd);
+    }
+    return;
+}
+
+/****i* bench/load_job
+ * NAME
+ *    load_job
+ * SYNOPSIS
+ *    ret = load_job (filename);
+ * INPUTS
+ *    const char *         filename   - A spooled SCS print job.
+ * DESCRIPTION
+ *    Read a spool file into memory.  Returns -1 if it can't be read.
+ *****/
+static int load_job(const char* filename) {
+    Tn5250Buffer buffer;
+    unsigned char chunk[8192];
+    FILE* f;
+    size_t n;
+
+    if ((f = fopen(filename, "rb")) == NULL) {
+        fprintf(stderr, "scsbench: can't open %s\n", filename);
+        return -1;
+    }
+    tn5250_buffer_init(&buffer);
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        tn5250_buffer_append_data(&buffer, chunk, (int)n);
+    }
+    fclose(f);
+
+    if (buffer.len == 0) {
+        fprintf(stderr, "scsbench: %s is empty\n", filename);
+        tn5250_buffer_free(&buffer);
+        return -1;
+    }
+    /* The job takes over the buffer's data. */
+    add_job(filename, buffer.data, buffer.len);
+    return 0;
+}
+
+/****i* bench/next_random
+ * NAME
+ *    next_random
+ * SYNOPSIS
+ *    n = next_random (limit);
+ * INPUTS
+ *    int                  limit      -
+ * DESCRIPTION
+ *    Returns a number from 0 to limit - 1.  This is our own generator
+ *    rather than rand (), so that the made up job, and so the checksums,
+ *    are the same everywhere.
+ *****/
+static unsigned long next_random(int limit) {
+    random_state = (random_state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return (random_state >> 8) % (unsigned long)limit;
+}
+
+/****i* bench/make_job
+ * NAME
+ *    make_job
+ * SYNOPSIS
+ *    make_job (pages);
+ * INPUTS
+ *    int                  pages      -
+ * DESCRIPTION
+ *    Make up a job that looks roughly like a spooled report: a page
+ *    setup, then lines of text placed with AHPP, the odd AVPP, CPI and
+ *    LPI change and bit of transparent data, and some words printed
+ *    twice at the same position to make them bold.
+ *****/
+static void make_job(int pages) {
+    /* "ABCDEFGHI abcdefghi 0123456789 .,()" in EBCDIC. */
+    static const unsigned char text[] = {
+        0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0x40, 0x81, 0x82,
+        0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x40, 0xF0, 0xF1, 0xF2, 0xF3,
+        0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0x40, 0x4B, 0x6B, 0x4D, 0x5D,
+    };
+    static const unsigned char cpis[] = { 10, 12, 15 };
+    static const unsigned char lpis[] = { 6, 8 };
+    unsigned char setup[] = {
+        0x2B, 0xD2, 0x06, 0x40, 0x2F, 0xD0, 0x3D, 0xE0, /* Page size */
+        0x2B, 0xD2, 0x04, 0x29, 0x00, 0x0A,             /* 10 CPI */
+        0x2B, 0xC6, 0x02, 0x06,                         /* 6 LPI */
+        0x2B, 0xD2, 0x06, 0x11, 0x00, 0x90, 0x00, 0x90, /* Margins */
+    };
+    unsigned char word[40];
+    unsigned char cmd[8];
+    Tn5250Buffer buffer;
+    int page, line, lines, row, col, seg, len, i;
+
+    tn5250_buffer_init(&buffer);
+    tn5250_buffer_append_data(&buffer, setup, sizeof(setup));
+
+    for (page = 0; page < pages; page++) {
+        lines = 40 + (int)next_random(21);
+        row = 1;
+        for (line = 0; line < lines; line++) {
+            if (next_random(10) == 0 && row < 60) {
+                /* AVPP down a little. */
+                row += 1 + (int)next_random(3);
+                cmd[0] = 0x34;
+                cmd[1] = SCS_AVPP;
+                cmd[2] = (unsigned char)row;
+                tn5250_buffer_append_data(&buffer, cmd, 3);
+            }
+            if (next_random(25) == 0) {
+                cmd[0] = 0x2B;
+                cmd[1] = 0xD2;
+                cmd[2] = 0x04;
+                cmd[3] = 0x29;
+                cmd[4] = 0x00;
+                cmd[5] = cpis[next_random(sizeof(cpis))];
+                tn5250_buffer_append_data(&buffer, cmd, 6);
+            }
+            if (next_random(50) == 0) {
+                cmd[0] = 0x2B;
+                cmd[1] = 0xC6;
+                cmd[2] = 0x02;
+                cmd[3] = lpis[next_random(sizeof(lpis))];
+                tn5250_buffer_append_data(&buffer, cmd, 4);
+            }
+
+            col = 1;
+            for (seg = 1 + (int)next_random(4); seg > 0; seg--) {
+                col += (int)next_random(15);
+                cmd[0] = 0x34;
+                cmd[1] = SCS_AHPP;
+                cmd[2] = (unsigned char)col;
+                tn5250_buffer_append_data(&buffer, cmd, 3);
+
+                len = 1 + (int)next_random(sizeof(word));
+                for (i = 0; i < len; i++) {
+                    word[i] = text[next_random(sizeof(text))];
+                }
+                tn5250_buffer_append_data(&buffer, word, len);
+
+                if (next_random(8) == 0) {
+                    /* Bold: back to the start and print it again. */
+                    tn5250_buffer_append_data(&buffer, cmd, 3);
+                    tn5250_buffer_append_data(&buffer, word, len);
+                }
+                if (next_random(30) == 0) {
+                    /* Transparent data: a printer escape. */
+                    cmd[0] = SCS_TRANSPARENT;
+                    cmd[1] = 5;
+                    memcpy(cmd + 2, "\033(s3B", 5);
+                    tn5250_buffer_append_data(&buffer, cmd, 7);
+                }
+                col += len;
+                if (col > 120) {
+                    break;
+                }
+            }
+
+            switch (next_random(4)) {
+            case 0:
+                cmd[0] = SCS_CR;
+                cmd[1] = SCS_NL;
+                tn5250_buffer_append_data(&buffer, cmd, 2);
+                break;
+            case 1:
+                cmd[0] = SCS_RNL;
+                tn5250_buffer_append_data(&buffer, cmd, 1);
+                break;
+            default:
+                cmd[0] = SCS_NL;
+                tn5250_buffer_append_data(&buffer, cmd, 1);
+                break;
+            }
+            row++;
+        }
+        cmd[0] = SCS_FF;
+        tn5250_buffer_append_data(&buffer, cmd, 1);
+    }
+
+    add_job("(made up)", buffer.data, buffer.len);
+    return;
+}
+
+/****i* bench/convert
+ * NAME
+ *    convert
+ * SYNOPSIS
+ *    convert (conv, job, out);
+ * INPUTS
+ *    const bench_converter * conv    -
+ *    bench_job *          job        -
+ *    FILE *               out        -
+ * DESCRIPTION
+ *    Convert a job the way lp5250d does, a record at a time.
+ *****/
+static void convert(const bench_converter* conv, bench_job* job, FILE* out) {
+    Tn5250SCS* scs;
+    int pos, n;
+
+    scs = tn5250_scs_converter_new(conv->name);
+    if (scs == NULL) {
+        return;
+    }
+#ifdef HAVE_LIBZ
+    if (conv->compress) {
+        tn5250_scs2pdf_set_compress(scs, 1);
+    }
+#endif
+    scs->output = out;
+    tn5250_scs_begin(scs);
+    for (pos = 0; pos < job->len; pos += n) {
+        n = job->len - pos < RECORD_SIZE ? job->len - pos : RECORD_SIZE;
+        tn5250_scs_feed(scs, job->data + pos, n);
+    }
+    tn5250_scs_end(scs);
+    tn5250_scs_destroy(scs);
+    return;
+}
+
+/****i* bench/checksum
+ * NAME
+ *    checksum
+ * SYNOPSIS
+ *    sum = checksum (conv);
+ * INPUTS
+ *    const bench_converter * conv    -
+ * DESCRIPTION
+ *    Convert every job, and return a 32 bit FNV-1a hash of the output.
+ *****/
+static unsigned long checksum(const bench_converter* conv) {
+    unsigned long sum = 2166136261UL;
+    FILE* out;
+    int c, n;
+
+    if ((out = tmpfile()) == NULL) {
+        return 0;
+    }
+    for (n = 0; n < job_count; n++) {
+        convert(conv, &jobs[n], out);
+    }
+    rewind(out);
+    while ((c = getc(out)) != EOF) {
+        sum = ((sum ^ (unsigned long)c) * 16777619UL) & 0xffffffffUL;
+    }
+    fclose(out);
+    return sum;
+}
+
+/****i* bench/bench_scs
+ * NAME
+ *    bench_scs
+ * SYNOPSIS
+ *    ret = bench_scs (iterations, writesums, checksums);
+ * INPUTS
+ *    int                  iterations -
+ *    const char *         writesums  - File to save the checksums in.
+ *    const char *         checksums  - File to compare them with.
+ * DESCRIPTION
+ *    Convert every job with each converter the given number of times,
+ *    and report the throughput and the checksum of the output.  Returns
+ *    1 if a checksum doesn't match, and 0 otherwise.
+ *****/
+static int bench_scs(int iterations, const char* writesums,
+                     const char* checksums) {
+    unsigned long sums[CONVERTER_COUNT];
+    unsigned long expected;
+    char label[64];
+    clock_t start, end;
+    double secs, bytes = 0, pages = 0;
+    FILE* out;
+    FILE* f;
+    int ret = 0;
+    int i, c, n;
+
+    for (n = 0; n < job_count; n++) {
+        bytes += jobs[n].len;
+        pages += jobs[n].pages;
+    }
+    printf("jobs:         %d\n", job_count);
+    printf("pages:        %.0f\n", pages);
+    printf("input bytes:  %.0f\n", bytes);
+    printf("iterations:   %d\n\n", iterations);
+    printf("%-12s %10s %10s %10s  %s\n", "converter", "seconds", "MB/s",
+           "pages/s", "checksum");
+
+    if ((out = fopen("/dev/null", "w")) == NULL) {
+        fprintf(stderr, "scsbench: can't open /dev/null\n");
+        return 1;
+    }
+    for (c = 0; c < (int)CONVERTER_COUNT; c++) {
+        quiet(1);
+        /* This also warms up the caches. */
+        sums[c] = checksum(&converters[c]);
+
+        start = clock();
+        for (i = 0; i < iterations; i++) {
+            for (n = 0; n < job_count; n++) {
+                convert(&converters[c], &jobs[n], out);
+            }
+        }
+        end = clock();
+        quiet(0);
+
+        secs = (double)(end - start) / CLOCKS_PER_SEC;
+        if (secs <= 0) {
+            secs = 1.0 / CLOCKS_PER_SEC;
+        }
+        printf("%-12s %10.3f %10.2f %10.0f  %08lx\n", converters[c].label,
+               secs, bytes * iterations / secs / (1024.0 * 1024.0),
+               pages * iterations / secs, sums[c]);
+    }
+    fclose(out);
+
+    if (writesums != NULL) {
+        if ((f = fopen(writesums, "w")) == NULL) {
+            fprintf(stderr, "scsbench: can't write %s\n", writesums);
+            return 1;
+        }
+        for (c = 0; c < (int)CONVERTER_COUNT; c++) {
+            fprintf(f, "%08lx %s\n", sums[c], converters[c].label);
+        }
+        fclose(f);
+    }
+
+    if (checksums != NULL) {
+        if ((f = fopen(checksums, "r")) == NULL) {
+            fprintf(stderr, "scsbench: can't read %s\n", checksums);
+            return 1;
+        }
+        while (fscanf(f, "%lx %63[^\n]", &expected, label) == 2) {
+            for (c = 0; c < (int)CONVERTER_COUNT; c++) {
+                if (strcmp(label, converters[c].label) == 0) {
+                    break;
+                }
+            }
+            if (c == (int)CONVERTER_COUNT) {
+                continue;
+            }
+            if (sums[c] != expected) {
+                printf("%s: output changed, checksum %08lx, expected %08lx\n",
+                       label, sums[c], expected);
+                ret = 1;
+            }
+        }
+        fclose(f);
+        printf(ret ? "checksums differ\n" : "checksums match\n");
+    }
+    return ret;
+}
@@ -0,0 +1,334 @@
+/* TN5250 - An implementation of the 5250 telnet protocol.
+ * Copyright (C) 1997-2008 Michael Madore
+ *
+ * This file is part of TN5250.
+ *
+ * TN5250 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1, or (at your option)
+ * any later version.
+ *
+ * TN5250 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307 USA
+ *
+ */
+
+/* wtdbench - measure how fast we turn a display buffer back into a WTD
+ * data stream, as we do for every Save Screen.
+ *
+ *    wtdbench [-n ITERATIONS] [TRACEFILE...]
+ *
+ * Each TRACEFILE is a tn5250 trace (see trace= in tn5250rc(5)).  It is
+ * replayed through a session, and every distinct screen it produces is
+ * kept.  With no trace files, a few made-up screens are used instead. */
+
+#include "tn5250-private.h"
+#include <time.h>
+
+#define MAX_SCREENS 4096
+
+static Tn5250DBuffer* screens[MAX_SCREENS];
+static int screen_count = 0;
+
+static void add_screen(Tn5250DBuffer* dbuffer);
+static void make_screens(void);
+static int replay_trace(const char* filename);
+static void bench_wtd(int iterations);
+
+int main(int argc, char* argv[]) {
+    int iterations = 1000;
+    int i = 1;
+
+    if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+        iterations = atoi(argv[i + 1]);
+        i += 2;
+    }
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: wtdbench [-n ITERATIONS] [TRACEFILE...]\n");
+        return 1;
+    }
+
+    for (; i < argc; i++) {
+        if (replay_trace(argv[i]) == -1) {
+            return 1;
+        }
+    }
+    if (screen_count == 0) {
+        make_screens();
+    }
+
+    bench_wtd(iterations);
+
+    for (i = 0; i < screen_count; i++) {
+        tn5250_dbuffer_destroy(screens[i]);
+    }
+    return 0;
+}
+
+/****i* bench/add_screen
+ * NAME
+ *    add_screen
+ * SYNOPSIS
+ *    add_screen (dbuffer);
+ * INPUTS
+ *    Tn5250DBuffer *      dbuffer    -
+ * DESCRIPTION
+ *    Keep a copy of a display buffer to run the benchmark over.
+ *****/
+static void add_screen(Tn5250DBuffer* dbuffer) {
+    Tn5250DBuffer* copy;
+
+    if (screen_count == MAX_SCREENS) {
+        return;
+    }
+    if ((copy = tn5250_dbuffer_copy(dbuffer)) != NULL) {
+        screens[screen_count++] = copy;
+    }
+    return;
+}
+
+/****i* bench/make_screens
+ * NAME
+ *    make_screens
+ * SYNOPSIS
+ *    make_screens ();
+ * INPUTS
+ *    None
+ * DESCRIPTION
+ *    Build some screens that look roughly like real ones: a sign on
+ *    style screen with a handful of fields, and a 27x132 subfile with an
+ *    input field on every line.
+ *****/
+static void make_screens(void) {
+    Tn5250DBuffer* dbuffer;
+    Tn5250Field* field;
+    int y, x;
+
+    /* 24x80 with some text and a few fields. */
+    dbuffer = tn5250_dbuffer_new(80, 24);
+    for (y = 0; y < 24; y += 2) {
+        tn5250_dbuffer_cursor_set(dbuffer, y, 2);
+        tn5250_dbuffer_addch(dbuffer, 0x20);
+        for (x = 0; x < 30; x++) {
+            tn5250_dbuffer_addch(dbuffer, (unsigned char)(0xC1 + x % 9));
+        }
+        tn5250_dbuffer_repeat(dbuffer, 0x4B, 10);
+        tn5250_dbuffer_addch(dbuffer, 0x24);
+
+        field = tn5250_field_new(80);
+        field->start_row = y;
+        field->start_col = 45;
+        field->length = 10;
+        field->attribute = 0x24;
+        tn5250_dbuffer_add_field_copy(dbuffer, field);
+        tn5250_field_destroy(field);
+        tn5250_dbuffer_repeat(dbuffer, 0x40, 10);
+        tn5250_dbuffer_addch(dbuffer, 0x20);
+    }
+    add_screen(dbuffer);
+    tn5250_dbuffer_destroy(dbuffer);
+
+    /* 27x132 subfile. */
+    dbuffer = tn5250_dbuffer_new(132, 27);
+    for (y = 2; y < 25; y++) {
+        field = tn5250_field_new(132);
+        field->start_row = y;
+        field->start_col = 3;
+        field->length = 1;
+        field->attribute = 0x24;
+        tn5250_dbuffer_add_field_copy(dbuffer, field);
+        tn5250_field_destroy(field);
+
+        tn5250_dbuffer_cursor_set(dbuffer, y, 2);
+        tn5250_dbuffer_addch(dbuffer, 0x24);
+        tn5250_dbuffer_addch(dbuffer, 0x40);
+        tn5250_dbuffer_addch(dbuffer, 0x20);
+        for (x = 0; x < 100; x++) {
+            tn5250_dbuffer_addch(dbuffer, (unsigned char)(x % 7 == 0
+                                                              ? 0x40
+                                                              : 0x81 + x % 9));
+        }
+    }
+    add_screen(dbuffer);
+    tn5250_dbuffer_destroy(dbuffer);
+
+    /* A cleared screen. */
+    dbuffer = tn5250_dbuffer_new(80, 24);
+    add_screen(dbuffer);
+    tn5250_dbuffer_destroy(dbuffer);
+    return;
+}
+
+#ifndef NDEBUG
+/* A terminal with no screen which keeps a copy of every display it is
+ * asked to show. */
+static unsigned long last_serial = 0;
+static unsigned long last_generation = 0;
+
+static void capture_init(Tn5250Terminal* This) { return; }
+static void capture_term(Tn5250Terminal* This) { return; }
+static void capture_destroy(Tn5250Terminal* This) { return; }
+static int capture_width(Tn5250Terminal* This) { return 132; }
+static int capture_height(Tn5250Terminal* This) { return 27; }
+static int capture_flags(Tn5250Terminal* This) { return 0; }
+static void capture_update_indicators(Tn5250Terminal* This,
+                                      Tn5250Display* display) {
+    return;
+}
+static int capture_waitevent(Tn5250Terminal* This) {
+    return TN5250_TERMINAL_EVENT_QUIT;
+}
+static int capture_getkey(Tn5250Terminal* This) { return -1; }
+static void capture_beep(Tn5250Terminal* This) { return; }
+
+static void capture_update(Tn5250Terminal* This, Tn5250Display* display) {
+    Tn5250DBuffer* dbuffer = tn5250_display_dbuffer(display);
+
+    if (tn5250_dbuffer_serial(dbuffer) != last_serial ||
+        tn5250_dbuffer_generation(dbuffer) != last_generation) {
+        last_serial = tn5250_dbuffer_serial(dbuffer);
+        last_generation = tn5250_dbuffer_generation(dbuffer);
+        add_screen(dbuffer);
+    }
+    return;
+}
+#endif
+
+/****i* bench/replay_trace
+ * NAME
+ *    replay_trace
+ * SYNOPSIS
+ *    ret = replay_trace (filename);
+ * INPUTS
+ *    const char *         filename   - A tn5250 trace file.
+ * DESCRIPTION
+ *    Play a trace file back through a session, keeping each screen it
+ *    draws.  Returns -1 if the trace can't be played.
+ *****/
+static int replay_trace(const char* filename) {
+#ifndef NDEBUG
+    Tn5250Terminal capture;
+    Tn5250Terminal* term;
+    Tn5250Config* config;
+    Tn5250Stream* stream;
+    Tn5250Display* display;
+    Tn5250Session* sess;
+    char* host;
+
+    memset(&capture, 0, sizeof(capture));
+    capture.conn_fd = -1;
+    capture.init = capture_init;
+    capture.term = capture_term;
+    capture.destroy = capture_destroy;
+    capture.width = capture_width;
+    capture.height = capture_height;
+    capture.flags = capture_flags;
+    capture.update = capture_update;
+    capture.update_indicators = capture_update_indicators;
+    capture.waitevent = capture_waitevent;
+    capture.getkey = capture_getkey;
+    capture.beep = capture_beep;
+
+    host = (char*)malloc(strlen(filename) + 7);
+    if (host == NULL) {
+        return -1;
+    }
+    sprintf(host, "debug:%s", filename);
+
+    config = tn5250_config_new();
+    stream = tn5250_stream_open(host, config);
+    free(host);
+    if (stream == NULL) {
+        fprintf(stderr, "wtdbench: can't open %s\n", filename);
+        tn5250_config_unref(config);
+        return -1;
+    }
+
+    display = tn5250_display_new();
+    if (tn5250_display_config(display, config) == -1) {
+        tn5250_stream_destroy(stream);
+        tn5250_config_unref(config);
+        return -1;
+    }
+
+    term = tn5250_debug_terminal_new(&capture, stream);
+    tn5250_debug_terminal_set_pause(term, 0);
+    tn5250_display_set_terminal(display, term);
+
+    sess = tn5250_session_new();
+    tn5250_display_set_session(display, sess);
+    tn5250_session_set_stream(sess, stream);
+    tn5250_session_config(sess, config);
+
+    last_serial = 0;
+    tn5250_session_main_loop(sess);
+
+    tn5250_session_destroy(sess);
+    tn5250_display_destroy(display);
+    tn5250_config_unref(config);
+    return 0;
+#else
+    fprintf(stderr, "wtdbench: replaying %s needs a build without NDEBUG\n",
+            filename);
+    return -1;
+#endif
+}
+
+/****i* bench/bench_wtd
+ * NAME
+ *    bench_wtd
+ * SYNOPSIS
+ *    bench_wtd (iterations);
+ * INPUTS
+ *    int                  iterations -
+ * DESCRIPTION
+ *    Convert every screen to WTD data the given number of times, and
+ *    report the throughput.
+ *****/
+static void bench_wtd(int iterations) {
+    Tn5250Buffer buffer;
+    Tn5250WTDContext* ctx;
+    clock_t start, end;
+    double secs, cells = 0, bytes = 0;
+    int i, n;
+
+    tn5250_buffer_init(&buffer);
+
+    start = clock();
+    for (i = 0; i < iterations; i++) {
+        for (n = 0; n < screen_count; n++) {
+            buffer.len = 0;
+            ctx = tn5250_wtd_context_new(&buffer, NULL, screens[n]);
+            tn5250_wtd_context_set_ic(ctx, 1, 1);
+            tn5250_wtd_context_convert(ctx);
+            tn5250_wtd_context_destroy(ctx);
+
+            cells += tn5250_dbuffer_width(screens[n]) *
+                     tn5250_dbuffer_height(screens[n]);
+            bytes += tn5250_buffer_length(&buffer);
+        }
+    }
+    end = clock();
+
+    secs = (double)(end - start) / CLOCKS_PER_SEC;
+    if (secs <= 0) {
+        secs = 1.0 / CLOCKS_PER_SEC;
+    }
+
+    printf("screens:      %d\n", screen_count);
+    printf("iterations:   %d\n", iterations);
+    printf("seconds:      %.3f\n", secs);
+    printf("screens/sec:  %.0f\n", screen_count * (double)iterations / secs);
+    printf("cells/sec:    %.0f\n", cells / secs);
+    printf("output MB/s:  %.2f\n", bytes / secs / (1024.0 * 1024.0));
+
+    tn5250_buffer_free(&buffer);
+    return;
+}
@@ -83,6 +83,7 @@ int main(int argc, char* argv[]) {
 #ifndef NDEBUG
     tracefile = tn5250_config_get(config, "trace");
     if (tracefile != NULL) {
+        tn5250_log_set_async(tn5250_config_get_bool(config, "trace_async"));
         tn5250_log_open(tn5250_config_get(config, "trace"));
     }
 #endif
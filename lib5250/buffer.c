@@ -84,6 +84,28 @@ void tn5250_buffer_append_byte(Tn5250Buffer* This, unsigned char b) {
     This->data[This->len++] = b;
 }
 
+/****f* lib5250/tn5250_buffer_reserve
+ * NAME
+ *    tn5250_buffer_reserve
+ * SYNOPSIS
+ *    tn5250_buffer_reserve (&buf, len);
+ * INPUTS
+ *    Tn5250Buffer *	buf	    - Pointer to a buffer object.
+ *    int		len	    - Number of bytes about to be appended.
+ * DESCRIPTION
+ *    Make sure that len more bytes can be appended to the buffer without
+ *    reallocating it.  Use this before appending a lot of data a byte at
+ *    a time.
+ *****/
+void tn5250_buffer_reserve(Tn5250Buffer* This, int len) {
+    if (This->len + len + 1 <= This->allocated) {
+        return;
+    }
+    This->allocated = This->len + len + BUFFER_DELTA;
+    This->data = (unsigned char*)realloc(This->data, This->allocated);
+    TN5250_ASSERT(This->data != NULL);
+}
+
 /****f* lib5250/tn5250_buffer_append_data
  * NAME
  *    tn5250_buffer_append_data
@@ -60,6 +60,7 @@ extern void tn5250_buffer_free(Tn5250Buffer* This);
 extern void tn5250_buffer_append_byte(Tn5250Buffer* This, unsigned char b);
 extern void tn5250_buffer_append_data(Tn5250Buffer* This, unsigned char* data,
                                       int len);
+extern void tn5250_buffer_reserve(Tn5250Buffer* This, int len);
 extern void tn5250_buffer_log(Tn5250Buffer* This, const char* prefix);
 
 #ifdef __cplusplus
@@ -34,6 +34,39 @@
     }
 #endif
 
+#define MDT_WORD_BITS (sizeof(unsigned long) * 8)
+
+/* Source of Tn5250DBuffer serial numbers. */
+static unsigned long tn5250_dbuffer_last_serial = 0;
+
+static int tn5250_dbuffer_grow_field_table(Tn5250DBuffer* This, int size);
+static void tn5250_dbuffer_link_fields(Tn5250DBuffer* This);
+static void tn5250_dbuffer_reset_rows(Tn5250DBuffer* This);
+static void tn5250_dbuffer_put(Tn5250DBuffer* This, const unsigned char* s,
+                               unsigned char c, int len);
+
+/* 5250 displays only come in 24x80 and 27x132.  The cursor and row loops
+ * below take the width and height as arguments, and their callers pass
+ * them as constants for each of those sizes, so once they are inlined
+ * the compiler can fold the divisions and row lengths.  Any other size
+ * gets the same code with the buffer's own w and h. */
+static inline void tn5250_dbuffer_step_right(Tn5250DBuffer* This, int n,
+                                             int w, int h);
+static inline void tn5250_dbuffer_advance(Tn5250DBuffer* This, int w, int h);
+static inline void tn5250_dbuffer_put_rows(Tn5250DBuffer* This,
+                                           const unsigned char* s,
+                                           unsigned char c, int len, int w,
+                                           int h);
+static void tn5250_dbuffer_shift_left(Tn5250DBuffer* This, int from, int to,
+                                      unsigned char c);
+static unsigned char tn5250_dbuffer_shift_right(Tn5250DBuffer* This, int from,
+                                                int to, unsigned char c);
+static void tn5250_dbuffer_update_fingerprint(Tn5250DBuffer* This);
+static void tn5250_dbuffer_rotate_rows(Tn5250DBuffer* This, int top, int count,
+                                       int n);
+static void tn5250_dbuffer_reverse_rows(Tn5250DBuffer* This, int first,
+                                        int last);
+
 /****f* lib5250/tn5250_dbuffer_new
  * NAME
  *    tn5250_dbuffer_new
@@ -57,6 +90,8 @@ Tn5250DBuffer* tn5250_dbuffer_new(int width, int height) {
     This->cx = This->cy = 0;
     This->tcx = This->tcy = 0;
     This->next = This->prev = NULL;
+    This->serial = ++tn5250_dbuffer_last_serial;
+    This->generation = 0;
 
     This->field_count = 0;
     This->entry_field_count = 0;
@@ -68,8 +103,15 @@ Tn5250DBuffer* tn5250_dbuffer_new(int width, int height) {
     This->scrollbar_list = NULL;
     This->menubar_list = NULL;
     This->master_mdt = 0;
+    This->field_table = NULL;
+    This->field_start = NULL;
+    This->field_end = NULL;
+    This->mdt_bits = NULL;
+    This->field_table_size = 0;
+    This->field_w = 0;
     This->header_data = NULL;
     This->header_length = 0;
+    This->fingerprint_valid = 0;
 
     This->script_slot = NULL;
 
@@ -78,6 +120,13 @@ Tn5250DBuffer* tn5250_dbuffer_new(int width, int height) {
         free(This);
         return NULL;
     }
+    This->rows = tn5250_new(unsigned char*, height);
+    if (This->rows == NULL) {
+        free(This->data);
+        free(This);
+        return NULL;
+    }
+    tn5250_dbuffer_reset_rows(This);
 
     tn5250_dbuffer_clear(This);
     return This;
@@ -96,6 +145,7 @@ Tn5250DBuffer* tn5250_dbuffer_new(int width, int height) {
  *****/
 Tn5250DBuffer* tn5250_dbuffer_copy(Tn5250DBuffer* dsp) {
     Tn5250DBuffer* This = tn5250_new(Tn5250DBuffer, 1);
+    int i, count;
 
     if (This == NULL) {
         return NULL;
@@ -109,14 +159,42 @@ Tn5250DBuffer* tn5250_dbuffer_copy(Tn5250DBuffer* dsp) {
     This->cy = dsp->cy;
     This->tcx = dsp->tcx;
     This->tcy = dsp->tcy;
+    This->serial = ++tn5250_dbuffer_last_serial;
+    This->generation = 0;
     This->data = tn5250_new(unsigned char, dsp->w * dsp->h);
     if (This->data == NULL) {
         free(This);
         return NULL;
     }
-    memcpy(This->data, dsp->data, dsp->w * dsp->h);
-
-    This->field_list = tn5250_field_list_copy(dsp->field_list);
+    This->rows = tn5250_new(unsigned char*, dsp->h);
+    if (This->rows == NULL) {
+        free(This->data);
+        free(This);
+        return NULL;
+    }
+    tn5250_dbuffer_reset_rows(This);
+    memcpy(This->data, tn5250_dbuffer_data(dsp), dsp->w * dsp->h);
+
+    /* The format table is copied wholesale; only the fields' links need
+     * to be pointed at the new table. */
+    count = dsp->field_count;
+    if (count > 0 && tn5250_dbuffer_grow_field_table(This, count)) {
+        memcpy(This->field_table, dsp->field_table,
+               count * sizeof(Tn5250Field));
+        memcpy(This->field_start, dsp->field_start, count * sizeof(int));
+        memcpy(This->field_end, dsp->field_end, count * sizeof(int));
+        memcpy(This->mdt_bits, dsp->mdt_bits,
+               ((count + MDT_WORD_BITS - 1) / MDT_WORD_BITS) *
+                   sizeof(unsigned long));
+        This->field_count = count;
+        for (i = 0; i < count; i++) {
+            This->field_table[i].script_slot = NULL;
+        }
+        tn5250_dbuffer_link_fields(This);
+    }
+    This->entry_field_count = dsp->entry_field_count;
+    This->field_w = dsp->field_w;
+    This->master_mdt = dsp->master_mdt;
     This->window_list = tn5250_window_list_copy(dsp->window_list);
     This->header_length = dsp->header_length;
     if (dsp->header_data != NULL) {
@@ -143,10 +221,22 @@ Tn5250DBuffer* tn5250_dbuffer_copy(Tn5250DBuffer* dsp) {
  *****/
 void tn5250_dbuffer_destroy(Tn5250DBuffer* This) {
     free(This->data);
+    free(This->rows);
+    if (This->field_table != NULL) {
+        free(This->field_table);
+    }
+    if (This->field_start != NULL) {
+        free(This->field_start);
+    }
+    if (This->field_end != NULL) {
+        free(This->field_end);
+    }
+    if (This->mdt_bits != NULL) {
+        free(This->mdt_bits);
+    }
     if (This->header_data != NULL) {
         free(This->header_data);
     }
-    (void)tn5250_field_list_destroy(This->field_list);
     (void)tn5250_window_list_destroy(This->window_list);
     free(This);
     return;
@@ -166,6 +256,7 @@ void tn5250_dbuffer_destroy(Tn5250DBuffer* This) {
  *****/
 void tn5250_dbuffer_set_header_data(Tn5250DBuffer* This, unsigned char* data,
                                     int len) {
+    tn5250_dbuffer_touch(This);
     if (This->header_data != NULL) {
         free(This->header_data);
     }
@@ -331,7 +422,8 @@ send_data_done:
  *****/
 unsigned char* tn5250_dbuffer_field_data(Tn5250DBuffer* This,
                                          Tn5250Field* field) {
-    return &This->data[field->start_row * This->w + field->start_col];
+    return &tn5250_dbuffer_data(This)[field->start_row * This->w +
+                                      field->start_col];
 }
 
 /****f* lib5250/tn5250_dbuffer_set_size
@@ -347,12 +439,17 @@ unsigned char* tn5250_dbuffer_field_data(Tn5250DBuffer* This,
  *    Resize the display (say, to 132 columns ;)
  *****/
 void tn5250_dbuffer_set_size(Tn5250DBuffer* This, int rows, int cols) {
+    tn5250_dbuffer_touch(This);
     This->w = cols;
     This->h = rows;
 
     free(This->data);
+    free(This->rows);
     This->data = tn5250_new(unsigned char, rows* cols);
+    This->rows = tn5250_new(unsigned char*, rows);
     TN5250_ASSERT(This->data != NULL);
+    TN5250_ASSERT(This->rows != NULL);
+    tn5250_dbuffer_reset_rows(This);
 
     tn5250_dbuffer_clear(This);
     return;
@@ -371,6 +468,7 @@ void tn5250_dbuffer_set_size(Tn5250DBuffer* This, int rows, int cols) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_cursor_set(Tn5250DBuffer* This, int y, int x) {
+    tn5250_dbuffer_touch(This);
     This->cy = y;
     This->cx = x;
 
@@ -391,37 +489,87 @@ void tn5250_dbuffer_cursor_set(Tn5250DBuffer* This, int y, int x) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_clear(Tn5250DBuffer* This) {
+    tn5250_dbuffer_touch(This);
+    tn5250_dbuffer_reset_rows(This);
     memset(This->data, 0, This->w * This->h);
     This->cx = This->cy = 0;
     tn5250_dbuffer_clear_table(This);
     return;
 }
 
-/****f* lib5250/tn5250_dbuffer_add_field
+/****f* lib5250/tn5250_dbuffer_add_field_copy
  * NAME
- *    tn5250_dbuffer_add_field
+ *    tn5250_dbuffer_add_field_copy
  * SYNOPSIS
- *    tn5250_dbuffer_add_field (This, field);
+ *    added = tn5250_dbuffer_add_field_copy (This, field);
+ *    tn5250_field_destroy (field);
  * INPUTS
  *    Tn5250DBuffer *      This       -
- *    Tn5250Field *        field      -
+ *    const Tn5250Field *  field      - A field from tn5250_field_new.
  * DESCRIPTION
- *    DOCUMENT ME!!!
+ *    Add a copy of a field to the end of the format table, and return the
+ *    table's copy (or NULL if we ran out of memory).  The caller still
+ *    owns field and should destroy it.  Pointers to fields in the table
+ *    stay good only until the next field is added or the table is
+ *    cleared.
+ *
+ *    This replaces tn5250_dbuffer_add_field(), which took over the
+ *    caller's field.  The fields now live in one table, so that can no
+ *    longer be done.
  *****/
-void tn5250_dbuffer_add_field(Tn5250DBuffer* This, Tn5250Field* field) {
-    field->id = This->field_count++;
-    field->table = This;
-    This->field_list = tn5250_field_list_add(This->field_list, field);
+Tn5250Field* tn5250_dbuffer_add_field_copy(Tn5250DBuffer* This,
+                                           const Tn5250Field* field) {
+    Tn5250Field* slot;
 
-    if ((!tn5250_field_is_continued_middle(field)) &&
-        (!tn5250_field_is_continued_last(field))) {
+    tn5250_dbuffer_touch(This);
+    if (!tn5250_dbuffer_grow_field_table(This, This->field_count + 1)) {
+        return NULL;
+    }
+
+    slot = &This->field_table[This->field_count];
+    memcpy(slot, field, sizeof(Tn5250Field));
+
+    slot->id = This->field_count++;
+    slot->table = This;
+    This->field_list = tn5250_field_list_add(This->field_list, slot);
+    This->field_start[slot->id] = tn5250_field_start_pos(slot);
+    This->field_end[slot->id] = tn5250_field_end_pos(slot);
+    if (slot->id == 0) {
+        This->field_w = slot->w;
+    }
+    else if (slot->w != This->field_w) {
+        This->field_w = -1;
+    }
+    tn5250_dbuffer_update_mdt(This, slot);
+
+    if ((!tn5250_field_is_continued_middle(slot)) &&
+        (!tn5250_field_is_continued_last(slot))) {
         This->entry_field_count++;
     }
-    field->entry_id = This->entry_field_count;
+    slot->entry_id = This->entry_field_count;
 
-    TN5250_LOG(("adding field: field->id: %d, field->entry_id: %d\n", field->id,
-                field->entry_id));
-    return;
+    TN5250_LOG(("adding field: field->id: %d, field->entry_id: %d\n", slot->id,
+                slot->entry_id));
+    return slot;
+}
+
+/****f* lib5250/tn5250_dbuffer_field
+ * NAME
+ *    tn5250_dbuffer_field
+ * SYNOPSIS
+ *    field = tn5250_dbuffer_field (This, id);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    int                  id         - The field's id.
+ * DESCRIPTION
+ *    Return the field in the format table with the given id, or NULL if
+ *    there is no such field.
+ *****/
+Tn5250Field* tn5250_dbuffer_field(Tn5250DBuffer* This, int id) {
+    if (id < 0 || id >= This->field_count) {
+        return NULL;
+    }
+    return &This->field_table[id];
 }
 
 /****f* lib5250/tn5250_dbuffer_clear_table
@@ -435,8 +583,15 @@ void tn5250_dbuffer_add_field(Tn5250DBuffer* This, Tn5250Field* field) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_clear_table(Tn5250DBuffer* This) {
+    tn5250_dbuffer_touch(This);
     TN5250_LOG(("tn5250_dbuffer_clear_table() entered.\n"));
-    This->field_list = tn5250_field_list_destroy(This->field_list);
+    /* The field table itself is kept for the next format. */
+    This->field_list = NULL;
+    if (This->mdt_bits != NULL) {
+        memset(This->mdt_bits, 0,
+               (This->field_table_size / MDT_WORD_BITS) *
+                   sizeof(unsigned long));
+    }
     /* Comment this for now since the table is cleared just after we have
      * received a Create Window Structured Field command.  We don't really
      * want to blow away our newly created window.
@@ -449,6 +604,7 @@ void tn5250_dbuffer_clear_table(Tn5250DBuffer* This) {
      */
     This->field_count = 0;
     This->entry_field_count = 0;
+    This->field_w = 0;
     /*
        This->window_count = 0;
        This->scrollbar_count = 0;
@@ -472,10 +628,23 @@ void tn5250_dbuffer_clear_table(Tn5250DBuffer* This) {
  *    int                  y          -
  *    int                  x          -
  * DESCRIPTION
- *    DOCUMENT ME!!!
+ *    Return the first field in the format table which contains the
+ *    position at row y, column x, or NULL if there isn't one.
  *****/
 Tn5250Field* tn5250_dbuffer_field_yx(Tn5250DBuffer* This, int y, int x) {
     Tn5250Field* iter;
+    int i, pos;
+
+    if (This->field_w > 0) {
+        pos = y * This->field_w + x;
+        for (i = 0; i < This->field_count; i++) {
+            if (pos >= This->field_start[i] && pos <= This->field_end[i]) {
+                return &This->field_table[i];
+            }
+        }
+        return NULL;
+    }
+
     if ((iter = This->field_list) != NULL) {
         do {
             if (tn5250_field_hit_test(iter, y, x)) {
@@ -499,14 +668,164 @@ Tn5250Field* tn5250_dbuffer_field_yx(Tn5250DBuffer* This, int y, int x) {
  *    or NULL if there are no non-bypass fields.
  *****/
 Tn5250Field* tn5250_dbuffer_first_non_bypass(Tn5250DBuffer* This) {
-    Tn5250Field* iter;
-    if ((iter = This->field_list) != NULL) {
-        do {
-            if (!tn5250_field_is_bypass(iter)) {
-                return iter;
-            }
-            iter = iter->next;
-        } while (iter != This->field_list);
+    int i;
+
+    for (i = 0; i < This->field_count; i++) {
+        if (!tn5250_field_is_bypass(&This->field_table[i])) {
+            return &This->field_table[i];
+        }
+    }
+    return NULL;
+}
+
+/****i* lib5250/tn5250_dbuffer_grow_field_table
+ * NAME
+ *    tn5250_dbuffer_grow_field_table
+ * SYNOPSIS
+ *    ok = tn5250_dbuffer_grow_field_table (This, size);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    int                  size       - Number of fields needed.
+ * DESCRIPTION
+ *    Make sure the field table, the position arrays and the MDT bitset
+ *    have room for field ids 0 through size - 1.  Returns 0 if we run out
+ *    of memory.
+ *****/
+static int tn5250_dbuffer_grow_field_table(Tn5250DBuffer* This, int size) {
+    Tn5250Field* table;
+    int *start, *end;
+    unsigned long* bits;
+    int newsize, oldwords, newwords;
+
+    if (size <= This->field_table_size) {
+        return 1;
+    }
+
+    newsize = This->field_table_size > 0 ? This->field_table_size : 64;
+    while (newsize < size) {
+        newsize *= 2;
+    }
+    oldwords = This->field_table_size / MDT_WORD_BITS;
+    newwords = newsize / MDT_WORD_BITS;
+
+    table = (Tn5250Field*)realloc(This->field_table,
+                                  newsize * sizeof(Tn5250Field));
+    if (table == NULL) {
+        return 0;
+    }
+    This->field_table = table;
+    tn5250_dbuffer_link_fields(This);
+
+    start = (int*)realloc(This->field_start, newsize * sizeof(int));
+    if (start == NULL) {
+        return 0;
+    }
+    This->field_start = start;
+
+    end = (int*)realloc(This->field_end, newsize * sizeof(int));
+    if (end == NULL) {
+        return 0;
+    }
+    This->field_end = end;
+
+    bits = (unsigned long*)realloc(This->mdt_bits,
+                                   newwords * sizeof(unsigned long));
+    if (bits == NULL) {
+        return 0;
+    }
+    memset(bits + oldwords, 0, (newwords - oldwords) * sizeof(unsigned long));
+    This->mdt_bits = bits;
+    This->field_table_size = newsize;
+    return 1;
+}
+
+/****i* lib5250/tn5250_dbuffer_link_fields
+ * NAME
+ *    tn5250_dbuffer_link_fields
+ * SYNOPSIS
+ *    tn5250_dbuffer_link_fields (This);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ * DESCRIPTION
+ *    Rebuild field_list and the fields' links after the field table has
+ *    been moved or copied.
+ *****/
+static void tn5250_dbuffer_link_fields(Tn5250DBuffer* This) {
+    int i, n = This->field_count;
+
+    for (i = 0; i < n; i++) {
+        This->field_table[i].next = &This->field_table[(i + 1) % n];
+        This->field_table[i].prev = &This->field_table[(i + n - 1) % n];
+        This->field_table[i].table = This;
+    }
+    This->field_list = (n > 0) ? This->field_table : NULL;
+    return;
+}
+
+/****f* lib5250/tn5250_dbuffer_update_mdt
+ * NAME
+ *    tn5250_dbuffer_update_mdt
+ * SYNOPSIS
+ *    tn5250_dbuffer_update_mdt (This, field);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    Tn5250Field *        field      -
+ * DESCRIPTION
+ *    Bring the format table's record of which fields are modified up to
+ *    date with the MDT bit in the field's FFW.  Call this whenever that
+ *    bit is changed on a field which is already in the table.
+ *****/
+void tn5250_dbuffer_update_mdt(Tn5250DBuffer* This, Tn5250Field* field) {
+    unsigned long mask;
+    int word;
+
+    tn5250_dbuffer_touch(This);
+    if (field->id < 0 || field->id >= This->field_count ||
+        field != &This->field_table[field->id]) {
+        return;
+    }
+
+    word = field->id / MDT_WORD_BITS;
+    mask = 1UL << (field->id % MDT_WORD_BITS);
+    if (tn5250_field_mdt(field)) {
+        This->mdt_bits[word] |= mask;
+    }
+    else {
+        This->mdt_bits[word] &= ~mask;
+    }
+    return;
+}
+
+/****f* lib5250/tn5250_dbuffer_next_mdt_field
+ * NAME
+ *    tn5250_dbuffer_next_mdt_field
+ * SYNOPSIS
+ *    field = tn5250_dbuffer_next_mdt_field (This, field);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    Tn5250Field *        field      - The last field returned, or NULL.
+ * DESCRIPTION
+ *    Return the first field in the format table after the given one
+ *    (or the first field at all, if field is NULL) which has its MDT
+ *    set, or NULL if there are no more.  Fields come back in format
+ *    table order, and fields without MDT cost almost nothing to skip.
+ *****/
+Tn5250Field* tn5250_dbuffer_next_mdt_field(Tn5250DBuffer* This,
+                                           Tn5250Field* field) {
+    unsigned long bits;
+    int id = (field == NULL) ? 0 : field->id + 1;
+
+    while (id < This->field_count) {
+        bits = This->mdt_bits[id / MDT_WORD_BITS] >> (id % MDT_WORD_BITS);
+        if (bits == 0) {
+            id = (id / MDT_WORD_BITS + 1) * MDT_WORD_BITS;
+            continue;
+        }
+        while ((bits & 1) == 0) {
+            bits >>= 1;
+            id++;
+        }
+        return &This->field_table[id];
     }
     return NULL;
 }
@@ -523,6 +842,7 @@ Tn5250Field* tn5250_dbuffer_first_non_bypass(Tn5250DBuffer* This) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_right(Tn5250DBuffer* This, int n) {
+    tn5250_dbuffer_touch(This);
     if (This->menubar_count > 0) {
         Tn5250Menubar* menubar =
             tn5250_menubar_hit_test(This->menubar_list, This->cx, This->cy);
@@ -534,15 +854,42 @@ void tn5250_dbuffer_right(Tn5250DBuffer* This, int n) {
         }
     }
 
-    This->cx += n;
-    This->cy += (This->cx / This->w);
-    This->cx = (This->cx % This->w);
-    This->cy = (This->cy % This->h);
+    if (This->w == 80 && This->h == 24) {
+        tn5250_dbuffer_step_right(This, n, 80, 24);
+    }
+    else if (This->w == 132 && This->h == 27) {
+        tn5250_dbuffer_step_right(This, n, 132, 27);
+    }
+    else {
+        tn5250_dbuffer_step_right(This, n, This->w, This->h);
+    }
 
     ASSERT_VALID(This);
     return;
 }
 
+/****i* lib5250/tn5250_dbuffer_step_right
+ * NAME
+ *    tn5250_dbuffer_step_right
+ * SYNOPSIS
+ *    tn5250_dbuffer_step_right (This, n, w, h);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    int                  n          - Positions to move.
+ *    int                  w          - The buffer's width.
+ *    int                  h          - The buffer's height.
+ * DESCRIPTION
+ *    Move the cursor n positions to the right, wrapping at the end of
+ *    each line and the end of the display.
+ *****/
+static inline void tn5250_dbuffer_step_right(Tn5250DBuffer* This, int n,
+                                             int w, int h) {
+    This->cx += n;
+    This->cy = (This->cy + This->cx / w) % h;
+    This->cx %= w;
+    return;
+}
+
 /****f* lib5250/tn5250_dbuffer_left
  * NAME
  *    tn5250_dbuffer_left
@@ -554,6 +901,7 @@ void tn5250_dbuffer_right(Tn5250DBuffer* This, int n) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_left(Tn5250DBuffer* This) {
+    tn5250_dbuffer_touch(This);
     if (This->menubar_count > 0) {
         Tn5250Menubar* menubar =
             tn5250_menubar_hit_test(This->menubar_list, This->cx, This->cy);
@@ -589,6 +937,7 @@ void tn5250_dbuffer_left(Tn5250DBuffer* This) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_up(Tn5250DBuffer* This) {
+    tn5250_dbuffer_touch(This);
     if (This->menubar_count > 0) {
         Tn5250Menubar* menubar =
             tn5250_menubar_hit_test(This->menubar_list, This->cx, This->cy);
@@ -619,6 +968,7 @@ void tn5250_dbuffer_up(Tn5250DBuffer* This) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_down(Tn5250DBuffer* This) {
+    tn5250_dbuffer_touch(This);
     if (This->menubar_count > 0) {
         Tn5250Menubar* menubar =
             tn5250_menubar_hit_test(This->menubar_list, This->cx, This->cy);
@@ -649,6 +999,7 @@ void tn5250_dbuffer_down(Tn5250DBuffer* This) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_goto_ic(Tn5250DBuffer* This) {
+    tn5250_dbuffer_touch(This);
     ASSERT_VALID(This);
 
     This->cy = This->tcy;
@@ -670,15 +1021,215 @@ void tn5250_dbuffer_goto_ic(Tn5250DBuffer* This) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_addch(Tn5250DBuffer* This, unsigned char c) {
+    tn5250_dbuffer_touch(This);
     ASSERT_VALID(This);
 
-    This->data[(This->cy * This->w) + This->cx] = c;
-    tn5250_dbuffer_right(This, 1);
+    tn5250_dbuffer_cell(This, This->cy, This->cx) = c;
+    if (This->menubar_count > 0) {
+        tn5250_dbuffer_right(This, 1);
+    }
+    else if (This->w == 80 && This->h == 24) {
+        tn5250_dbuffer_advance(This, 80, 24);
+    }
+    else if (This->w == 132 && This->h == 27) {
+        tn5250_dbuffer_advance(This, 132, 27);
+    }
+    else {
+        tn5250_dbuffer_advance(This, This->w, This->h);
+    }
+
+    ASSERT_VALID(This);
+    return;
+}
+
+/****i* lib5250/tn5250_dbuffer_advance
+ * NAME
+ *    tn5250_dbuffer_advance
+ * SYNOPSIS
+ *    tn5250_dbuffer_advance (This, w, h);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    int                  w          - The buffer's width.
+ *    int                  h          - The buffer's height.
+ * DESCRIPTION
+ *    Move the cursor one position to the right, wrapping at the end of
+ *    the line and the end of the display.
+ *****/
+static inline void tn5250_dbuffer_advance(Tn5250DBuffer* This, int w, int h) {
+    if (++This->cx == w) {
+        This->cx = 0;
+        if (++This->cy == h) {
+            This->cy = 0;
+        }
+    }
+    return;
+}
+
+/****f* lib5250/tn5250_dbuffer_addstr
+ * NAME
+ *    tn5250_dbuffer_addstr
+ * SYNOPSIS
+ *    tn5250_dbuffer_addstr (This, s, len);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    const unsigned char * s         - Characters to write.
+ *    int                  len        - Number of characters in s.
+ * DESCRIPTION
+ *    Write a run of characters at the cursor position and advance the
+ *    cursor past them, wrapping at the end of each row and at the end of
+ *    the display.  This does the same as calling tn5250_dbuffer_addch
+ *    for each character, but copies whole rows at a time.
+ *****/
+void tn5250_dbuffer_addstr(Tn5250DBuffer* This, const unsigned char* s,
+                           int len) {
+    tn5250_dbuffer_touch(This);
+    ASSERT_VALID(This);
+
+    /* Cursor movement over a menu bar depends on the menu bar, so leave
+     * that to tn5250_dbuffer_right. */
+    if (This->menubar_count > 0) {
+        while (len-- > 0) {
+            tn5250_dbuffer_addch(This, *s++);
+        }
+        return;
+    }
+
+    tn5250_dbuffer_put(This, s, 0, len);
+
+    ASSERT_VALID(This);
+    return;
+}
+
+/****f* lib5250/tn5250_dbuffer_repeat
+ * NAME
+ *    tn5250_dbuffer_repeat
+ * SYNOPSIS
+ *    tn5250_dbuffer_repeat (This, c, count);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    unsigned char        c          - Character to write.
+ *    int                  count      - Number of times to write it.
+ * DESCRIPTION
+ *    Write count copies of c at the cursor position and advance the cursor
+ *    past them, wrapping like tn5250_dbuffer_addstr does.  Used for the
+ *    Repeat to Address order.
+ *****/
+void tn5250_dbuffer_repeat(Tn5250DBuffer* This, unsigned char c, int count) {
+    tn5250_dbuffer_touch(This);
+    ASSERT_VALID(This);
+
+    if (This->menubar_count > 0) {
+        while (count-- > 0) {
+            tn5250_dbuffer_addch(This, c);
+        }
+        return;
+    }
+
+    tn5250_dbuffer_put(This, NULL, c, count);
 
     ASSERT_VALID(This);
     return;
 }
 
+/****i* lib5250/tn5250_dbuffer_put
+ * NAME
+ *    tn5250_dbuffer_put
+ * SYNOPSIS
+ *    tn5250_dbuffer_put (This, s, c, len);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    const unsigned char * s          - Characters to write, or NULL.
+ *    unsigned char        c          - Character to repeat if s is NULL.
+ *    int                  len        - Number of positions to write.
+ * DESCRIPTION
+ *    Write len characters at the cursor and leave the cursor after them,
+ *    wrapping from the end of the display to the top.  This is the body
+ *    of tn5250_dbuffer_addstr and tn5250_dbuffer_repeat, without menu
+ *    bar handling.
+ *****/
+static void tn5250_dbuffer_put(Tn5250DBuffer* This, const unsigned char* s,
+                               unsigned char c, int len) {
+    if (This->w == 80 && This->h == 24) {
+        tn5250_dbuffer_put_rows(This, s, c, len, 80, 24);
+    }
+    else if (This->w == 132 && This->h == 27) {
+        tn5250_dbuffer_put_rows(This, s, c, len, 132, 27);
+    }
+    else {
+        tn5250_dbuffer_put_rows(This, s, c, len, This->w, This->h);
+    }
+    return;
+}
+
+/****i* lib5250/tn5250_dbuffer_put_rows
+ * NAME
+ *    tn5250_dbuffer_put_rows
+ * SYNOPSIS
+ *    tn5250_dbuffer_put_rows (This, s, c, len, w, h);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    const unsigned char * s          - Characters to write, or NULL.
+ *    unsigned char        c          - Character to repeat if s is NULL.
+ *    int                  len        - Number of positions to write.
+ *    int                  w          - The buffer's width.
+ *    int                  h          - The buffer's height.
+ * DESCRIPTION
+ *    The body of tn5250_dbuffer_put.  Only the last screenful of a longer
+ *    run survives the wrap.  Whole rows are written with a length of w.
+ *****/
+static inline void tn5250_dbuffer_put_rows(Tn5250DBuffer* This,
+                                           const unsigned char* s,
+                                           unsigned char c, int len, int w,
+                                           int h) {
+    unsigned char* row;
+    int pos, n;
+
+    if (len > w * h) {
+        pos = This->cy * w + This->cx + len - w * h;
+        This->cy = (pos / w) % h;
+        This->cx = pos % w;
+        if (s != NULL) {
+            s += len - w * h;
+        }
+        len = w * h;
+    }
+    while (len > 0) {
+        row = tn5250_dbuffer_row(This, This->cy) + This->cx;
+        if (This->cx == 0 && len >= w) {
+            n = w;
+            if (s != NULL) {
+                memcpy(row, s, w);
+            }
+            else {
+                memset(row, c, w);
+            }
+        }
+        else {
+            n = w - This->cx;
+            if (n > len) {
+                n = len;
+            }
+            if (s != NULL) {
+                memcpy(row, s, n);
+            }
+            else {
+                memset(row, c, n);
+            }
+        }
+        if (s != NULL) {
+            s += n;
+        }
+        len -= n;
+        if ((This->cx += n) == w) {
+            This->cx = 0;
+            if (++This->cy == h) {
+                This->cy = 0;
+            }
+        }
+    }
+    return;
+}
+
 /****f* lib5250/tn5250_dbuffer_del
  * NAME
  *    tn5250_dbuffer_del
@@ -692,45 +1243,27 @@ void tn5250_dbuffer_addch(Tn5250DBuffer* This, unsigned char c) {
  *****/
 void tn5250_dbuffer_del(Tn5250DBuffer* This, int fieldid, int shiftcount) {
     Tn5250Field *iter, *field;
-    int x = This->cx, y = This->cy, fwdx, fwdy, i;
+    int pos = This->cy * This->w + This->cx, end = pos + shiftcount;
+    unsigned char c;
 
-    field = tn5250_field_list_find_by_id(This->field_list, fieldid);
-    iter = field;
-
-    while (tn5250_field_is_continued(iter)) {
-        if (tn5250_field_is_continued_last(iter)) {
-            break;
-        }
-        iter = iter->next;
-        shiftcount = shiftcount + tn5250_field_count_right(
-                                      iter, tn5250_field_start_row(iter),
-                                      tn5250_field_start_col(iter));
+    tn5250_dbuffer_touch(This);
+    if ((field = tn5250_dbuffer_field(This, fieldid)) == NULL) {
+        return;
     }
 
+    /* Shift each segment of a continued field left on its own, pulling
+     * the first character of the next segment into its last position. */
     iter = field;
-
-    for (i = 0; i < shiftcount; i++) {
-        fwdx = x + 1;
-        fwdy = y;
-        if (fwdx == This->w) {
-            fwdx = 0;
-            fwdy++;
-        }
-
-        if (tn5250_field_is_continued(iter) &&
-            (!tn5250_field_is_continued_last(iter)) &&
-            (fwdx > tn5250_field_end_col(iter))) {
-            iter = iter->next;
-            fwdx = tn5250_field_start_col(iter);
-            fwdy = tn5250_field_start_row(iter);
-            i--;
-        }
-
-        This->data[y * This->w + x] = This->data[fwdy * This->w + fwdx];
-        x = fwdx;
-        y = fwdy;
+    while (tn5250_field_is_continued(iter) &&
+           !tn5250_field_is_continued_last(iter)) {
+        iter = iter->next;
+        c = tn5250_dbuffer_cell(This, tn5250_field_start_row(iter),
+                                tn5250_field_start_col(iter));
+        tn5250_dbuffer_shift_left(This, pos, end, c);
+        pos = tn5250_field_start_pos(iter);
+        end = tn5250_field_end_pos(iter);
     }
-    This->data[y * This->w + x] = 0x00;
+    tn5250_dbuffer_shift_left(This, pos, end, 0x00);
 
     ASSERT_VALID(This);
     return;
@@ -755,20 +1288,11 @@ void tn5250_dbuffer_del_this_field_only(Tn5250DBuffer* This, int shiftcount) {
      * continuous field group.  The only this should ever be necessary is
      * when deleting a character from a wordwrap field.
      */
-    int x = This->cx, y = This->cy, fwdx, fwdy, i;
-
-    for (i = 0; i < shiftcount; i++) {
-        fwdx = x + 1;
-        fwdy = y;
-        if (fwdx == This->w) {
-            fwdx = 0;
-            fwdy++;
-        }
-        This->data[y * This->w + x] = This->data[fwdy * This->w + fwdx];
-        x = fwdx;
-        y = fwdy;
-    }
-    This->data[y * This->w + x] = TN5250_DISPLAY_WORD_WRAP_SPACE;
+    int pos = This->cy * This->w + This->cx;
+
+    tn5250_dbuffer_touch(This);
+    tn5250_dbuffer_shift_left(This, pos, pos + shiftcount,
+                              TN5250_DISPLAY_WORD_WRAP_SPACE);
 
     ASSERT_VALID(This);
     return;
@@ -790,42 +1314,24 @@ void tn5250_dbuffer_del_this_field_only(Tn5250DBuffer* This, int shiftcount) {
 void tn5250_dbuffer_ins(Tn5250DBuffer* This, int fieldid, unsigned char c,
                         int shiftcount) {
     Tn5250Field *iter, *field;
-    int x = This->cx, y = This->cy, i;
-    unsigned char c2;
-
-    field = tn5250_field_list_find_by_id(This->field_list, fieldid);
-    iter = field;
+    int pos = This->cy * This->w + This->cx, end = pos + shiftcount;
 
-    while (tn5250_field_is_continued(iter)) {
-        if (tn5250_field_is_continued_last(iter)) {
-            break;
-        }
-        iter = iter->next;
-        shiftcount = shiftcount + tn5250_field_count_right(
-                                      iter, tn5250_field_start_row(iter),
-                                      tn5250_field_start_col(iter));
+    tn5250_dbuffer_touch(This);
+    if ((field = tn5250_dbuffer_field(This, fieldid)) == NULL) {
+        return;
     }
 
+    /* Shift each segment of a continued field right on its own, carrying
+     * the character pushed off its end to the start of the next one. */
     iter = field;
-
-    for (i = 0; i <= shiftcount; i++) {
-        c2 = This->data[y * This->w + x];
-        This->data[y * This->w + x] = c;
-        c = c2;
-        if (++x == This->w) {
-            x = 0;
-            y++;
-        }
-
-        if (tn5250_field_is_continued(iter) &&
-            (!tn5250_field_is_continued_last(iter)) &&
-            (x > tn5250_field_end_col(iter))) {
-            iter = iter->next;
-            x = tn5250_field_start_col(iter);
-            y = tn5250_field_start_row(iter);
-            i--;
-        }
+    while (tn5250_field_is_continued(iter) &&
+           !tn5250_field_is_continued_last(iter)) {
+        c = tn5250_dbuffer_shift_right(This, pos, end, c);
+        iter = iter->next;
+        pos = tn5250_field_start_pos(iter);
+        end = tn5250_field_end_pos(iter);
     }
+    tn5250_dbuffer_shift_right(This, pos, end, c);
 
     tn5250_dbuffer_right(This, 1);
 
@@ -833,6 +1339,84 @@ void tn5250_dbuffer_ins(Tn5250DBuffer* This, int fieldid, unsigned char c,
     return;
 }
 
+/****i* lib5250/tn5250_dbuffer_shift_left
+ * NAME
+ *    tn5250_dbuffer_shift_left
+ * SYNOPSIS
+ *    tn5250_dbuffer_shift_left (This, from, to, c);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    int                  from       - Buffer position of the first cell.
+ *    int                  to         - Buffer position of the last cell.
+ *    unsigned char        c          - Character for the last cell.
+ * DESCRIPTION
+ *    Move the cells from + 1 through to one position to the left, and
+ *    put c in the last one.  The character at from is lost.  Positions
+ *    count across the display from the top left, so the run may cover
+ *    more than one row; each row is moved with a single memmove.
+ *****/
+static void tn5250_dbuffer_shift_left(Tn5250DBuffer* This, int from, int to,
+                                      unsigned char c) {
+    unsigned char* row;
+    int y = from / This->w, x = from % This->w, n;
+
+    TN5250_ASSERT(from >= 0 && from <= to && to < This->w * This->h);
+
+    while (from <= to) {
+        n = This->w - x;
+        if (n > to - from + 1) {
+            n = to - from + 1;
+        }
+        row = tn5250_dbuffer_row(This, y);
+        memmove(row + x, row + x + 1, n - 1);
+        row[x + n - 1] = (from + n <= to) ? tn5250_dbuffer_row(This, y + 1)[0]
+                                          : c;
+        from += n;
+        x = 0;
+        y++;
+    }
+    return;
+}
+
+/****i* lib5250/tn5250_dbuffer_shift_right
+ * NAME
+ *    tn5250_dbuffer_shift_right
+ * SYNOPSIS
+ *    c = tn5250_dbuffer_shift_right (This, from, to, c);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    int                  from       - Buffer position of the first cell.
+ *    int                  to         - Buffer position of the last cell.
+ *    unsigned char        c          - Character for the first cell.
+ * DESCRIPTION
+ *    Move the cells from through to - 1 one position to the right, and
+ *    put c in the first one.  Returns the character that was at to.
+ *****/
+static unsigned char tn5250_dbuffer_shift_right(Tn5250DBuffer* This, int from,
+                                                int to, unsigned char c) {
+    unsigned char* row;
+    unsigned char out;
+    int y = from / This->w, x = from % This->w, n;
+
+    TN5250_ASSERT(from >= 0 && from <= to && to < This->w * This->h);
+
+    while (from <= to) {
+        n = This->w - x;
+        if (n > to - from + 1) {
+            n = to - from + 1;
+        }
+        row = tn5250_dbuffer_row(This, y);
+        out = row[x + n - 1];
+        memmove(row + x + 1, row + x, n - 1);
+        row[x] = c;
+        c = out;
+        from += n;
+        x = 0;
+        y++;
+    }
+    return c;
+}
+
 /****f* lib5250/tn5250_dbuffer_set_ic
  * NAME
  *    tn5250_dbuffer_set_ic
@@ -864,39 +1448,253 @@ void tn5250_dbuffer_set_ic(Tn5250DBuffer* This, int y, int x) {
  *    int                  bot        -
  *    int                  lines      -
  * DESCRIPTION
- *    DOCUMENT ME!!!
+ *    Roll the rows from top to bot up (lines < 0) or down (lines > 0).
+ *    Rows rolled out of the region are lost and the rows vacated are
+ *    cleared.  Only the row pointers are rotated; the characters stay
+ *    where they are.
  *****/
 void tn5250_dbuffer_roll(Tn5250DBuffer* This, int top, int bot, int lines) {
-    int n, c;
+    int count, n;
 
+    tn5250_dbuffer_touch(This);
     ASSERT_VALID(This);
 
-    if (lines == 0) {
+    if (bot >= This->h) {
+        bot = This->h - 1;
+    }
+    if (lines == 0 || top < 0 || top > bot) {
         return;
     }
+    count = bot - top + 1;
+
+    n = lines < 0 ? -lines : lines;
+    if (n < count) {
+        /* Rolling up by n is rotating the region's rows left by n, and
+         * rolling down is rotating them right. */
+        tn5250_dbuffer_rotate_rows(This, top, count, lines < 0 ? n : count - n);
+        This->rows_rolled = 1;
+    }
+    else {
+        n = count;
+    }
 
-    if (lines < 0) {
-        /* Move text up */
-        for (n = top; n <= bot; n++) {
-            if (n + lines >= top) {
-                for (c = 0; c < This->w; c++) {
-                    This->data[(n + lines) * This->w + c] =
-                        This->data[n * This->w + c];
-                }
-            }
+    /* Clear the rows which were vacated by the roll. */
+    while (n-- > 0) {
+        memset(tn5250_dbuffer_row(This, lines < 0 ? bot - n : top + n), 0x00,
+               This->w);
+    }
+
+    ASSERT_VALID(This);
+    return;
+}
+
+/****f* lib5250/tn5250_dbuffer_data
+ * NAME
+ *    tn5250_dbuffer_data
+ * SYNOPSIS
+ *    data = tn5250_dbuffer_data (This);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ * DESCRIPTION
+ *    Return the contents of the display buffer as one flat array, row
+ *    after row.  If a roll has left the rows out of order, they are put
+ *    back in order first.  The pointer is good until the next roll or
+ *    resize.
+ *****/
+unsigned char* tn5250_dbuffer_data(Tn5250DBuffer* This) {
+    unsigned char *slot, *a, *b, t;
+    int y, j, x;
+
+    if (!This->rows_rolled) {
+        return This->data;
+    }
+
+    /* Swap rows into place one at a time.  Each swap puts at least one
+     * row where it belongs, so this moves each row at most once or twice. */
+    for (y = 0; y < This->h; y++) {
+        slot = This->data + y * This->w;
+        if (This->rows[y] == slot) {
+            continue;
+        }
+        for (j = y + 1; This->rows[j] != slot; j++) {
         }
+        a = This->rows[y];
+        b = slot;
+        for (x = 0; x < This->w; x++) {
+            t = a[x];
+            a[x] = b[x];
+            b[x] = t;
+        }
+        This->rows[j] = This->rows[y];
+        This->rows[y] = slot;
     }
-    else {
-        for (n = bot; n >= top; n--) {
-            if (n + lines <= bot) {
-                for (c = 0; c < This->w; c++) {
-                    This->data[(n + lines) * This->w + c] =
-                        This->data[n * This->w + c];
-                }
-            }
+    This->rows_rolled = 0;
+    return This->data;
+}
+
+/* 32 bit FNV-1a, kept to 32 bits even where unsigned long is wider so
+ * that a fingerprint means the same thing on every platform. */
+#define FINGERPRINT_BASIS 2166136261UL
+#define FINGERPRINT_PRIME 16777619UL
+#define FINGERPRINT_BYTE(h, c)                                                 \
+    ((h) = (((h) ^ (unsigned char)(c)) * FINGERPRINT_PRIME) & 0xffffffffUL)
+#define FINGERPRINT_WORD(h, v)                                                 \
+    (FINGERPRINT_BYTE(h, (v) >> 8), FINGERPRINT_BYTE(h, (v)))
+
+/****f* lib5250/tn5250_dbuffer_fingerprint
+ * NAME
+ *    tn5250_dbuffer_fingerprint
+ * SYNOPSIS
+ *    hash = tn5250_dbuffer_fingerprint (This);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ * DESCRIPTION
+ *    Return a 32 bit hash of everything on the screen: its size, every
+ *    character, and the format table (see
+ *    tn5250_dbuffer_format_fingerprint).  Scripts can compare it with a
+ *    value seen before to recognise a screen, or poll it to wait for a
+ *    screen to change, without scraping text.  The cursor position is
+ *    not included.
+ *
+ *    Both hashes are kept until the buffer is next touched, so asking
+ *    again for an unchanged screen costs nothing.
+ *****/
+unsigned long tn5250_dbuffer_fingerprint(Tn5250DBuffer* This) {
+    tn5250_dbuffer_update_fingerprint(This);
+    return This->fingerprint;
+}
+
+/****f* lib5250/tn5250_dbuffer_format_fingerprint
+ * NAME
+ *    tn5250_dbuffer_format_fingerprint
+ * SYNOPSIS
+ *    hash = tn5250_dbuffer_format_fingerprint (This);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ * DESCRIPTION
+ *    Return a 32 bit hash of the screen size and the format table: the
+ *    position, length, attribute and FFW of each field.  The MDT bit is
+ *    left out, so this stays the same while the user types into the
+ *    fields, and identifies a screen layout regardless of its data.
+ *****/
+unsigned long tn5250_dbuffer_format_fingerprint(Tn5250DBuffer* This) {
+    tn5250_dbuffer_update_fingerprint(This);
+    return This->format_fingerprint;
+}
+
+/****i* lib5250/tn5250_dbuffer_update_fingerprint
+ * NAME
+ *    tn5250_dbuffer_update_fingerprint
+ * SYNOPSIS
+ *    tn5250_dbuffer_update_fingerprint (This);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ * DESCRIPTION
+ *    Work out both fingerprints again if the buffer has been touched
+ *    since they were last worked out.  The rows are hashed in screen
+ *    order through the row table, so a rolled buffer gives the same
+ *    result as an unrolled one with the same contents.
+ *****/
+static void tn5250_dbuffer_update_fingerprint(Tn5250DBuffer* This) {
+    Tn5250Field* field;
+    unsigned long h = FINGERPRINT_BASIS;
+    const unsigned char* row;
+    int i, x, y;
+
+    if (This->fingerprint_valid &&
+        This->fingerprint_generation == This->generation) {
+        return;
+    }
+
+    FINGERPRINT_WORD(h, This->w);
+    FINGERPRINT_WORD(h, This->h);
+    for (i = 0; i < This->field_count; i++) {
+        field = &This->field_table[i];
+        FINGERPRINT_WORD(h, tn5250_field_start_pos(field));
+        FINGERPRINT_WORD(h, tn5250_field_length(field));
+        FINGERPRINT_WORD(h, field->FFW & ~TN5250_FIELD_MODIFIED);
+        FINGERPRINT_BYTE(h, field->attribute);
+    }
+    This->format_fingerprint = h;
+
+    for (y = 0; y < This->h; y++) {
+        row = tn5250_dbuffer_row(This, y);
+        for (x = 0; x < This->w; x++) {
+            FINGERPRINT_BYTE(h, row[x]);
         }
     }
-    ASSERT_VALID(This);
+    This->fingerprint = h;
+
+    This->fingerprint_generation = This->generation;
+    This->fingerprint_valid = 1;
+    return;
+}
+
+/****i* lib5250/tn5250_dbuffer_reset_rows
+ * NAME
+ *    tn5250_dbuffer_reset_rows
+ * SYNOPSIS
+ *    tn5250_dbuffer_reset_rows (This);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ * DESCRIPTION
+ *    Point each row at its own place in the data array, discarding any
+ *    reordering left by rolls.  Only use this when the contents are about
+ *    to be replaced anyway.
+ *****/
+static void tn5250_dbuffer_reset_rows(Tn5250DBuffer* This) {
+    int y;
+
+    for (y = 0; y < This->h; y++) {
+        This->rows[y] = This->data + y * This->w;
+    }
+    This->rows_rolled = 0;
+    return;
+}
+
+/****i* lib5250/tn5250_dbuffer_rotate_rows
+ * NAME
+ *    tn5250_dbuffer_rotate_rows
+ * SYNOPSIS
+ *    tn5250_dbuffer_rotate_rows (This, top, count, n);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    int                  top        - First row of the region.
+ *    int                  count      - Number of rows in the region.
+ *    int                  n          - Number of rows to rotate left by.
+ * DESCRIPTION
+ *    Rotate the row pointers of a region in place, so that row top + n
+ *    becomes row top.  Only pointers move, not the characters.
+ *****/
+static void tn5250_dbuffer_rotate_rows(Tn5250DBuffer* This, int top, int count,
+                                       int n) {
+    tn5250_dbuffer_reverse_rows(This, top, top + n - 1);
+    tn5250_dbuffer_reverse_rows(This, top + n, top + count - 1);
+    tn5250_dbuffer_reverse_rows(This, top, top + count - 1);
+    return;
+}
+
+/****i* lib5250/tn5250_dbuffer_reverse_rows
+ * NAME
+ *    tn5250_dbuffer_reverse_rows
+ * SYNOPSIS
+ *    tn5250_dbuffer_reverse_rows (This, first, last);
+ * INPUTS
+ *    Tn5250DBuffer *      This       -
+ *    int                  first      -
+ *    int                  last       -
+ * DESCRIPTION
+ *    Reverse the order of the row pointers from first to last inclusive.
+ *****/
+static void tn5250_dbuffer_reverse_rows(Tn5250DBuffer* This, int first,
+                                        int last) {
+    unsigned char* t;
+
+    while (first < last) {
+        t = This->rows[first];
+        This->rows[first++] = This->rows[last];
+        This->rows[last--] = t;
+    }
     return;
 }
 
@@ -918,7 +1716,7 @@ unsigned char tn5250_dbuffer_char_at(Tn5250DBuffer* This, int y, int x) {
     TN5250_ASSERT(x >= 0);
     TN5250_ASSERT(y < This->h);
     TN5250_ASSERT(x < This->w);
-    return This->data[y * This->w + x];
+    return tn5250_dbuffer_cell(This, y, x);
 }
 
 /****f* lib5250/tn5250_dbuffer_msg_line
@@ -957,6 +1755,7 @@ void tn5250_dbuffer_prevword(Tn5250DBuffer* This) {
     int state = 0;
     int maxiter;
 
+    tn5250_dbuffer_touch(This);
     TN5250_LOG(("dbuffer_prevword: entered.\n"));
 
     maxiter = (This->w * This->h);
@@ -966,17 +1765,17 @@ void tn5250_dbuffer_prevword(Tn5250DBuffer* This) {
         tn5250_dbuffer_left(This);
         switch (state) {
         case 0:
-            if (This->data[This->cy * This->w + This->cx] <= 0x40) {
+            if (tn5250_dbuffer_cell(This, This->cy, This->cx) <= 0x40) {
                 state++;
             }
             break;
         case 1:
-            if (This->data[This->cy * This->w + This->cx] > 0x40) {
+            if (tn5250_dbuffer_cell(This, This->cy, This->cx) > 0x40) {
                 state++;
             }
             break;
         case 2:
-            if (This->data[This->cy * This->w + This->cx] <= 0x40) {
+            if (tn5250_dbuffer_cell(This, This->cy, This->cx) <= 0x40) {
                 tn5250_dbuffer_right(This, 1);
                 return;
             }
@@ -1000,6 +1799,7 @@ void tn5250_dbuffer_nextword(Tn5250DBuffer* This) {
     int foundblank = 0;
     int maxiter;
 
+    tn5250_dbuffer_touch(This);
     TN5250_LOG(("dbuffer_nextword: entered.\n"));
 
     maxiter = (This->w * This->h);
@@ -1007,11 +1807,11 @@ void tn5250_dbuffer_nextword(Tn5250DBuffer* This) {
 
     while (--maxiter) {
         tn5250_dbuffer_right(This, 1);
-        if (This->data[This->cy * This->w + This->cx] <= 0x40) {
+        if (tn5250_dbuffer_cell(This, This->cy, This->cx) <= 0x40) {
             foundblank++;
         }
         if ((foundblank) &&
-            (This->data[This->cy * This->w + This->cx] > 0x40)) {
+            (tn5250_dbuffer_cell(This, This->cy, This->cx) > 0x40)) {
             break;
         }
     }
@@ -1032,6 +1832,7 @@ void tn5250_dbuffer_nextword(Tn5250DBuffer* This) {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_add_window(Tn5250DBuffer* This, Tn5250Window* window) {
+    tn5250_dbuffer_touch(This);
     window->id = This->window_count++;
     window->table = This;
     This->window_list = tn5250_window_list_add(This->window_list, window);
@@ -1053,6 +1854,7 @@ void tn5250_dbuffer_add_window(Tn5250DBuffer* This, Tn5250Window* window) {
  *****/
 void tn5250_dbuffer_add_scrollbar(Tn5250DBuffer* This,
                                   Tn5250Scrollbar* scrollbar) {
+    tn5250_dbuffer_touch(This);
     scrollbar->id = This->scrollbar_count++;
     scrollbar->table = This;
     This->scrollbar_list =
@@ -1074,6 +1876,7 @@ void tn5250_dbuffer_add_scrollbar(Tn5250DBuffer* This,
  *    DOCUMENT ME!!!
  *****/
 void tn5250_dbuffer_add_menubar(Tn5250DBuffer* This, Tn5250Menubar* menubar) {
+    tn5250_dbuffer_touch(This);
     menubar->id = This->menubar_count++;
     menubar->table = This;
     This->menubar_list = tn5250_menubar_list_add(This->menubar_list, menubar);
@@ -46,7 +46,21 @@ struct _Tn5250DBuffer {
     int w, h;
     int cx, cy;   /* Cursor Position */
     int tcx, tcy; /* for set_new_ic */
+
+    /* generation is bumped by tn5250_dbuffer_touch() whenever the buffer
+     * or its format table might have changed.  Together with serial, which
+     * is unique to each buffer, it tells a cached copy of the buffer's
+     * contents whether it is still current. */
+    unsigned long serial;
+    unsigned long generation;
+
+    /* The characters live in data, but are addressed through rows so that
+     * rolling a region only has to rotate row pointers.  After a roll the
+     * rows are no longer in order within data; tn5250_dbuffer_data() puts
+     * them back for anything that needs the buffer as one flat array. */
     unsigned char /*@notnull@ */* data;
+    unsigned char /*@notnull@ */** rows;
+    int rows_rolled;
 
     /* Stuff from the old Tn5250Table structure. */
     struct _Tn5250Field /*@null@ */* field_list;
@@ -60,12 +74,34 @@ struct _Tn5250DBuffer {
     int menubar_count;
     int master_mdt;
 
+    /* The fields themselves live in field_table, indexed by id, which is
+     * also their order in field_list.  field_start and field_end hold the
+     * first and last position of each field so that finding the field
+     * at a position doesn't have to look at the fields at all, and
+     * mdt_bits has a bit for each field which is set while its MDT is on,
+     * so that reading the modified fields only has to visit those.
+     * field_w is the display width all the fields were made for, or -1
+     * if they don't agree. */
+    struct _Tn5250Field* field_table;
+    int* field_start;
+    int* field_end;
+    unsigned long* mdt_bits;
+    int field_table_size;
+    int field_w;
+
     /* Header data (from SOH order) is saved here.  We even save data that
      * we don't understand here so we can insert that into our generated
      * WTD orders for save/restore screen. */
     unsigned char* header_data;
     int header_length;
 
+    /* Fingerprints from tn5250_dbuffer_fingerprint(), good while
+     * generation is still fingerprint_generation. */
+    unsigned long fingerprint;
+    unsigned long format_fingerprint;
+    unsigned long fingerprint_generation;
+    int fingerprint_valid;
+
     /* This slot is reserved for scripting language bindings. */
     void* script_slot;
 };
@@ -90,6 +126,10 @@ extern void tn5250_dbuffer_down(Tn5250DBuffer* This);
 extern void tn5250_dbuffer_goto_ic(Tn5250DBuffer* This);
 
 extern void tn5250_dbuffer_addch(Tn5250DBuffer* This, unsigned char c);
+extern void tn5250_dbuffer_addstr(Tn5250DBuffer* This, const unsigned char* s,
+                                  int len);
+extern void tn5250_dbuffer_repeat(Tn5250DBuffer* This, unsigned char c,
+                                  int count);
 extern void tn5250_dbuffer_del(Tn5250DBuffer* This, int fieldid,
                                int shiftcount);
 extern void tn5250_dbuffer_del_this_field_only(Tn5250DBuffer* This,
@@ -101,17 +141,27 @@ extern void tn5250_dbuffer_roll(Tn5250DBuffer* This, int top, int bot,
                                 int lines);
 
 extern unsigned char tn5250_dbuffer_char_at(Tn5250DBuffer* This, int y, int x);
+extern unsigned char* tn5250_dbuffer_data(Tn5250DBuffer* This);
+extern unsigned long tn5250_dbuffer_fingerprint(Tn5250DBuffer* This);
+extern unsigned long tn5250_dbuffer_format_fingerprint(Tn5250DBuffer* This);
 extern void tn5250_dbuffer_prevword(Tn5250DBuffer* This);
 extern void tn5250_dbuffer_nextword(Tn5250DBuffer* This);
 
-#define tn5250_dbuffer_width(This)    ((This)->w)
-#define tn5250_dbuffer_height(This)   ((This)->h)
-#define tn5250_dbuffer_cursor_x(This) ((This)->cx)
-#define tn5250_dbuffer_cursor_y(This) ((This)->cy)
+#define tn5250_dbuffer_width(This)      ((This)->w)
+#define tn5250_dbuffer_height(This)     ((This)->h)
+#define tn5250_dbuffer_cursor_x(This)   ((This)->cx)
+#define tn5250_dbuffer_cursor_y(This)   ((This)->cy)
+#define tn5250_dbuffer_row(This, y)     ((This)->rows[(y)])
+#define tn5250_dbuffer_cell(This, y, x) ((This)->rows[(y)][(x)])
+#define tn5250_dbuffer_serial(This)     ((This)->serial)
+#define tn5250_dbuffer_generation(This) ((This)->generation)
+#define tn5250_dbuffer_touch(This)      ((void)((This)->generation++))
 
 /* Format table manipulation. */
-extern void tn5250_dbuffer_add_field(Tn5250DBuffer* This,
-                                     struct _Tn5250Field* field);
+extern struct _Tn5250Field*
+tn5250_dbuffer_add_field_copy(Tn5250DBuffer* This,
+                              const struct _Tn5250Field* field);
+extern struct _Tn5250Field* tn5250_dbuffer_field(Tn5250DBuffer* This, int id);
 extern void tn5250_dbuffer_clear_table(Tn5250DBuffer* This);
 extern struct _Tn5250Field* tn5250_dbuffer_field_yx(Tn5250DBuffer* This, int y,
                                                     int x);
@@ -123,6 +173,10 @@ extern unsigned char* tn5250_dbuffer_field_data(Tn5250DBuffer* This,
 extern int tn5250_dbuffer_msg_line(Tn5250DBuffer* This);
 extern struct _Tn5250Field*
 tn5250_dbuffer_first_non_bypass(Tn5250DBuffer* This);
+extern void tn5250_dbuffer_update_mdt(Tn5250DBuffer* This,
+                                      struct _Tn5250Field* field);
+extern struct _Tn5250Field*
+tn5250_dbuffer_next_mdt_field(Tn5250DBuffer* This, struct _Tn5250Field* field);
 extern void tn5250_dbuffer_add_window(Tn5250DBuffer* This,
                                       struct _Tn5250Window* window);
 extern void tn5250_dbuffer_add_scrollbar(Tn5250DBuffer* This,
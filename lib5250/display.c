@@ -32,6 +32,9 @@ void tn5250_display_wordwrap_delete(Tn5250Display* This);
 void tn5250_display_wordwrap_insert(Tn5250Display* This, unsigned char c,
                                     int shiftcount);
 void tn5250_display_wordwrap_addch(Tn5250Display* This, unsigned char c);
+static void tn5250_display_wordwrap_line(Tn5250Display* This,
+                                         Tn5250Field* field, char* line,
+                                         int len);
 int display_check_pccmd(Tn5250Display* This);
 
 /****f* lib5250/tn5250_display_new
@@ -56,6 +59,12 @@ Tn5250Display* tn5250_display_new() {
     This->config = NULL;
     This->indicators = 0;
     This->indicators_dirty = 0;
+    This->update_batch = 0;
+    This->update_pending = 0;
+    This->update_interval = 0;
+    This->last_update = 0;
+    This->updates_requested = 0;
+    This->updates_rendered = 0;
     This->pending_insert = 0;
     This->destructive_backspace = 0;
     This->sign_key_hack = 1;
@@ -158,6 +167,15 @@ int tn5250_display_config(Tn5250Display* This, Tn5250Config* config) {
             tn5250_config_get_bool(config, "field_minus_in_char");
     }
 
+    /* Minimum time between terminal updates, in milliseconds */
+    if (tn5250_config_get(config, "update_interval")) {
+        This->update_interval =
+            tn5250_config_get_int(config, "update_interval");
+        if (This->update_interval < 0) {
+            This->update_interval = 0;
+        }
+    }
+
     /* Set a terminal type if necessary */
     termtype = tn5250_config_get(config, "env.TERM");
 
@@ -230,8 +248,10 @@ Tn5250DBuffer* tn5250_display_push_dbuffer(Tn5250Display* This) {
  *    Tn5250DBuffer *      id         -
  * DESCRIPTION
  *    Delete the current dbuffer and replace it with the one with id `id'.
+ *    Returns 0 on success, or -1 if there is no such display buffer (or
+ *    it is the current one), in which case nothing is changed.
  *****/
-void tn5250_display_restore_dbuffer(Tn5250Display* This, Tn5250DBuffer* id) {
+int tn5250_display_restore_dbuffer(Tn5250Display* This, Tn5250DBuffer* id) {
     Tn5250DBuffer* iter;
 
     /* Sanity check to make sure that the display buffer is for real and
@@ -245,17 +265,48 @@ void tn5250_display_restore_dbuffer(Tn5250Display* This, Tn5250DBuffer* id) {
         } while (iter != This->display_buffers);
 
         if (iter != id || iter == This->display_buffers) {
-            return;
+            return -1;
         }
     }
     else {
-        return;
+        return -1;
     }
 
     This->display_buffers->prev->next = This->display_buffers->next;
     This->display_buffers->next->prev = This->display_buffers->prev;
     tn5250_dbuffer_destroy(This->display_buffers);
     This->display_buffers = iter;
+    return 0;
+}
+
+/****f* lib5250/tn5250_display_discard_dbuffer
+ * NAME
+ *    tn5250_display_discard_dbuffer
+ * SYNOPSIS
+ *    tn5250_display_discard_dbuffer (This, id);
+ * INPUTS
+ *    Tn5250Display *      This       -
+ *    Tn5250DBuffer *      id         -
+ * DESCRIPTION
+ *    Destroy a display buffer which was put aside by
+ *    tn5250_display_push_dbuffer and will not be restored.  The current
+ *    display buffer is never destroyed.
+ *****/
+void tn5250_display_discard_dbuffer(Tn5250Display* This, Tn5250DBuffer* id) {
+    Tn5250DBuffer* iter;
+
+    if ((iter = This->display_buffers) == NULL) {
+        return;
+    }
+    do {
+        if (iter == id && iter != This->display_buffers) {
+            iter->prev->next = iter->next;
+            iter->next->prev = iter->prev;
+            tn5250_dbuffer_destroy(iter);
+            return;
+        }
+        iter = iter->next;
+    } while (iter != This->display_buffers);
     return;
 }
 
@@ -310,22 +361,93 @@ void tn5250_display_set_terminal(Tn5250Display* This, Tn5250Terminal* term) {
     return;
 }
 
-/****f* lib5250/tn5250_display_update
+/****i* lib5250/tn5250_display_ticks
  * NAME
- *    tn5250_display_update
+ *    tn5250_display_ticks
  * SYNOPSIS
- *    tn5250_display_update (This);
+ *    now = tn5250_display_ticks ();
+ * INPUTS
+ *    None
+ * DESCRIPTION
+ *    Return a millisecond clock for pacing terminal updates.  Only the
+ *    difference between two values is meaningful.
+ *****/
+static unsigned long tn5250_display_ticks(void) {
+#ifdef _WIN32
+    return (unsigned long)GetTickCount();
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (unsigned long)tv.tv_sec * 1000UL +
+           (unsigned long)(tv.tv_usec / 1000);
+#endif
+}
+
+/****i* lib5250/tn5250_display_data_ready
+ * NAME
+ *    tn5250_display_data_ready
+ * SYNOPSIS
+ *    ready = tn5250_display_data_ready (This);
  * INPUTS
  *    Tn5250Display *      This       -
  * DESCRIPTION
- *    Update the terminal's representation of the display.
+ *    Return non-zero if host data is waiting on the terminal's connection
+ *    right now, without blocking.  Data the stream already holds, such as
+ *    records decrypted by SSL, doesn't show up on the socket, so the
+ *    stream is asked first.
  *****/
-void tn5250_display_update(Tn5250Display* This) {
+static int tn5250_display_data_ready(Tn5250Display* This) {
+#ifndef _WIN32
+    fd_set fdr;
+    struct timeval tv;
+    SOCKET_TYPE fd = This->terminal->conn_fd;
+#endif
+
+    if (This->session != NULL && This->session->stream != NULL &&
+        tn5250_stream_pending(This->session->stream)) {
+        return 1;
+    }
+#ifndef _WIN32
+    if (fd < 0) {
+        return 0;
+    }
+    FD_ZERO(&fdr);
+    FD_SET(fd, &fdr);
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    return select(fd + 1, &fdr, NULL, NULL, &tv) > 0;
+#else
+    return 0;
+#endif
+}
+
+/****i* lib5250/tn5250_display_render
+ * NAME
+ *    tn5250_display_render
+ * SYNOPSIS
+ *    tn5250_display_render (This);
+ * INPUTS
+ *    Tn5250Display *      This       -
+ * DESCRIPTION
+ *    Draw the display on the terminal now.
+ *****/
+static void tn5250_display_render(Tn5250Display* This) {
+    This->update_pending = 0;
+    This->updates_rendered++;
+    if (This->update_interval > 0) {
+        This->last_update = tn5250_display_ticks();
+    }
+
     if (This->msg_line != NULL) {
+        unsigned char* row;
         int l;
         l = tn5250_dbuffer_msg_line(This->display_buffers);
-        memcpy(This->display_buffers->data + tn5250_display_width(This) * l,
-               This->msg_line, This->msg_len);
+        row = tn5250_dbuffer_row(This->display_buffers, l);
+        if (memcmp(row, This->msg_line, This->msg_len) != 0) {
+            memcpy(row, This->msg_line, This->msg_len);
+            tn5250_dbuffer_touch(This->display_buffers);
+        }
     }
     if (display_check_pccmd(This) == 0) {
         if (This->terminal != NULL) {
@@ -339,6 +461,110 @@ void tn5250_display_update(Tn5250Display* This) {
     return;
 }
 
+/****i* lib5250/tn5250_display_schedule
+ * NAME
+ *    tn5250_display_schedule
+ * SYNOPSIS
+ *    tn5250_display_schedule (This);
+ * INPUTS
+ *    Tn5250Display *      This       -
+ * DESCRIPTION
+ *    Draw the display now, unless we are inside a batch or the last
+ *    update was less than update_interval milliseconds ago.  In that
+ *    case just note that an update is pending.
+ *****/
+static void tn5250_display_schedule(Tn5250Display* This) {
+    if (This->update_batch > 0) {
+        This->update_pending = 1;
+        return;
+    }
+    if (This->update_interval > 0 && This->updates_rendered > 0 &&
+        tn5250_display_ticks() - This->last_update <
+            (unsigned long)This->update_interval) {
+        This->update_pending = 1;
+        return;
+    }
+    tn5250_display_render(This);
+    return;
+}
+
+/****f* lib5250/tn5250_display_update
+ * NAME
+ *    tn5250_display_update
+ * SYNOPSIS
+ *    tn5250_display_update (This);
+ * INPUTS
+ *    Tn5250Display *      This       -
+ * DESCRIPTION
+ *    Update the terminal's representation of the display.  Inside a
+ *    tn5250_display_begin_batch() / tn5250_display_end_batch() pair this
+ *    is put off until the batch ends.  If the update_interval option is
+ *    set, updates that come sooner than that after the last one are
+ *    coalesced, and the last of them is drawn by tn5250_display_flush()
+ *    before we next wait for input.
+ *****/
+void tn5250_display_update(Tn5250Display* This) {
+    This->updates_requested++;
+    tn5250_display_schedule(This);
+    return;
+}
+
+/****f* lib5250/tn5250_display_flush
+ * NAME
+ *    tn5250_display_flush
+ * SYNOPSIS
+ *    tn5250_display_flush (This);
+ * INPUTS
+ *    Tn5250Display *      This       -
+ * DESCRIPTION
+ *    Draw any update that has been held back by update pacing, regardless
+ *    of how long ago the last update was.  Does nothing inside a batch.
+ *****/
+void tn5250_display_flush(Tn5250Display* This) {
+    if (This->update_pending && This->update_batch == 0) {
+        tn5250_display_render(This);
+    }
+    return;
+}
+
+/****f* lib5250/tn5250_display_begin_batch
+ * NAME
+ *    tn5250_display_begin_batch
+ * SYNOPSIS
+ *    tn5250_display_begin_batch (This);
+ * INPUTS
+ *    Tn5250Display *      This       -
+ * DESCRIPTION
+ *    Start a batch of changes to the display.  Calls to
+ *    tn5250_display_update() are held back until the matching
+ *    tn5250_display_end_batch(), so a burst of keystrokes is drawn once
+ *    rather than once per key.  Batches may be nested.
+ *****/
+void tn5250_display_begin_batch(Tn5250Display* This) {
+    This->update_batch++;
+    return;
+}
+
+/****f* lib5250/tn5250_display_end_batch
+ * NAME
+ *    tn5250_display_end_batch
+ * SYNOPSIS
+ *    tn5250_display_end_batch (This);
+ * INPUTS
+ *    Tn5250Display *      This       -
+ * DESCRIPTION
+ *    End a batch started with tn5250_display_begin_batch().  If this ends
+ *    the outermost batch and an update was asked for during it, update the
+ *    terminal now.
+ *****/
+void tn5250_display_end_batch(Tn5250Display* This) {
+    TN5250_ASSERT(This->update_batch > 0);
+    if (--This->update_batch == 0 && This->update_pending) {
+        tn5250_display_schedule(This);
+    }
+    return;
+}
+
 /****f* lib5250/tn5250_display_waitevent
  * NAME
  *    tn5250_display_waitevent
@@ -360,9 +586,13 @@ int tn5250_display_waitevent(Tn5250Display* This) {
     while (1) {
         is_x_system = (This->keystate == TN5250_KEYSTATE_LOCKED);
 
-        /* Handle keys from our key queue if we aren't X SYSTEM. */
+        /* Handle keys from our key queue if we aren't X SYSTEM.  The
+         * whole run of queued keys is drawn once, below. */
         if (This->key_queue_head != This->key_queue_tail && !is_x_system) {
             TN5250_LOG(("Handling buffered key.\n"));
+            if (!handled_key) {
+                tn5250_display_begin_batch(This);
+            }
             tn5250_display_do_key(This, This->key_queue[This->key_queue_head]);
             if (++This->key_queue_head == TN5250_DISPLAY_KEYQ_SIZE) {
                 This->key_queue_head = 0;
@@ -373,14 +603,29 @@ int tn5250_display_waitevent(Tn5250Display* This) {
 
         /* don't make the user press HELP to see what the error is */
         if (This->keystate == TN5250_KEYSTATE_PREHELP) {
+            if (!handled_key) {
+                tn5250_display_begin_batch(This);
+            }
             tn5250_display_do_key(This, K_HELP);
             handled_key = 1;
         }
 
         if (handled_key) {
             tn5250_display_update(This);
+            tn5250_display_end_batch(This);
             handled_key = 0;
         }
+
+        /* A paced update is still outstanding.  If the host has more for
+         * us, let the session take it first; otherwise draw the screen
+         * before we block waiting for the user. */
+        if (This->update_pending) {
+            if (tn5250_display_data_ready(This)) {
+                return TN5250_TERMINAL_EVENT_DATA;
+            }
+            tn5250_display_flush(This);
+        }
+
         r = tn5250_terminal_waitevent(This->terminal);
         if ((r & TN5250_TERMINAL_EVENT_KEY) != 0) {
             tn5250_display_do_keys(This);
@@ -1167,7 +1412,10 @@ void tn5250_display_field_adjust(Tn5250Display* This, Tn5250Field* field) {
  *    Tn5250Display *      This       -
  * DESCRIPTION
  *    Handle keys from the terminal until we run out or are in the X SYSTEM
- *    state.
+ *    state.  The keys are applied as one batch and the terminal is updated
+ *    once at the end.  Once an AID key (or anything else) locks the
+ *    keyboard, the rest of the keys are only queued, so the burst ends
+ *    there.
  *****/
 void tn5250_display_do_keys(Tn5250Display* This) {
     int cur_key;
@@ -1176,6 +1424,7 @@ void tn5250_display_do_keys(Tn5250Display* This) {
 
     TN5250_LOG(("display_do_keys!\n"));
 
+    tn5250_display_begin_batch(This);
     do {
         cur_key = tn5250_macro_getkey(This, &Last);
 
@@ -1256,6 +1505,7 @@ void tn5250_display_do_keys(Tn5250Display* This) {
     } while (cur_key != -1);
 
     tn5250_display_update(This);
+    tn5250_display_end_batch(This);
     return;
 }
 
@@ -1275,6 +1525,9 @@ void tn5250_display_do_key(Tn5250Display* This, int key) {
 
     TN5250_LOG(("@key %d\n", key));
 
+    /* Keys may change the display buffer directly. */
+    tn5250_dbuffer_touch(This->display_buffers);
+
     /* FIXME: Translate from terminal key via keyboard map to 5250 key. */
     /* James Rich:  I don't think this is the correct place to do key mapping,
      * contrary to the FIXME above.  I think each terminal should implement
@@ -1866,7 +2119,7 @@ void tn5250_display_indicator_clear(Tn5250Display* This, int inds) {
     if ((inds & TN5250_DISPLAY_IND_INHIBIT) != 0 &&
         This->saved_msg_line != NULL) {
         int l = tn5250_dbuffer_msg_line(This->display_buffers);
-        memcpy(This->display_buffers->data + l * tn5250_display_width(This),
+        memcpy(tn5250_dbuffer_row(This->display_buffers, l),
                This->saved_msg_line, tn5250_display_width(This));
         free(This->saved_msg_line);
         This->saved_msg_line = NULL;
@@ -2289,6 +2542,7 @@ void tn5250_display_kf_nextword(Tn5250Display* This) {
 void tn5250_display_kf_prevfld(Tn5250Display* This) {
     int state = 0;
     int maxiter;
+    unsigned char c;
     Tn5250Field* field;
 
     TN5250_LOG(("dbuffer_prevfld: entered.\n"));
@@ -2307,27 +2561,22 @@ void tn5250_display_kf_prevfld(Tn5250Display* This) {
             break;
         }
 
+        c = tn5250_dbuffer_cell(This->display_buffers,
+                                This->display_buffers->cy,
+                                This->display_buffers->cx);
         switch (state) {
         case 0:
-            if (This->display_buffers->data[This->display_buffers->cy *
-                                                This->display_buffers->w +
-                                            This->display_buffers->cx] <=
-                0x40) {
+            if (c <= 0x40) {
                 state++;
             }
             break;
         case 1:
-            if (This->display_buffers->data[This->display_buffers->cy *
-                                                This->display_buffers->w +
-                                            This->display_buffers->cx] > 0x40) {
+            if (c > 0x40) {
                 state++;
             }
             break;
         case 2:
-            if (This->display_buffers->data[This->display_buffers->cy *
-                                                This->display_buffers->w +
-                                            This->display_buffers->cx] <=
-                0x40) {
+            if (c <= 0x40) {
                 tn5250_dbuffer_right(This->display_buffers, 1);
                 return;
             }
@@ -2353,6 +2602,7 @@ void tn5250_display_kf_prevfld(Tn5250Display* This) {
 void tn5250_display_kf_nextfld(Tn5250Display* This) {
     int foundblank = 0;
     int maxiter;
+    unsigned char c;
     Tn5250Field* field;
 
     TN5250_LOG(("dbuffer_nextfld: entered.\n"));
@@ -2362,17 +2612,15 @@ void tn5250_display_kf_nextfld(Tn5250Display* This) {
 
     while (--maxiter) {
         tn5250_dbuffer_right(This->display_buffers, 1);
-        if (This->display_buffers
-                ->data[This->display_buffers->cy * This->display_buffers->w +
-                       This->display_buffers->cx] <= 0x40) {
+        c = tn5250_dbuffer_cell(This->display_buffers,
+                                This->display_buffers->cy,
+                                This->display_buffers->cx);
+        if (c <= 0x40) {
             foundblank++;
         }
 
         /* If found a blank previously and a non-blank now, exit */
-        if ((foundblank) &&
-            (This->display_buffers
-                 ->data[This->display_buffers->cy * This->display_buffers->w +
-                        This->display_buffers->cx] > 0x40)) {
+        if ((foundblank) && (c > 0x40)) {
             break;
         }
 
@@ -2495,8 +2743,7 @@ void tn5250_display_save_msg_line(Tn5250Display* This) {
     This->saved_msg_line = (unsigned char*)malloc(tn5250_display_width(This));
 
     l = tn5250_dbuffer_msg_line(This->display_buffers);
-    memcpy(This->saved_msg_line,
-           This->display_buffers->data + tn5250_display_width(This) * l,
+    memcpy(This->saved_msg_line, tn5250_dbuffer_row(This->display_buffers, l),
            tn5250_display_width(This));
     return;
 }
@@ -2527,8 +2774,8 @@ void tn5250_display_set_msg_line(Tn5250Display* This,
     This->msg_len = msglen;
 
     l = tn5250_dbuffer_msg_line(This->display_buffers);
-    memcpy(This->display_buffers->data + tn5250_display_width(This) * l,
-           This->msg_line, This->msg_len);
+    memcpy(tn5250_dbuffer_row(This->display_buffers, l), This->msg_line,
+           This->msg_len);
     return;
 }
 
@@ -2574,38 +2821,17 @@ void tn5250_display_erase_region(Tn5250Display* This, unsigned int startrow,
                                  unsigned int startcol, unsigned int endrow,
                                  unsigned int endcol, unsigned int leftedge,
                                  unsigned int rightedge) {
-    int i, j;
+    unsigned char blank = tn5250_char_map_to_remote(This->map, ' ');
+    unsigned int row, first, last;
 
-    if (startrow == endrow) {
-        for (j = startcol - 1; j < endcol; j++) {
-            This->display_buffers
-                ->data[((startrow - 1) * This->display_buffers->w) + j] =
-                tn5250_char_map_to_remote(This->map, ' ');
-        }
-    }
-    else {
-        for (i = startrow - 1; i < endrow; i++) {
-            if (i == (startrow - 1)) {
-                for (j = startcol - 1; j < rightedge; j++) {
-                    This->display_buffers
-                        ->data[(i * This->display_buffers->w) + j] =
-                        tn5250_char_map_to_remote(This->map, ' ');
-                }
-            }
-            else if (i == (endrow - 1)) {
-                for (j = leftedge - 1; j < endcol; j++) {
-                    This->display_buffers
-                        ->data[(i * This->display_buffers->w) + j] =
-                        tn5250_char_map_to_remote(This->map, ' ');
-                }
-            }
-            else {
-                for (j = leftedge - 1; j < rightedge; j++) {
-                    This->display_buffers
-                        ->data[(i * This->display_buffers->w) + j] =
-                        tn5250_char_map_to_remote(This->map, ' ');
-                }
-            }
+    /* Each row of the region is one contiguous span of the buffer. */
+    for (row = startrow; row <= endrow; row++) {
+        first = (row == startrow) ? startcol : leftedge;
+        last = (row == endrow) ? endcol : rightedge;
+        if (last >= first) {
+            memset(&tn5250_dbuffer_cell(This->display_buffers, row - 1,
+                                        first - 1),
+                   blank, last - first + 1);
         }
     }
     return;
@@ -2696,8 +2922,7 @@ void tn5250_display_wordwrap_insert(Tn5250Display* This, unsigned char c,
                                     int shiftcount) {
     Tn5250Field* field = tn5250_display_current_field(This);
     Tn5250Field* iter;
-    int x, y, i;
-    unsigned char c2;
+    int ofs;
     int buflen;
     unsigned char *text, *ptr;
     unsigned char* data;
@@ -2731,8 +2956,10 @@ void tn5250_display_wordwrap_insert(Tn5250Display* This, unsigned char c,
     }
     buflen = buflen + tn5250_field_length(iter);
 
-    /* Now allocate */
-    text = (unsigned char*)malloc(buflen * sizeof(unsigned char));
+    /* Now allocate, with room for the inserted character.  The last
+     * character of the group is dropped again when we wrap, which is fine
+     * since we only get here when it is blank. */
+    text = (unsigned char*)malloc((buflen + 1) * sizeof(unsigned char));
     ptr = text;
 
     if (!tn5250_field_is_continued_first(field)) {
@@ -2752,34 +2979,14 @@ void tn5250_display_wordwrap_insert(Tn5250Display* This, unsigned char c,
      * We need to put the entire field into the buffer, so start at the
      * beginning of the field, then copy the inserted data.
      */
-    x = tn5250_field_start_col(field);
-    y = tn5250_field_start_row(field);
-
-    for (i = 0; i < tn5250_field_length(field) - shiftcount - 1; i++) {
-        c2 = This->display_buffers->data[y * This->display_buffers->w + x];
-        memcpy(ptr, &c2, sizeof(unsigned char));
-        ptr = ptr + sizeof(unsigned char);
-        if (++x == This->display_buffers->w) {
-            x = 0;
-            y++;
-        }
-    }
-
-    x = This->display_buffers->cx;
-    y = This->display_buffers->cy;
-
-    for (; i < tn5250_field_length(field); i++) {
-        c2 = This->display_buffers->data[y * This->display_buffers->w + x];
-        memcpy(ptr, &c, sizeof(unsigned char));
-        ptr = ptr + sizeof(unsigned char);
-        c = c2;
-        if (++x == This->display_buffers->w) {
-            x = 0;
-            y++;
-        }
-    }
+    data = tn5250_display_field_data(This, field);
+    ofs = tn5250_field_length(field) - shiftcount - 1;
+    memcpy(ptr, data, ofs * sizeof(unsigned char));
+    ptr = ptr + (ofs * sizeof(unsigned char));
     memcpy(ptr, &c, sizeof(unsigned char));
     ptr = ptr + sizeof(unsigned char);
+    memcpy(ptr, data + ofs, (shiftcount + 1) * sizeof(unsigned char));
+    ptr = ptr + ((shiftcount + 1) * sizeof(unsigned char));
     memcpy(ptr, &espace, sizeof(unsigned char));
     ptr = ptr + sizeof(unsigned char);
 
@@ -2847,9 +3054,8 @@ void tn5250_display_wordwrap_addch(Tn5250Display* This, unsigned char c) {
     /* Use our own version of tn5250_dbuffer_addch().  We can't use the real
      * version because we don't want to advance the cursor position.
      */
-    This->display_buffers
-        ->data[(This->display_buffers->cy * This->display_buffers->w) +
-               This->display_buffers->cx] = c;
+    tn5250_dbuffer_cell(This->display_buffers, This->display_buffers->cy,
+                        This->display_buffers->cx) = c;
 
     /* First allocate enough space to do the copying.  This will be sum of
      * the lengths of the word wrap fields in this group starting from the
@@ -2934,6 +3140,41 @@ void tn5250_display_wordwrap_addch(Tn5250Display* This, unsigned char c) {
     return;
 }
 
+/****i* lib5250/tn5250_display_wordwrap_line
+ * NAME
+ *    tn5250_display_wordwrap_line
+ * SYNOPSIS
+ *    tn5250_display_wordwrap_line (This, field, line, len);
+ * INPUTS
+ *    Tn5250Display *      This       -
+ *    Tn5250Field *        field      - Field to write the line into.
+ *    char *               line       - Text in local characters.
+ *    int                  len        - Length of line.
+ * DESCRIPTION
+ *    Write one line of word wrapped text at the start of a field and pad
+ *    the rest of the field with word wrap spaces.  line is translated to
+ *    the remote character set in place.
+ *****/
+static void tn5250_display_wordwrap_line(Tn5250Display* This,
+                                         Tn5250Field* field, char* line,
+                                         int len) {
+    int i;
+
+    for (i = 0; i < len; i++) {
+        line[i] = tn5250_char_map_to_remote(This->map, line[i]);
+    }
+    tn5250_dbuffer_cursor_set(This->display_buffers,
+                              tn5250_field_start_row(field),
+                              tn5250_field_start_col(field));
+    tn5250_dbuffer_addstr(This->display_buffers, (unsigned char*)line, len);
+    if (len < tn5250_field_length(field)) {
+        tn5250_dbuffer_repeat(This->display_buffers,
+                              TN5250_DISPLAY_WORD_WRAP_SPACE,
+                              tn5250_field_length(field) - len);
+    }
+    return;
+}
+
 void tn5250_display_wordwrap(Tn5250Display* This, unsigned char* text,
                              int totallen, int fieldlen, Tn5250Field* field) {
     Tn5250Field* iter;
@@ -2945,6 +3186,8 @@ void tn5250_display_wordwrap(Tn5250Display* This, unsigned char* text,
     unsigned char c, c2;
     int curlinelength = 0;
     int wordlength = 0;
+    int linelength = 0;
+    int started;
     char word[3564 + 1] = { '\0' };
     char line[3564 + 1] = { '\0' };
 
@@ -3001,49 +3244,25 @@ void tn5250_display_wordwrap(Tn5250Display* This, unsigned char* text,
             curlinelength++;
         }
         else {
-            if (strlen(line) == 0) {
-                if (c == TN5250_DISPLAY_WORD_WRAP_SPACE) {
-                    sprintf(line, "%s", word);
-                }
-                else {
-                    sprintf(line, "%s ", word);
+            /* Keep line as a string with its length in linelength, so
+             * adding a word costs the length of the word, not the line. */
+            started = (linelength != 0);
+            if (started && (curlinelength + 1) > fieldlen) {
+                tn5250_display_wordwrap_line(This, iter, line, linelength);
+                if (tn5250_field_is_wordwrap(iter)) {
+                    iter = iter->next;
                 }
+                linelength = 0;
             }
-            else {
-                if ((curlinelength + 1) > fieldlen) {
-                    tn5250_dbuffer_cursor_set(This->display_buffers,
-                                              tn5250_field_start_row(iter),
-                                              tn5250_field_start_col(iter));
-                    for (j = 0; j < strlen(line); j++) {
-                        tn5250_dbuffer_addch(
-                            This->display_buffers,
-                            tn5250_char_map_to_remote(This->map, line[j]));
-                    }
-                    for (; j < tn5250_field_length(iter); j++) {
-                        tn5250_dbuffer_addch(This->display_buffers,
-                                             TN5250_DISPLAY_WORD_WRAP_SPACE);
-                    }
-                    if (tn5250_field_is_wordwrap(iter)) {
-                        iter = iter->next;
-                    }
-                    memset(line, '\0', 133);
-                    if (c == TN5250_DISPLAY_WORD_WRAP_SPACE) {
-                        sprintf(line, "%s", word);
-                    }
-                    else {
-                        sprintf(line, "%s ", word);
-                    }
-                    curlinelength = strlen(line);
-                }
-                else {
-                    if (c == TN5250_DISPLAY_WORD_WRAP_SPACE) {
-                        sprintf(line, "%s%s", line, word);
-                    }
-                    else {
-                        sprintf(line, "%s%s ", line, word);
-                    }
-                    curlinelength = strlen(line);
-                }
+            j = strlen(word);
+            memcpy(line + linelength, word, j);
+            linelength += j;
+            if (c != TN5250_DISPLAY_WORD_WRAP_SPACE) {
+                line[linelength++] = ' ';
+            }
+            line[linelength] = '\0';
+            if (started) {
+                curlinelength = linelength;
             }
             memset(word, '\0', 133);
             wordlength = 0;
@@ -3051,20 +3270,10 @@ void tn5250_display_wordwrap(Tn5250Display* This, unsigned char* text,
     }
 
     /* Add or clear any trailing text */
-    tn5250_dbuffer_cursor_set(This->display_buffers,
-                              tn5250_field_start_row(iter),
-                              tn5250_field_start_col(iter));
-    if (strlen(word) > 0) {
-        sprintf(line, "%s%s", line, word);
-    }
-    for (j = 0; j < strlen(line); j++) {
-        tn5250_dbuffer_addch(This->display_buffers,
-                             tn5250_char_map_to_remote(This->map, line[j]));
-    }
-    for (; j < tn5250_field_length(iter); j++) {
-        tn5250_dbuffer_addch(This->display_buffers,
-                             TN5250_DISPLAY_WORD_WRAP_SPACE);
-    }
+    j = strlen(word);
+    memcpy(line + linelength, word, j + 1);
+    linelength += j;
+    tn5250_display_wordwrap_line(This, iter, line, linelength);
 
     /* And finally clear any old text that might be in fields after the last
      * field we just wrote to in this same word wrap group.
@@ -3078,22 +3287,10 @@ void tn5250_display_wordwrap(Tn5250Display* This, unsigned char* text,
          !tn5250_field_is_continued_first(iter->next))) {
         for (iter = iter->next; tn5250_field_is_wordwrap(iter);
              iter = iter->next) {
-            tn5250_dbuffer_cursor_set(This->display_buffers,
-                                      tn5250_field_start_row(iter),
-                                      tn5250_field_start_col(iter));
-            for (j = 0; j < tn5250_field_length(iter); j++) {
-                tn5250_dbuffer_addch(This->display_buffers,
-                                     TN5250_DISPLAY_WORD_WRAP_SPACE);
-            }
+            tn5250_display_wordwrap_line(This, iter, line, 0);
         }
         if (tn5250_field_is_continued_last(iter)) {
-            tn5250_dbuffer_cursor_set(This->display_buffers,
-                                      tn5250_field_start_row(iter),
-                                      tn5250_field_start_col(iter));
-            for (j = 0; j < tn5250_field_length(iter); j++) {
-                tn5250_dbuffer_addch(This->display_buffers,
-                                     TN5250_DISPLAY_WORD_WRAP_SPACE);
-            }
+            tn5250_display_wordwrap_line(This, iter, line, 0);
         }
     }
 
@@ -3144,6 +3341,7 @@ int display_check_pccmd(Tn5250Display* This) {
     int header[5];
     int wait = 0;
     char cmdstr[124];
+    unsigned char* data;
 
     if (This->allow_strpccmd == 0) {
         return 0;
@@ -3177,11 +3375,12 @@ int display_check_pccmd(Tn5250Display* This) {
     /* The next 5 bytes are header bytes. If anyone has some docs on what
        they do, please let me know!!  -SK */
 
-    header[0] = This->display_buffers->data[7];
-    header[1] = This->display_buffers->data[8];
-    header[2] = This->display_buffers->data[9];
-    header[3] = This->display_buffers->data[10];
-    header[4] = This->display_buffers->data[11];
+    data = tn5250_dbuffer_data(This->display_buffers);
+    header[0] = data[7];
+    header[1] = data[8];
+    header[2] = data[9];
+    header[3] = data[10];
+    header[4] = data[11];
 
     TN5250_LOG(("PCO Header Bytes: %x %x %x %x %x\n", header[0], header[1],
                 header[2], header[3], header[4]));
@@ -3199,7 +3398,7 @@ int display_check_pccmd(Tn5250Display* This) {
     /* The header bytes are followed by a 123 character fixed-length command
        string. */
 
-    memcpy(cmdstr, This->display_buffers->data + 12, 123);
+    memcpy(cmdstr, data + 12, 123);
     cmdstr[123] = '\0';
 
     /* Strip any trailing blanks from the command string */
@@ -3221,7 +3420,7 @@ int display_check_pccmd(Tn5250Display* This) {
        that it has been run */
 
     tn5250_run_cmd(cmdstr, wait);
-    This->display_buffers->data[1] = 0x00;
+    data[1] = 0x00;
 
     /* Send back the ENTER key to tell the host that the command was run */
 
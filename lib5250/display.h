@@ -77,7 +77,20 @@ struct _Tn5250Display {
     int key_queue_head, key_queue_tail;
     int key_queue[TN5250_DISPLAY_KEYQ_SIZE];
 
+    /* While update_batch is non-zero, tn5250_display_update() just sets
+     * update_pending, and the terminal is updated once when the outermost
+     * batch ends. */
+    int update_batch;
+
+    /* Terminal updates closer together than update_interval milliseconds
+     * are coalesced; the last one is drawn before we wait for input. */
+    int update_interval;
+    unsigned long last_update;
+    unsigned long updates_requested;
+    unsigned long updates_rendered;
+
     unsigned int indicators_dirty : 1;
+    unsigned int update_pending : 1;
     unsigned int pending_insert : 1;
     unsigned int destructive_backspace : 1;
     unsigned int sign_key_hack : 1;
@@ -98,12 +111,17 @@ extern void tn5250_display_set_session(Tn5250Display* This,
                                        struct _Tn5250Session* s);
 
 extern Tn5250DBuffer* tn5250_display_push_dbuffer(Tn5250Display* This);
-extern void tn5250_display_restore_dbuffer(Tn5250Display* This,
+extern int tn5250_display_restore_dbuffer(Tn5250Display* This,
+                                          Tn5250DBuffer* display);
+extern void tn5250_display_discard_dbuffer(Tn5250Display* This,
                                            Tn5250DBuffer* display);
 
 extern void tn5250_display_set_terminal(Tn5250Display* This,
                                         struct _Tn5250Terminal*);
 extern void tn5250_display_update(Tn5250Display* This);
+extern void tn5250_display_begin_batch(Tn5250Display* This);
+extern void tn5250_display_end_batch(Tn5250Display* This);
+extern void tn5250_display_flush(Tn5250Display* This);
 
 extern int tn5250_display_waitevent(Tn5250Display* This);
 extern int tn5250_display_getkey(Tn5250Display* This);
@@ -180,6 +198,10 @@ void tn5250_display_wordwrap(Tn5250Display* This, unsigned char* text,
 
 #define tn5250_display_dbuffer(This)    ((This)->display_buffers)
 #define tn5250_display_indicators(This) ((This)->indicators)
+#define tn5250_display_updates_requested(This)                                 \
+    ((This)->updates_requested)
+#define tn5250_display_updates_rendered(This)                                  \
+    ((This)->updates_rendered)
 #define tn5250_display_inhibited(This)                                         \
     ((tn5250_display_indicators(This) & TN5250_DISPLAY_IND_INHIBIT) != 0)
 #define tn5250_display_inhibit(This)                                           \
@@ -198,8 +220,16 @@ void tn5250_display_wordwrap(Tn5250Display* This, unsigned char* text,
     (tn5250_dbuffer_height((This)->display_buffers))
 #define tn5250_display_char_at(This, y, x)                                     \
     (tn5250_dbuffer_char_at((This)->display_buffers, (y), (x)))
+#define tn5250_display_fingerprint(This)                                       \
+    (tn5250_dbuffer_fingerprint((This)->display_buffers))
+#define tn5250_display_format_fingerprint(This)                                \
+    (tn5250_dbuffer_format_fingerprint((This)->display_buffers))
 #define tn5250_display_addch(This, ch)                                         \
     (tn5250_dbuffer_addch((This)->display_buffers, (ch)))
+#define tn5250_display_addstr(This, s, len)                                    \
+    (tn5250_dbuffer_addstr((This)->display_buffers, (s), (len)))
+#define tn5250_display_repeat(This, ch, count)                                 \
+    (tn5250_dbuffer_repeat((This)->display_buffers, (ch), (count)))
 #define tn5250_display_roll(This, top, bottom, lines)                          \
     (tn5250_dbuffer_roll((This)->display_buffers, (top), (bottom), (lines)))
 #define tn5250_display_set_ic(This, y, x)                                      \
@@ -22,6 +22,8 @@
 
 #include "tn5250-private.h"
 
+static const unsigned char* tn5250_field_valid_table(Tn5250Field* field);
+
 /****f* lib5250/tn5250_field_new
  * NAME
  *    tn5250_field_new
@@ -392,57 +394,89 @@ int tn5250_field_count_right(Tn5250Field* This, int y, int x) {
  *    for this field, and return system reference code for errors (SRC)
  *****/
 int tn5250_field_valid_char(Tn5250Field* field, int ch, int* src) {
+    const unsigned char* table = tn5250_field_valid_table(field);
+
     TN5250_LOG(("HandleKey: fieldtype = %d; char = '%c'.\n",
                 tn5250_field_type(field), ch));
 
-    *src = TN5250_KBDSRC_NONE;
-
-    switch (tn5250_field_type(field)) {
-    case TN5250_FIELD_ALPHA_SHIFT:
-        return 1;
-
-    case TN5250_FIELD_ALPHA_ONLY:
-        if (!(isalpha(ch) || ch == ',' || ch == '.' || ch == '-' ||
-              ch == ' ')) {
-            *src = TN5250_KBDSRC_ALPHAONLY;
-            return 0;
-        }
-        return 1;
-
-    case TN5250_FIELD_NUM_SHIFT:
-        return 1;
-
-    case TN5250_FIELD_NUM_ONLY:
-        if (!(isdigit(ch) || ch == ',' || ch == '.' || ch == '-' ||
-              ch == ' ')) {
-            *src = TN5250_KBDSRC_NUMONLY;
-            return 0;
-        }
-        return 1;
-
-    case TN5250_FIELD_KATA_SHIFT:
-        TN5250_LOG(("KATAKANA not implemented.\n"));
-        return 1;
+    *src = table[(ch >= 0 && ch < 256) ? ch : 0];
+    return *src == TN5250_KBDSRC_NONE;
+}
 
-    case TN5250_FIELD_DIGIT_ONLY:
-        if (!isdigit(ch)) {
-            *src = TN5250_KBDSRC_ONLY09;
-            return 0;
-        }
-        return 1;
+/****f* lib5250/tn5250_field_valid_data
+ * NAME
+ *    tn5250_field_valid_data
+ * SYNOPSIS
+ *    ret = tn5250_field_valid_data (field, data, len, &src);
+ * INPUTS
+ *    Tn5250Field *        field      -
+ *    const unsigned char * data      - Local characters to check.
+ *    int                  len        - Number of characters in data.
+ *    int         *        src        - Where to put the SRC for an error.
+ * DESCRIPTION
+ *    Check a whole string of input against the field, as
+ *    tn5250_field_valid_char would check it one character at a time.
+ *    Returns the position of the first character the field won't accept,
+ *    with its SRC in src, or len (and TN5250_KBDSRC_NONE) if it takes
+ *    them all.
+ *****/
+int tn5250_field_valid_data(Tn5250Field* field, const unsigned char* data,
+                            int len, int* src) {
+    const unsigned char* table = tn5250_field_valid_table(field);
+    int i;
 
-    case TN5250_FIELD_MAG_READER:
-        *src = TN5250_KBDSRC_DATA_DISALLOWED;
-        return 0;
+    i = 0;
+    while (i < len && table[data[i]] == TN5250_KBDSRC_NONE) {
+        i++;
+    }
+    *src = (i < len) ? table[data[i]] : TN5250_KBDSRC_NONE;
+    return i;
+}
 
-    case TN5250_FIELD_SIGNED_NUM:
-        if (!isdigit(ch)) {
-            *src = TN5250_KBDSRC_ONLY09;
-            return 0;
+/****i* lib5250/tn5250_field_valid_table
+ * NAME
+ *    tn5250_field_valid_table
+ * SYNOPSIS
+ *    table = tn5250_field_valid_table (field);
+ * INPUTS
+ *    Tn5250Field *        field      -
+ * DESCRIPTION
+ *    Return the acceptance table for the field's type.  There is one
+ *    table for each of the eight field types in the FFW, shared by all
+ *    fields, giving the SRC to report for each local character, or
+ *    TN5250_KBDSRC_NONE if the character is allowed.  The tables are
+ *    filled in on first use, after the program has set its locale.
+ *****/
+static const unsigned char* tn5250_field_valid_table(Tn5250Field* field) {
+    static unsigned char tables[8][256];
+    static int built = 0;
+    int ch;
+
+    if (!built) {
+        for (ch = 0; ch < 256; ch++) {
+            if (!(isalpha(ch) || ch == ',' || ch == '.' || ch == '-' ||
+                  ch == ' ')) {
+                tables[TN5250_FIELD_ALPHA_ONLY >> 8][ch] =
+                    TN5250_KBDSRC_ALPHAONLY;
+            }
+            if (!(isdigit(ch) || ch == ',' || ch == '.' || ch == '-' ||
+                  ch == ' ')) {
+                tables[TN5250_FIELD_NUM_ONLY >> 8][ch] =
+                    TN5250_KBDSRC_NUMONLY;
+            }
+            if (!isdigit(ch)) {
+                tables[TN5250_FIELD_DIGIT_ONLY >> 8][ch] =
+                    TN5250_KBDSRC_ONLY09;
+                tables[TN5250_FIELD_SIGNED_NUM >> 8][ch] =
+                    TN5250_KBDSRC_ONLY09;
+            }
+            tables[TN5250_FIELD_MAG_READER >> 8][ch] =
+                TN5250_KBDSRC_DATA_DISALLOWED;
         }
-        return 1;
+        /* Alpha shift, numeric shift and katakana shift take anything. */
+        built = 1;
     }
-    return 0;
+    return tables[tn5250_field_type(field) >> 8];
 }
 
 /****f* lib5250/tn5250_field_set_mdt
@@ -476,6 +510,26 @@ void tn5250_field_set_mdt(Tn5250Field* This) {
     else {
         This->FFW |= TN5250_FIELD_MODIFIED;
         tn5250_dbuffer_set_mdt(This->table);
+        tn5250_dbuffer_update_mdt(This->table, This);
+    }
+    return;
+}
+
+/****f* lib5250/tn5250_field_clear_mdt
+ * NAME
+ *    tn5250_field_clear_mdt
+ * SYNOPSIS
+ *    tn5250_field_clear_mdt (This);
+ * INPUTS
+ *    Tn5250Field *        This       -
+ * DESCRIPTION
+ *    Clear the MDT flag for this field.  The table's master MDT flag is
+ *    left alone.
+ *****/
+void tn5250_field_clear_mdt(Tn5250Field* This) {
+    This->FFW &= ~TN5250_FIELD_MODIFIED;
+    if (This->table != NULL) {
+        tn5250_dbuffer_update_mdt(This->table, This);
     }
     return;
 }
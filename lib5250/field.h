@@ -40,11 +40,13 @@ struct _Tn5250DBuffer;
  *    field->start_col = 2;
  *    field->length = 10;
  *    field->FFW = TN5250_FIELD_NUM_ONLY | TN5250_FIELD_DUP_ENABLE;
- *    tn5250_dbuffer_add_field (dbuffer, field);
+ *    added = tn5250_dbuffer_add_field_copy (dbuffer, field);
+ *    tn5250_field_destroy (field);
  * DESCRIPTION
  *    The Tn5250Field object manages an input field on the display.  It
  *    does not hold the actual data from the field; rather, that is
- *    contained by the display buffer.
+ *    contained by the display buffer.  A field added to a display buffer
+ *    is copied into that buffer's field table.
  * SOURCE
  */
 struct _Tn5250Field {
@@ -53,26 +55,26 @@ struct _Tn5250Field {
     int id;
     int entry_id;
     int resequence;
-    short magstripe;
-    short lightpen;
-    short magandlight;
-    short lightandattn;
-    short ideographiconly;
-    short ideographicdatatype;
-    short ideographiceither;
-    short ideographicopen;
+    unsigned int magstripe : 1;
+    unsigned int lightpen : 1;
+    unsigned int magandlight : 1;
+    unsigned int lightandattn : 1;
+    unsigned int ideographiconly : 1;
+    unsigned int ideographicdatatype : 1;
+    unsigned int ideographiceither : 1;
+    unsigned int ideographicopen : 1;
+    unsigned int forwardedge : 1;
+    unsigned int continuous : 1;
+    unsigned int continued_first : 1;
+    unsigned int continued_middle : 1;
+    unsigned int continued_last : 1;
+    unsigned int wordwrap : 1;
+    unsigned int selfcheckmod11 : 1;
+    unsigned int selfcheckmod10 : 1;
     int transparency;
-    short forwardedge;
-    short continuous;
-    short continued_first;
-    short continued_middle;
-    short continued_last;
-    short wordwrap;
     int nextfieldprogressionid;
     unsigned char highlightentryattr;
     unsigned char pointeraid;
-    short selfcheckmod11;
-    short selfcheckmod10;
     struct _Tn5250DBuffer /*@dependent@*/* table;
 
     int w; /* Display width, needed for some calcs */
@@ -143,11 +145,12 @@ extern const char* tn5250_field_adjust_description(Tn5250Field* This);
 extern int tn5250_field_count_left(Tn5250Field* This, int y, int x);
 extern int tn5250_field_count_right(Tn5250Field* This, int y, int x);
 extern void tn5250_field_set_mdt(Tn5250Field* This);
+extern void tn5250_field_clear_mdt(Tn5250Field* This);
 extern int tn5250_field_valid_char(Tn5250Field* This, int ch, int* src);
+extern int tn5250_field_valid_data(Tn5250Field* This, const unsigned char* data,
+                                   int len, int* src);
 
 #define tn5250_field_mdt(This) (((This)->FFW & TN5250_FIELD_MODIFIED) != 0)
-#define tn5250_field_clear_mdt(This)                                           \
-    (void)((This)->FFW &= ~TN5250_FIELD_MODIFIED)
 #define tn5250_field_is_bypass(This) (((This)->FFW & TN5250_FIELD_BYPASS) != 0)
 #define tn5250_field_is_dup_enable(This)                                       \
     (((This)->FFW & TN5250_FIELD_DUP_ENABLE) != 0)
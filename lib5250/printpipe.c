@@ -0,0 +1,1257 @@
+/* TN5250 - An implementation of the 5250 telnet protocol.
+ * Copyright (C) 1997-2008 Michael Madore
+ *
+ * This file is part of TN5250.
+ *
+ * TN5250 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1, or (at your option)
+ * any later version.
+ *
+ * TN5250 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "tn5250-private.h"
+#include "scs-private.h"
+
+#if !defined(_WIN32) && defined(HAVE_PTHREAD_H)
+
+#include <pthread.h>
+#include <syslog.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Records queued between the session and the workers.  A record is a few
+ * kilobytes at most, so this is plenty to keep a worker busy while the
+ * session waits on the host, without holding a whole job in memory. */
+#define TN5250_PRINT_PIPE_SLOTS 32
+
+/* Size of the stdio buffer for a spool file, so that it is written in
+ * large pieces rather than a record at a time. */
+#define TN5250_PRINT_SPOOL_BUFSIZE 65536
+
+/****is* lib5250/Tn5250PrintPipeSlot
+ * NAME
+ *    Tn5250PrintPipeSlot
+ * DESCRIPTION
+ *    One queued record, or the end of a job.  The buffers are kept and
+ *    reused, so once they have grown to the size of a record the queue
+ *    doesn't allocate any more.
+ * SOURCE
+ */
+typedef struct _Tn5250PrintPipeSlot {
+    Tn5250Buffer data;
+    int end_of_job;
+} Tn5250PrintPipeSlot;
+/*******/
+
+/****is* lib5250/Tn5250PrintSpoolJob
+ * NAME
+ *    Tn5250PrintSpoolJob
+ * DESCRIPTION
+ *    A complete job in the spool directory, waiting to be printed.
+ * SOURCE
+ */
+typedef struct _Tn5250PrintSpoolJob {
+    struct _Tn5250PrintSpoolJob /*@null@*/* next;
+    char* filename;
+} Tn5250PrintSpoolJob;
+/*******/
+
+struct _Tn5250PrintPool {
+    pthread_t* workers;
+    int nworkers;
+    pthread_mutex_t lock; /* Guards the pool and the queues of its pipes. */
+    pthread_cond_t work;
+    Tn5250PrintPipe /*@null@*/* ready_head; /* Pipes with records waiting */
+    Tn5250PrintPipe /*@null@*/* ready_tail;
+    int stop;
+};
+
+struct _Tn5250PrintPipe {
+    /* scs2ascii, scs2ps or scs2pdf, or NULL to pass spooled jobs to the
+     * sink as they are. */
+    char /*@null@*/* converter;
+    char /*@null@*/* sink; /* Command the output is piped to, or stdout */
+    Tn5250PrintPool* pool;
+    int own_pool; /* The pool was made for this pipe alone. */
+
+    pthread_cond_t not_full;
+    Tn5250PrintPipeSlot slots[TN5250_PRINT_PIPE_SLOTS];
+    int head;  /* Next slot a worker reads. */
+    int count; /* Slots filled and not yet read. */
+    int in_job; /* Session side: records written since the last end_job. */
+
+    Tn5250PrintPipe /*@null@*/* next_ready;
+    int queued;  /* On the pool's ready list. */
+    int busy;    /* A worker is converting our records. */
+    int closing; /* Destroyed; freed once the queue is empty. */
+
+    /* With a spool directory, the session writes each job to a file there
+     * and the workers are given the finished files instead of records. */
+    char /*@null@*/* spool_dir;
+    FILE /*@null@*/* spool_file; /* Session side: the job being received */
+    char /*@null@*/* spool_name;
+    char /*@null@*/* spool_buf;
+    unsigned long spool_seq;
+    int spool_failed; /* The job being received is being discarded. */
+    Tn5250PrintSpoolJob /*@null@*/* jobs_head;
+    Tn5250PrintSpoolJob /*@null@*/* jobs_tail;
+    int njobs;
+
+    /* The job being converted.  Only the worker with busy set uses these,
+     * and they are kept from one turn to the next. */
+    int job_open;
+    Tn5250SCS /*@null@*/* scs;
+    FILE /*@null@*/* out;
+};
+
+static int tn5250_print_pipe_parse(Tn5250PrintPipe* This,
+                                   const char* output_cmd);
+static int tn5250_print_pipe_start(Tn5250PrintPipe* This,
+                                   Tn5250PrintPool* pool);
+static void tn5250_print_pipe_put(Tn5250PrintPipe* This,
+                                  const unsigned char* data, int len,
+                                  int end_of_job);
+static void tn5250_print_pipe_convert(Tn5250PrintPipe* This,
+                                      Tn5250PrintPipeSlot* slot);
+static void tn5250_print_pipe_open_job(Tn5250PrintPipe* This);
+static void tn5250_print_pipe_emit(Tn5250PrintPipe* This,
+                                   const unsigned char* data, size_t len);
+static int tn5250_print_pipe_close_job(Tn5250PrintPipe* This);
+static void tn5250_print_pipe_free(Tn5250PrintPipe* This);
+static void tn5250_print_spool_open(Tn5250PrintPipe* This);
+static void tn5250_print_spool_discard(Tn5250PrintPipe* This);
+static void tn5250_print_spool_abandon(Tn5250PrintPipe* This);
+static void tn5250_print_spool_end_job(Tn5250PrintPipe* This);
+static void tn5250_print_spool_queue(Tn5250PrintPipe* This, char* filename);
+static void tn5250_print_spool_scan(Tn5250PrintPipe* This);
+static int tn5250_print_spool_compare(const void* a, const void* b);
+static void tn5250_print_spool_print(Tn5250PrintPipe* This,
+                                     const char* filename);
+static void tn5250_print_pool_ready(Tn5250PrintPool* This,
+                                    Tn5250PrintPipe* pipe);
+static void* tn5250_print_pool_worker(void* arg);
+
+/****f* lib5250/tn5250_print_pool_new
+ * NAME
+ *    tn5250_print_pool_new
+ * SYNOPSIS
+ *    pool = tn5250_print_pool_new (threads);
+ * INPUTS
+ *    int                  threads    -
+ * DESCRIPTION
+ *    Start threads to convert jobs for any number of print pipes.  Each
+ *    pipe's jobs are still converted in order, by one thread at a time.
+ *****/
+Tn5250PrintPool* tn5250_print_pool_new(int threads) {
+    Tn5250PrintPool* This;
+    int i;
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    This = tn5250_new(Tn5250PrintPool, 1);
+    if (This == NULL) {
+        return NULL;
+    }
+    This->workers = tn5250_new(pthread_t, threads);
+    if (This->workers == NULL) {
+        free(This);
+        return NULL;
+    }
+    pthread_mutex_init(&This->lock, NULL);
+    pthread_cond_init(&This->work, NULL);
+
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&This->workers[i], NULL, tn5250_print_pool_worker,
+                           This) != 0) {
+            break;
+        }
+    }
+    This->nworkers = i;
+    if (This->nworkers == 0) {
+        tn5250_print_pool_destroy(This);
+        return NULL;
+    }
+    return This;
+}
+
+/****f* lib5250/tn5250_print_pool_destroy
+ * NAME
+ *    tn5250_print_pool_destroy
+ * SYNOPSIS
+ *    tn5250_print_pool_destroy (This);
+ * INPUTS
+ *    Tn5250PrintPool *    This       -
+ * DESCRIPTION
+ *    Wait for the threads to convert everything queued, then stop them.
+ *    The pipes using the pool must have been destroyed first.
+ *****/
+void tn5250_print_pool_destroy(Tn5250PrintPool* This) {
+    int i;
+
+    pthread_mutex_lock(&This->lock);
+    This->stop = 1;
+    pthread_cond_broadcast(&This->work);
+    pthread_mutex_unlock(&This->lock);
+    for (i = 0; i < This->nworkers; i++) {
+        pthread_join(This->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&This->work);
+    pthread_mutex_destroy(&This->lock);
+    free(This->workers);
+    free(This);
+    return;
+}
+
+/****f* lib5250/tn5250_print_pipe_new
+ * NAME
+ *    tn5250_print_pipe_new
+ * SYNOPSIS
+ *    pipe = tn5250_print_pipe_new (output_cmd, pool);
+ * INPUTS
+ *    const char *         output_cmd -
+ *    Tn5250PrintPool *    pool       -
+ * DESCRIPTION
+ *    Set up in process conversion for output_cmd if it can be done, that
+ *    is, if it is one of scs2ascii, scs2ps or scs2pdf without arguments,
+ *    optionally piped into another command.  Returns NULL for anything
+ *    else, in which case the caller should popen() the command as usual.
+ *    The jobs are converted by pool, or by a thread of the pipe's own if
+ *    pool is NULL.
+ *****/
+Tn5250PrintPipe* tn5250_print_pipe_new(const char* output_cmd,
+                                       Tn5250PrintPool* pool) {
+    Tn5250PrintPipe* This;
+
+    This = tn5250_new(Tn5250PrintPipe, 1);
+    if (This == NULL) {
+        return NULL;
+    }
+    if (!tn5250_print_pipe_parse(This, output_cmd)) {
+        free(This->converter);
+        free(This->sink);
+        free(This);
+        return NULL;
+    }
+
+    /* scs2pdf writes to the file named by TN5250_PDF when it is set,
+     * which only the program does. */
+    if (strcmp(This->converter, "scs2pdf") == 0 &&
+        getenv("TN5250_PDF") != NULL) {
+        free(This->converter);
+        free(This->sink);
+        free(This);
+        return NULL;
+    }
+
+    if (!tn5250_print_pipe_start(This, pool)) {
+        free(This->converter);
+        free(This->sink);
+        free(This);
+        return NULL;
+    }
+    syslog(LOG_INFO, "Converting with %s in process", This->converter);
+    return This;
+}
+
+/****f* lib5250/tn5250_print_pipe_new_spool
+ * NAME
+ *    tn5250_print_pipe_new_spool
+ * SYNOPSIS
+ *    pipe = tn5250_print_pipe_new_spool (output_cmd, pool, spool_dir);
+ * INPUTS
+ *    const char *         output_cmd -
+ *    Tn5250PrintPool *    pool       -
+ *    const char *         spool_dir  -
+ * DESCRIPTION
+ *    Like tn5250_print_pipe_new, but each job is written to a file in
+ *    spool_dir as it arrives, and is only printed once it is complete, so
+ *    that a slow output command doesn't hold up the session.  A job is
+ *    named by when it arrived, with the suffix .part while it is being
+ *    received and .job once it is complete; it is deleted once it has
+ *    been printed, or renamed to .failed if the output command fails.
+ *    Complete jobs found in spool_dir, left by an earlier pipe or by a
+ *    crash, are printed first.  Each pipe needs a directory of its own.
+ *
+ *    Any output_cmd can be used.  If it isn't one of our converters, the
+ *    whole command is run for each job and given the job as it is.
+ *****/
+Tn5250PrintPipe* tn5250_print_pipe_new_spool(const char* output_cmd,
+                                             Tn5250PrintPool* pool,
+                                             const char* spool_dir) {
+    Tn5250PrintPipe* This;
+
+    This = tn5250_new(Tn5250PrintPipe, 1);
+    if (This == NULL) {
+        return NULL;
+    }
+    if (!tn5250_print_pipe_parse(This, output_cmd) ||
+        (strcmp(This->converter, "scs2pdf") == 0 &&
+         getenv("TN5250_PDF") != NULL)) {
+        free(This->converter);
+        free(This->sink);
+        This->converter = NULL;
+        This->sink = (char*)malloc(strlen(output_cmd) + 1);
+        if (This->sink != NULL) {
+            strcpy(This->sink, output_cmd);
+        }
+    }
+    This->spool_dir = (char*)malloc(strlen(spool_dir) + 1);
+    This->spool_buf = (char*)malloc(TN5250_PRINT_SPOOL_BUFSIZE);
+    if (This->sink == NULL || This->spool_dir == NULL ||
+        This->spool_buf == NULL || !tn5250_print_pipe_start(This, pool)) {
+        free(This->converter);
+        free(This->sink);
+        free(This->spool_dir);
+        free(This->spool_buf);
+        free(This);
+        return NULL;
+    }
+    strcpy(This->spool_dir, spool_dir);
+
+    syslog(LOG_INFO, "Spooling jobs for %s in %s",
+           This->converter != NULL ? This->converter : This->sink,
+           This->spool_dir);
+    tn5250_print_spool_scan(This);
+    return This;
+}
+
+/****f* lib5250/tn5250_print_pipe_destroy
+ * NAME
+ *    tn5250_print_pipe_destroy
+ * SYNOPSIS
+ *    tn5250_print_pipe_destroy (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Finish any job in progress, and free the pipe once everything queued
+ *    has been converted.  With a pool of its own, this waits for that;
+ *    with a shared pool, the pool's threads free the pipe when they are
+ *    done with it, so that the caller can carry on with other sessions.
+ *
+ *    Spooled jobs which haven't been started are left in the spool
+ *    directory for the next pipe to print.  A job still being spooled is
+ *    cut short, so it is left as a .part file and never printed.
+ *****/
+void tn5250_print_pipe_destroy(Tn5250PrintPipe* This) {
+    Tn5250PrintPool* pool = This->pool;
+    Tn5250PrintSpoolJob* job;
+    int own_pool = This->own_pool;
+    int done;
+
+    if (This->spool_dir != NULL) {
+        tn5250_print_spool_abandon(This);
+    }
+    else if (This->in_job) {
+        tn5250_print_pipe_end_job(This);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    This->closing = 1;
+    while ((job = This->jobs_head) != NULL) {
+        This->jobs_head = job->next;
+        free(job->filename);
+        free(job);
+    }
+    This->jobs_tail = NULL;
+    This->njobs = 0;
+    done = !This->busy && !This->queued && This->count == 0;
+    pthread_mutex_unlock(&pool->lock);
+
+    /* This may be gone from here on, if it wasn't done. */
+    if (done) {
+        tn5250_print_pipe_free(This);
+    }
+    if (own_pool) {
+        tn5250_print_pool_destroy(pool);
+    }
+    return;
+}
+
+/****f* lib5250/tn5250_print_pipe_write
+ * NAME
+ *    tn5250_print_pipe_write
+ * SYNOPSIS
+ *    tn5250_print_pipe_write (This, data, len);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ *    const unsigned char * data      -
+ *    int                  len        -
+ * DESCRIPTION
+ *    Queue SCS data for the current job.  The data is copied, so the
+ *    caller may reuse its buffer straight away.  This only blocks if the
+ *    queue is full, and never when spooling.
+ *****/
+void tn5250_print_pipe_write(Tn5250PrintPipe* This, const unsigned char* data,
+                             int len) {
+    if (len <= 0) {
+        return;
+    }
+    This->in_job = 1;
+    if (This->spool_dir == NULL) {
+        tn5250_print_pipe_put(This, data, len, 0);
+        return;
+    }
+
+    if (This->spool_file == NULL && !This->spool_failed) {
+        tn5250_print_spool_open(This);
+    }
+    if (This->spool_file != NULL &&
+        fwrite(data, 1, len, This->spool_file) != (size_t)len) {
+        tn5250_print_spool_discard(This);
+    }
+    return;
+}
+
+/****f* lib5250/tn5250_print_pipe_end_job
+ * NAME
+ *    tn5250_print_pipe_end_job
+ * SYNOPSIS
+ *    tn5250_print_pipe_end_job (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Mark the end of the current job.  The worker finishes the document
+ *    and closes its output once it has read this far.
+ *****/
+void tn5250_print_pipe_end_job(Tn5250PrintPipe* This) {
+    if (This->spool_dir != NULL) {
+        tn5250_print_spool_end_job(This);
+    }
+    else {
+        tn5250_print_pipe_put(This, NULL, 0, 1);
+    }
+    This->in_job = 0;
+    return;
+}
+
+/****f* lib5250/tn5250_print_pipe_depth
+ * NAME
+ *    tn5250_print_pipe_depth
+ * SYNOPSIS
+ *    n = tn5250_print_pipe_depth (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Returns how many records are queued and not yet converted, or when
+ *    spooling, how many complete jobs are waiting to be printed.  When
+ *    this reaches tn5250_print_pipe_capacity (), the next write blocks.
+ *****/
+int tn5250_print_pipe_depth(Tn5250PrintPipe* This) {
+    int count;
+
+    pthread_mutex_lock(&This->pool->lock);
+    count = This->count + This->njobs;
+    pthread_mutex_unlock(&This->pool->lock);
+    return count;
+}
+
+/****f* lib5250/tn5250_print_pipe_capacity
+ * NAME
+ *    tn5250_print_pipe_capacity
+ * SYNOPSIS
+ *    n = tn5250_print_pipe_capacity (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Returns how many records can be queued, or 0 if there is no limit,
+ *    as when spooling.
+ *****/
+int tn5250_print_pipe_capacity(Tn5250PrintPipe* This) {
+    if (This->spool_dir != NULL) {
+        return 0;
+    }
+    return TN5250_PRINT_PIPE_SLOTS;
+}
+
+/****i* lib5250/tn5250_print_pipe_parse
+ * NAME
+ *    tn5250_print_pipe_parse
+ * SYNOPSIS
+ *    ok = tn5250_print_pipe_parse (This, output_cmd);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ *    const char *         output_cmd -
+ * DESCRIPTION
+ *    Split output_cmd into the converter name and the sink command.
+ *    Returns 0 if the first command isn't a bare converter name.
+ *****/
+static int tn5250_print_pipe_parse(Tn5250PrintPipe* This,
+                                   const char* output_cmd) {
+    const char* p = output_cmd;
+    const char* name;
+    int len;
+    Tn5250SCS* scs;
+
+    while (isspace((unsigned char)*p)) {
+        p++;
+    }
+    name = p;
+    while (*p != '\0' && *p != '|' && !isspace((unsigned char)*p)) {
+        p++;
+    }
+    len = p - name;
+    while (isspace((unsigned char)*p)) {
+        p++;
+    }
+    if (len == 0 || (*p != '\0' && *p != '|')) {
+        return 0;
+    }
+
+    This->converter = (char*)malloc(len + 1);
+    if (This->converter == NULL) {
+        return 0;
+    }
+    memcpy(This->converter, name, len);
+    This->converter[len] = '\0';
+
+    if ((scs = tn5250_scs_converter_new(This->converter)) == NULL) {
+        return 0;
+    }
+    tn5250_scs_destroy(scs);
+
+    if (*p == '|') {
+        p++;
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            return 0;
+        }
+        This->sink = (char*)malloc(strlen(p) + 1);
+        if (This->sink == NULL) {
+            return 0;
+        }
+        strcpy(This->sink, p);
+    }
+    return 1;
+}
+
+/****i* lib5250/tn5250_print_pipe_start
+ * NAME
+ *    tn5250_print_pipe_start
+ * SYNOPSIS
+ *    ok = tn5250_print_pipe_start (This, pool);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ *    Tn5250PrintPool *    pool       -
+ * DESCRIPTION
+ *    Set up the queue and attach the pipe to pool, or to a pool of its
+ *    own if pool is NULL.  Returns 0 if the threads can't be started.
+ *****/
+static int tn5250_print_pipe_start(Tn5250PrintPipe* This,
+                                   Tn5250PrintPool* pool) {
+    int i;
+
+    if (pool == NULL) {
+        if ((pool = tn5250_print_pool_new(1)) == NULL) {
+            return 0;
+        }
+        This->own_pool = 1;
+    }
+    This->pool = pool;
+
+    for (i = 0; i < TN5250_PRINT_PIPE_SLOTS; i++) {
+        tn5250_buffer_init(&This->slots[i].data);
+    }
+    pthread_cond_init(&This->not_full, NULL);
+    return 1;
+}
+
+/****i* lib5250/tn5250_print_pipe_put
+ * NAME
+ *    tn5250_print_pipe_put
+ * SYNOPSIS
+ *    tn5250_print_pipe_put (This, data, len, end_of_job);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ *    const unsigned char * data      -
+ *    int                  len        -
+ *    int                  end_of_job -
+ * DESCRIPTION
+ *    Add a slot to the queue, waiting for the workers if it is full, and
+ *    make sure the pipe is on the pool's ready list.  There is only one
+ *    writer, and the workers don't look at a slot until it has been
+ *    counted, so the copy is done without holding the lock.
+ *****/
+static void tn5250_print_pipe_put(Tn5250PrintPipe* This,
+                                  const unsigned char* data, int len,
+                                  int end_of_job) {
+    Tn5250PrintPool* pool = This->pool;
+    Tn5250PrintPipeSlot* slot;
+
+    pthread_mutex_lock(&pool->lock);
+    while (This->count == TN5250_PRINT_PIPE_SLOTS) {
+        pthread_cond_wait(&This->not_full, &pool->lock);
+    }
+    slot = &This->slots[(This->head + This->count) % TN5250_PRINT_PIPE_SLOTS];
+    pthread_mutex_unlock(&pool->lock);
+
+    slot->data.len = 0;
+    if (len > 0) {
+        tn5250_buffer_append_data(&slot->data, (unsigned char*)data, len);
+    }
+    slot->end_of_job = end_of_job;
+
+    pthread_mutex_lock(&pool->lock);
+    This->count++;
+    if (!This->busy && !This->queued) {
+        tn5250_print_pool_ready(pool, This);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return;
+}
+
+/****i* lib5250/tn5250_print_pipe_convert
+ * NAME
+ *    tn5250_print_pipe_convert
+ * SYNOPSIS
+ *    tn5250_print_pipe_convert (This, slot);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ *    Tn5250PrintPipeSlot * slot      -
+ * DESCRIPTION
+ *    Convert one slot.  The sink command is only started once the first
+ *    record of a job has arrived, as the popen() of the whole output
+ *    command used to be.  Records are converted straight out of their
+ *    slots.
+ *****/
+static void tn5250_print_pipe_convert(Tn5250PrintPipe* This,
+                                      Tn5250PrintPipeSlot* slot) {
+    if (!This->job_open) {
+        tn5250_print_pipe_open_job(This);
+    }
+    if (slot->end_of_job) {
+        tn5250_print_pipe_close_job(This);
+    }
+    else {
+        tn5250_print_pipe_emit(This, slot->data.data, slot->data.len);
+    }
+    return;
+}
+
+/****i* lib5250/tn5250_print_pipe_open_job
+ * NAME
+ *    tn5250_print_pipe_open_job
+ * SYNOPSIS
+ *    tn5250_print_pipe_open_job (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Start the sink command and the converter for a new job.  If either
+ *    can't be started, the job is discarded as it arrives.
+ *****/
+static void tn5250_print_pipe_open_job(Tn5250PrintPipe* This) {
+    This->job_open = 1;
+    if (This->sink != NULL) {
+        This->out = popen(This->sink, "w");
+    }
+    else {
+        This->out = stdout;
+    }
+    if (This->converter != NULL) {
+        This->scs = tn5250_scs_converter_new(This->converter);
+    }
+
+    if (This->out == NULL || (This->converter != NULL && This->scs == NULL)) {
+        syslog(LOG_INFO, "Can't start %s, discarding job",
+               This->sink != NULL ? This->sink : This->converter);
+        if (This->scs != NULL) {
+            tn5250_scs_destroy(This->scs);
+            This->scs = NULL;
+        }
+    }
+    else if (This->scs != NULL) {
+        This->scs->output = This->out;
+        tn5250_scs_begin(This->scs);
+    }
+    return;
+}
+
+/****i* lib5250/tn5250_print_pipe_emit
+ * NAME
+ *    tn5250_print_pipe_emit
+ * SYNOPSIS
+ *    tn5250_print_pipe_emit (This, data, len);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ *    const unsigned char * data      -
+ *    size_t               len        -
+ * DESCRIPTION
+ *    Pass SCS data for the open job to the converter, or straight to the
+ *    sink if there is no converter.
+ *****/
+static void tn5250_print_pipe_emit(Tn5250PrintPipe* This,
+                                   const unsigned char* data, size_t len) {
+    size_t n;
+
+    if (This->converter == NULL) {
+        if (This->out != NULL) {
+            fwrite(data, 1, len, This->out);
+        }
+        return;
+    }
+    if (This->scs == NULL) {
+        return;
+    }
+    /* A spooled job may be bigger than the converter takes at once. */
+    while (len > 0) {
+        n = len < 0x40000000 ? len : 0x40000000;
+        tn5250_scs_feed(This->scs, data, (int)n);
+        data += n;
+        len -= n;
+    }
+    return;
+}
+
+/****i* lib5250/tn5250_print_pipe_close_job
+ * NAME
+ *    tn5250_print_pipe_close_job
+ * SYNOPSIS
+ *    ok = tn5250_print_pipe_close_job (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Finish the document and wait for the sink command.  Returns 0 if the
+ *    job was discarded or the sink command failed.
+ *****/
+static int tn5250_print_pipe_close_job(Tn5250PrintPipe* This) {
+    int ok = This->out != NULL &&
+             (This->converter == NULL || This->scs != NULL);
+
+    if (This->scs != NULL) {
+        tn5250_scs_end(This->scs);
+        tn5250_scs_destroy(This->scs);
+        This->scs = NULL;
+    }
+    if (This->out != NULL && This->sink != NULL) {
+        if (pclose(This->out) != 0) {
+            ok = 0;
+        }
+    }
+    else if (This->out != NULL) {
+        fflush(This->out);
+    }
+    This->out = NULL;
+    This->job_open = 0;
+    return ok;
+}
+
+/****i* lib5250/tn5250_print_pipe_free
+ * NAME
+ *    tn5250_print_pipe_free
+ * SYNOPSIS
+ *    tn5250_print_pipe_free (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Free a pipe which has been destroyed and has nothing left queued.
+ *****/
+static void tn5250_print_pipe_free(Tn5250PrintPipe* This) {
+    int i;
+
+    for (i = 0; i < TN5250_PRINT_PIPE_SLOTS; i++) {
+        tn5250_buffer_free(&This->slots[i].data);
+    }
+    pthread_cond_destroy(&This->not_full);
+    if (This->converter != NULL) {
+        free(This->converter);
+    }
+    if (This->sink != NULL) {
+        free(This->sink);
+    }
+    if (This->spool_dir != NULL) {
+        free(This->spool_dir);
+    }
+    if (This->spool_buf != NULL) {
+        free(This->spool_buf);
+    }
+    free(This);
+    return;
+}
+
+/****i* lib5250/tn5250_print_pool_ready
+ * NAME
+ *    tn5250_print_pool_ready
+ * SYNOPSIS
+ *    tn5250_print_pool_ready (This, pipe);
+ * INPUTS
+ *    Tn5250PrintPool *    This       -
+ *    Tn5250PrintPipe *    pipe       -
+ * DESCRIPTION
+ *    Put a pipe with queued records at the end of the ready list and wake
+ *    a worker for it.  Called with the lock held.
+ *****/
+static void tn5250_print_pool_ready(Tn5250PrintPool* This,
+                                    Tn5250PrintPipe* pipe) {
+    pipe->next_ready = NULL;
+    if (This->ready_tail != NULL) {
+        This->ready_tail->next_ready = pipe;
+    }
+    else {
+        This->ready_head = pipe;
+    }
+    This->ready_tail = pipe;
+    pipe->queued = 1;
+    pthread_cond_signal(&This->work);
+    return;
+}
+
+/****i* lib5250/tn5250_print_pool_worker
+ * NAME
+ *    tn5250_print_pool_worker
+ * SYNOPSIS
+ *    pthread_create (&worker, NULL, tn5250_print_pool_worker, This);
+ * INPUTS
+ *    void *               arg        - The Tn5250PrintPool.
+ * DESCRIPTION
+ *    Take pipes off the ready list and convert their records, until the
+ *    pool is destroyed and the list is empty.  A pipe gets at most a
+ *    queue's worth of records, or one spooled job, per turn and then goes
+ *    to the back of the list, so one long job doesn't hold up every other
+ *    device for long.
+ *****/
+static void* tn5250_print_pool_worker(void* arg) {
+    Tn5250PrintPool* This = (Tn5250PrintPool*)arg;
+    Tn5250PrintPipe* pipe;
+    Tn5250PrintPipeSlot* slot;
+    Tn5250PrintSpoolJob* job;
+    int n, done;
+
+    pthread_mutex_lock(&This->lock);
+    for (;;) {
+        while (This->ready_head == NULL && !This->stop) {
+            pthread_cond_wait(&This->work, &This->lock);
+        }
+        if ((pipe = This->ready_head) == NULL) {
+            break;
+        }
+        This->ready_head = pipe->next_ready;
+        if (This->ready_head == NULL) {
+            This->ready_tail = NULL;
+        }
+        pipe->queued = 0;
+        pipe->busy = 1;
+
+        /* A spooled job is a turn on its own. */
+        if ((job = pipe->jobs_head) != NULL) {
+            pipe->jobs_head = job->next;
+            if (pipe->jobs_head == NULL) {
+                pipe->jobs_tail = NULL;
+            }
+            pipe->njobs--;
+            pthread_mutex_unlock(&This->lock);
+            tn5250_print_spool_print(pipe, job->filename);
+            free(job->filename);
+            free(job);
+            pthread_mutex_lock(&This->lock);
+        }
+
+        for (n = 0; n < TN5250_PRINT_PIPE_SLOTS && pipe->count > 0; n++) {
+            slot = &pipe->slots[pipe->head];
+            pthread_mutex_unlock(&This->lock);
+            tn5250_print_pipe_convert(pipe, slot);
+            pthread_mutex_lock(&This->lock);
+
+            pipe->head = (pipe->head + 1) % TN5250_PRINT_PIPE_SLOTS;
+            pipe->count--;
+            pthread_cond_signal(&pipe->not_full);
+        }
+
+        pipe->busy = 0;
+        done = 0;
+        if (pipe->count > 0 || pipe->jobs_head != NULL) {
+            tn5250_print_pool_ready(This, pipe);
+        }
+        else if (pipe->closing) {
+            done = 1;
+        }
+        if (done) {
+            pthread_mutex_unlock(&This->lock);
+            tn5250_print_pipe_free(pipe);
+            pthread_mutex_lock(&This->lock);
+        }
+    }
+    pthread_mutex_unlock(&This->lock);
+    return NULL;
+}
+
+/****i* lib5250/tn5250_print_spool_open
+ * NAME
+ *    tn5250_print_spool_open
+ * SYNOPSIS
+ *    tn5250_print_spool_open (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Create the spool file for a new job.  Names sort in the order the
+ *    jobs arrived.
+ *****/
+static void tn5250_print_spool_open(Tn5250PrintPipe* This) {
+    int fd;
+
+    This->spool_name = (char*)malloc(strlen(This->spool_dir) + 32);
+    if (This->spool_name == NULL) {
+        This->spool_failed = 1;
+        return;
+    }
+    do {
+        sprintf(This->spool_name, "%s/%010lu-%05lu.part", This->spool_dir,
+                (unsigned long)time(NULL), This->spool_seq++ % 100000);
+        fd = open(This->spool_name, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    } while (fd == -1 && errno == EEXIST);
+
+    if (fd == -1 || (This->spool_file = fdopen(fd, "w")) == NULL) {
+        syslog(LOG_INFO, "Can't spool job to %s: %s, discarding job",
+               This->spool_name, strerror(errno));
+        if (fd != -1) {
+            close(fd);
+            unlink(This->spool_name);
+        }
+        free(This->spool_name);
+        This->spool_name = NULL;
+        This->spool_failed = 1;
+        return;
+    }
+    setvbuf(This->spool_file, This->spool_buf, _IOFBF,
+            TN5250_PRINT_SPOOL_BUFSIZE);
+    return;
+}
+
+/****i* lib5250/tn5250_print_spool_discard
+ * NAME
+ *    tn5250_print_spool_discard
+ * SYNOPSIS
+ *    tn5250_print_spool_discard (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Give up on the job being received, after a write error.  The rest of
+ *    the job is dropped as it arrives.
+ *****/
+static void tn5250_print_spool_discard(Tn5250PrintPipe* This) {
+    syslog(LOG_INFO, "Can't spool job to %s: %s, discarding job",
+           This->spool_name, strerror(errno));
+    fclose(This->spool_file);
+    This->spool_file = NULL;
+    unlink(This->spool_name);
+    free(This->spool_name);
+    This->spool_name = NULL;
+    This->spool_failed = 1;
+    return;
+}
+
+/****i* lib5250/tn5250_print_spool_abandon
+ * NAME
+ *    tn5250_print_spool_abandon
+ * SYNOPSIS
+ *    tn5250_print_spool_abandon (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Stop spooling the job being received without queueing it, because
+ *    the pipe is going away before the job ended.  What was received is
+ *    left in the .part file for the administrator, as after a crash.
+ *****/
+static void tn5250_print_spool_abandon(Tn5250PrintPipe* This) {
+    if (This->spool_file != NULL) {
+        fclose(This->spool_file);
+        This->spool_file = NULL;
+        syslog(LOG_INFO, "Incomplete job %s left in spool", This->spool_name);
+    }
+    if (This->spool_name != NULL) {
+        free(This->spool_name);
+        This->spool_name = NULL;
+    }
+    This->spool_failed = 0;
+    This->in_job = 0;
+    return;
+}
+
+/****i* lib5250/tn5250_print_spool_end_job
+ * NAME
+ *    tn5250_print_spool_end_job
+ * SYNOPSIS
+ *    tn5250_print_spool_end_job (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Finish the spool file of the job being received, and queue it to be
+ *    printed.  The file is only renamed from .part to .job once it is on
+ *    disk, so a .job file is always a whole job, even after a crash.
+ *****/
+static void tn5250_print_spool_end_job(Tn5250PrintPipe* This) {
+    char* part;
+    char* filename;
+    size_t len;
+    int fd;
+
+    if (This->spool_file == NULL && !This->spool_failed) {
+        tn5250_print_spool_open(This);
+    }
+    This->spool_failed = 0;
+    if (This->spool_file == NULL) {
+        return;
+    }
+
+    if (fflush(This->spool_file) != 0 ||
+        fsync(fileno(This->spool_file)) != 0) {
+        tn5250_print_spool_discard(This);
+        This->spool_failed = 0;
+        return;
+    }
+    fclose(This->spool_file);
+    This->spool_file = NULL;
+
+    part = This->spool_name;
+    This->spool_name = NULL;
+    len = strlen(part) - 5; /* Without ".part" */
+    if ((filename = (char*)malloc(len + 5)) == NULL) {
+        free(part);
+        return;
+    }
+    memcpy(filename, part, len);
+    strcpy(filename + len, ".job");
+    if (rename(part, filename) != 0) {
+        syslog(LOG_INFO, "Can't spool job to %s: %s, discarding job",
+               filename, strerror(errno));
+        unlink(part);
+        free(part);
+        free(filename);
+        return;
+    }
+    free(part);
+
+    /* Make the rename stick too. */
+    if ((fd = open(This->spool_dir, O_RDONLY)) != -1) {
+        fsync(fd);
+        close(fd);
+    }
+    tn5250_print_spool_queue(This, filename);
+    return;
+}
+
+/****i* lib5250/tn5250_print_spool_queue
+ * NAME
+ *    tn5250_print_spool_queue
+ * SYNOPSIS
+ *    tn5250_print_spool_queue (This, filename);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ *    char *               filename   - Taken over by the queue.
+ * DESCRIPTION
+ *    Queue a complete spool file to be printed.
+ *****/
+static void tn5250_print_spool_queue(Tn5250PrintPipe* This, char* filename) {
+    Tn5250PrintPool* pool = This->pool;
+    Tn5250PrintSpoolJob* job;
+
+    if ((job = tn5250_new(Tn5250PrintSpoolJob, 1)) == NULL) {
+        free(filename);
+        return;
+    }
+    job->filename = filename;
+
+    pthread_mutex_lock(&pool->lock);
+    if (This->jobs_tail != NULL) {
+        This->jobs_tail->next = job;
+    }
+    else {
+        This->jobs_head = job;
+    }
+    This->jobs_tail = job;
+    This->njobs++;
+    if (!This->busy && !This->queued) {
+        tn5250_print_pool_ready(pool, This);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return;
+}
+
+/****i* lib5250/tn5250_print_spool_scan
+ * NAME
+ *    tn5250_print_spool_scan
+ * SYNOPSIS
+ *    tn5250_print_spool_scan (This);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ * DESCRIPTION
+ *    Queue the complete jobs already in the spool directory, oldest
+ *    first.  A .part file was still being received when an earlier
+ *    lp5250d stopped, and is left for the administrator.
+ *****/
+static void tn5250_print_spool_scan(Tn5250PrintPipe* This) {
+    DIR* dir;
+    struct dirent* ent;
+    char** names = NULL;
+    char** bigger;
+    int count = 0, size = 0, i;
+    size_t len;
+
+    if ((dir = opendir(This->spool_dir)) == NULL) {
+        syslog(LOG_INFO, "Can't read %s: %s", This->spool_dir,
+               strerror(errno));
+        return;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+        len = strlen(ent->d_name);
+        if (len > 5 && strcmp(ent->d_name + len - 5, ".part") == 0) {
+            syslog(LOG_INFO, "Incomplete job %s/%s left in spool",
+                   This->spool_dir, ent->d_name);
+            continue;
+        }
+        if (len <= 4 || strcmp(ent->d_name + len - 4, ".job") != 0) {
+            continue;
+        }
+        if (count == size) {
+            size = size == 0 ? 16 : size * 2;
+            bigger = (char**)realloc(names, size * sizeof(char*));
+            if (bigger == NULL) {
+                break;
+            }
+            names = bigger;
+        }
+        names[count] = (char*)malloc(strlen(This->spool_dir) + len + 2);
+        if (names[count] == NULL) {
+            break;
+        }
+        sprintf(names[count], "%s/%s", This->spool_dir, ent->d_name);
+        count++;
+    }
+    closedir(dir);
+
+    if (count > 0) {
+        syslog(LOG_INFO, "%d spooled jobs to print in %s", count,
+               This->spool_dir);
+        qsort(names, count, sizeof(char*), tn5250_print_spool_compare);
+    }
+    for (i = 0; i < count; i++) {
+        tn5250_print_spool_queue(This, names[i]);
+    }
+    if (names != NULL) {
+        free(names);
+    }
+    return;
+}
+
+/****i* lib5250/tn5250_print_spool_compare
+ * NAME
+ *    tn5250_print_spool_compare
+ * SYNOPSIS
+ *    qsort (names, count, sizeof (char *), tn5250_print_spool_compare);
+ * INPUTS
+ *    const void *         a          -
+ *    const void *         b          -
+ * DESCRIPTION
+ *    Order spool file names, which is the order the jobs arrived in.
+ *****/
+static int tn5250_print_spool_compare(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/****i* lib5250/tn5250_print_spool_print
+ * NAME
+ *    tn5250_print_spool_print
+ * SYNOPSIS
+ *    tn5250_print_spool_print (This, filename);
+ * INPUTS
+ *    Tn5250PrintPipe *    This       -
+ *    const char *         filename   -
+ * DESCRIPTION
+ *    Print a spooled job, mapping the file rather than reading it, and
+ *    delete it once the sink command has succeeded.  The file is locked
+ *    while it is printed, so that when a pipe for the same directory is
+ *    created before an old one has finished, as when a session is
+ *    reconnected, the job isn't printed twice.
+ *****/
+static void tn5250_print_spool_print(Tn5250PrintPipe* This,
+                                     const char* filename) {
+    struct stat st;
+    void* data = NULL;
+    char* failed;
+    int fd;
+
+    if ((fd = open(filename, O_RDONLY)) == -1) {
+        return; /* Printed already. */
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1 || fstat(fd, &st) == -1 ||
+        st.st_nlink == 0) {
+        close(fd);
+        return;
+    }
+    if (st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            syslog(LOG_INFO, "Can't map %s: %s", filename, strerror(errno));
+            close(fd);
+            return;
+        }
+    }
+
+    tn5250_print_pipe_open_job(This);
+    if (data != NULL) {
+        tn5250_print_pipe_emit(This, (const unsigned char*)data,
+                               (size_t)st.st_size);
+        munmap(data, st.st_size);
+    }
+
+    if (tn5250_print_pipe_close_job(This)) {
+        unlink(filename);
+    }
+    else if ((failed = (char*)malloc(strlen(filename) + 4)) != NULL) {
+        /* Keep it, but don't try it again. */
+        strcpy(failed, filename);
+        strcpy(failed + strlen(failed) - 4, ".failed");
+        syslog(LOG_INFO, "Printing %s failed, kept as %s", filename, failed);
+        rename(filename, failed);
+        free(failed);
+    }
+    close(fd);
+    return;
+}
+
+#else
+
+Tn5250PrintPool* tn5250_print_pool_new(int threads) { return NULL; }
+
+void tn5250_print_pool_destroy(Tn5250PrintPool* This) { return; }
+
+Tn5250PrintPipe* tn5250_print_pipe_new(const char* output_cmd,
+                                       Tn5250PrintPool* pool) {
+    return NULL;
+}
+
+Tn5250PrintPipe* tn5250_print_pipe_new_spool(const char* output_cmd,
+                                             Tn5250PrintPool* pool,
+                                             const char* spool_dir) {
+    return NULL;
+}
+
+void tn5250_print_pipe_destroy(Tn5250PrintPipe* This) { return; }
+
+void tn5250_print_pipe_write(Tn5250PrintPipe* This, const unsigned char* data,
+                             int len) {
+    return;
+}
+
+void tn5250_print_pipe_end_job(Tn5250PrintPipe* This) { return; }
+
+int tn5250_print_pipe_depth(Tn5250PrintPipe* This) { return 0; }
+
+int tn5250_print_pipe_capacity(Tn5250PrintPipe* This) { return 0; }
+
+#endif
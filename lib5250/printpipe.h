@@ -0,0 +1,99 @@
+/* TN5250 - An implementation of the 5250 telnet protocol.
+ * Copyright (C) 1997-2008 Michael Madore
+ *
+ * This file is part of TN5250.
+ *
+ * TN5250 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1, or (at your option)
+ * any later version.
+ *
+ * TN5250 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307 USA
+ *
+ */
+#ifndef PRINTPIPE_H
+#define PRINTPIPE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****s* lib5250/Tn5250PrintPool
+ * NAME
+ *    Tn5250PrintPool
+ * SYNOPSIS
+ *    Tn5250PrintPool *pool = tn5250_print_pool_new (4);
+ *    a = tn5250_print_pipe_new ("scs2ps | lpr -Pa", pool);
+ *    b = tn5250_print_pipe_new ("scs2pdf | mail-pdf", pool);
+ *    ...
+ *    tn5250_print_pipe_destroy (a);
+ *    tn5250_print_pipe_destroy (b);
+ *    tn5250_print_pool_destroy (pool);
+ * DESCRIPTION
+ *    A set of worker threads shared by the print pipes of several
+ *    sessions, so that one lp5250d serving many devices doesn't need a
+ *    thread per device.  Each pipe's records are converted in order, and
+ *    a pipe with a long job takes its turn with the others.
+ *
+ *    The structure itself is private to printpipe.c.
+ * SOURCE
+ */
+struct _Tn5250PrintPool;
+typedef struct _Tn5250PrintPool Tn5250PrintPool;
+/*******/
+
+/****s* lib5250/Tn5250PrintPipe
+ * NAME
+ *    Tn5250PrintPipe
+ * SYNOPSIS
+ *    Tn5250PrintPipe *pipe = tn5250_print_pipe_new ("scs2ps | lpr", NULL);
+ *    tn5250_print_pipe_write (pipe, data, len);
+ *    tn5250_print_pipe_end_job (pipe);
+ *    tn5250_print_pipe_destroy (pipe);
+ * DESCRIPTION
+ *    Converts print jobs with one of the built in SCS converters on a
+ *    worker thread, of its own or from a Tn5250PrintPool, instead of
+ *    starting the converter program for every job.  Records are copied
+ *    into a bounded queue as they arrive and the worker converts them as
+ *    it goes; only the command after the '|', if there is one, is started
+ *    per job, to receive the converted output.
+ *
+ *    A pipe made by tn5250_print_pipe_new_spool writes each job to a file
+ *    in a spool directory instead, and converts it once it is complete.
+ *
+ *    The structure itself is private to printpipe.c.
+ * SOURCE
+ */
+struct _Tn5250PrintPipe;
+typedef struct _Tn5250PrintPipe Tn5250PrintPipe;
+/*******/
+
+extern Tn5250PrintPool /*@only@*/ /*@null@*/* tn5250_print_pool_new(
+    int threads);
+extern void tn5250_print_pool_destroy(Tn5250PrintPool /*@only@*/* This);
+
+extern Tn5250PrintPipe /*@only@*/ /*@null@*/* tn5250_print_pipe_new(
+    const char* output_cmd, Tn5250PrintPool /*@null@*/* pool);
+extern Tn5250PrintPipe /*@only@*/ /*@null@*/* tn5250_print_pipe_new_spool(
+    const char* output_cmd, Tn5250PrintPool /*@null@*/* pool,
+    const char* spool_dir);
+extern void tn5250_print_pipe_destroy(Tn5250PrintPipe /*@only@*/* This);
+extern void tn5250_print_pipe_write(Tn5250PrintPipe* This,
+                                    const unsigned char* data, int len);
+extern void tn5250_print_pipe_end_job(Tn5250PrintPipe* This);
+extern int tn5250_print_pipe_depth(Tn5250PrintPipe* This);
+extern int tn5250_print_pipe_capacity(Tn5250PrintPipe* This);
+
+#ifdef __cplusplus
+}
+
+#endif
+#endif /* PRINTPIPE_H */
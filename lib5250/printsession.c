@@ -68,7 +68,14 @@ static const struct response_code {
     // clang-format on
 };
 
+/* Size of the buffer between us and the output command.  Print jobs
+ * arrive a record (a few kilobytes) at a time, so this lets the pipe be
+ * written in large pieces rather than whenever stdio's default buffer
+ * fills. */
+#define TN5250_PRINT_SESSION_BUFSIZE 65536
+
 static int tn5250_print_session_waitevent(Tn5250PrintSession* This);
+static void tn5250_print_session_record(Tn5250PrintSession* This);
 
 /****f* lib5250/tn5250_print_session_new
  * NAME
@@ -96,10 +103,14 @@ Tn5250PrintSession* tn5250_print_session_new() {
 
     This->stream = NULL;
     This->printfile = NULL;
+    This->printbuf = NULL;
+    This->pipe = NULL;
     This->output_cmd = NULL;
     This->conn_fd = -1;
     This->map = NULL;
     This->script_slot = NULL;
+    This->pool = NULL;
+    This->spool_dir = NULL;
 
     return This;
 }
@@ -124,9 +135,22 @@ void tn5250_print_session_destroy(Tn5250PrintSession* This) {
     if (This->output_cmd != NULL) {
         free(This->output_cmd);
     }
+    if (This->spool_dir != NULL) {
+        free(This->spool_dir);
+    }
     if (This->map != NULL) {
         tn5250_char_map_destroy(This->map);
     }
+    if (This->pipe != NULL) {
+        tn5250_print_pipe_destroy(This->pipe);
+    }
+    /* printbuf is printfile's stdio buffer, so it goes after the pclose. */
+    if (This->printfile != NULL) {
+        pclose(This->printfile);
+    }
+    if (This->printbuf != NULL) {
+        free(This->printbuf);
+    }
     free(This);
 }
 
@@ -257,87 +281,224 @@ int tn5250_print_session_get_response_code(Tn5250PrintSession* This,
  *    This function continually loops, waiting for print jobs from the AS/400.
  *    When it gets one, it sends it to the output command which was specified
  *    on the command line.  If the host closes the socket, we exit.
+ *
+ *    When the output command starts with one of our own SCS converters,
+ *    the conversion is done in this process by a Tn5250PrintPipe, and
+ *    only the rest of the command is run for each job.
  *****/
 void tn5250_print_session_main_loop(Tn5250PrintSession* This) {
-    int pcount;
-    int newjob;
-    char responsecode[5];
-    StreamHeader header;
+    int ret;
 
     while (1) {
         if (tn5250_print_session_waitevent(This)) {
-            if (tn5250_stream_handle_receive(This->stream)) {
-                pcount = tn5250_stream_record_count(This->stream);
-                if (pcount > 0) {
-                    if (This->rec != NULL) {
-                        tn5250_record_destroy(This->rec);
-                    }
-                    This->rec = tn5250_stream_get_record(This->stream);
-                    if (!tn5250_print_session_get_response_code(This,
-                                                                responsecode)) {
-                        exit(1);
-                    }
-                    break;
-                }
+            ret = tn5250_print_session_handle_receive(This);
+            if (ret == -1) {
+                exit(1);
             }
-            else {
-                syslog(LOG_INFO, "Socket closed by host.");
+            else if (ret == 0) {
+                if (This->pipe != NULL) {
+                    /* Let the worker finish what it has been given. */
+                    tn5250_print_pipe_destroy(This->pipe);
+                    This->pipe = NULL;
+                }
                 exit(-1);
             }
         }
     }
+}
 
-    newjob = 1;
-    while (1) {
-        if (tn5250_print_session_waitevent(This)) {
-            if (tn5250_stream_handle_receive(This->stream)) {
-                pcount = tn5250_stream_record_count(This->stream);
-                if (pcount > 0) {
-                    if (newjob) {
-                        char* output_cmd;
-                        if ((output_cmd = This->output_cmd) == NULL) {
-                            output_cmd = "scs2ascii |lpr";
-                        }
-                        This->printfile = popen(output_cmd, "w");
-                        TN5250_ASSERT(This->printfile != NULL);
-                        newjob = 0;
-                    }
-                    if (This->rec != NULL) {
-                        tn5250_record_destroy(This->rec);
-                    }
-                    This->rec = tn5250_stream_get_record(This->stream);
-
-                    if (tn5250_record_opcode(This->rec) ==
-                        TN5250_RECORD_OPCODE_CLEAR) {
-                        syslog(LOG_INFO, "Clearing print buffers");
-                        continue;
-                    }
-
-                    header.flowtype = TN5250_RECORD_FLOW_CLIENTO;
-                    header.flags = TN5250_RECORD_H_NONE;
-                    header.opcode = TN5250_RECORD_OPCODE_PRINT_COMPLETE;
-
-                    tn5250_stream_send_packet(This->stream, 0, header, NULL);
-
-                    if (tn5250_record_length(This->rec) == 0x11) {
-                        syslog(LOG_INFO, "Job Complete\n");
-                        pclose(This->printfile);
-                        newjob = 1;
-                    }
-                    else {
-                        while (!tn5250_record_is_chain_end(This->rec)) {
-                            fprintf(This->printfile, "%c",
-                                    tn5250_record_get_byte(This->rec));
-                        }
-                    }
-                }
+/****f* lib5250/tn5250_print_session_handle_receive
+ * NAME
+ *    tn5250_print_session_handle_receive
+ * SYNOPSIS
+ *    ret = tn5250_print_session_handle_receive (This);
+ * INPUTS
+ *    Tn5250PrintSession * This       -
+ * DESCRIPTION
+ *    Read what has arrived on the session's socket and handle every
+ *    record it completes: the startup response first, then print data.
+ *    This is the body of tn5250_print_session_main_loop, for callers
+ *    which run their own event loop, such as lp5250d serving several
+ *    devices.  Returns 1 while the session is up, 0 if the host has
+ *    closed the socket, and -1 if the host refused to start the session.
+ *****/
+int tn5250_print_session_handle_receive(Tn5250PrintSession* This) {
+    char responsecode[5];
+    const char* output_cmd;
+
+    if (!tn5250_stream_handle_receive(This->stream)) {
+        syslog(LOG_INFO, "Socket closed by host");
+        return 0;
+    }
+
+    while (tn5250_stream_record_count(This->stream) > 0) {
+        if (This->rec != NULL) {
+            tn5250_record_destroy(This->rec);
+        }
+        This->rec = tn5250_stream_get_record(This->stream);
+
+        if (!This->started) {
+            if (!tn5250_print_session_get_response_code(This, responsecode)) {
+                return -1;
             }
-            else {
-                syslog(LOG_INFO, "Socket closed by host");
-                exit(-1);
+            This->started = 1;
+            This->newjob = 1;
+
+            if ((output_cmd = This->output_cmd) == NULL) {
+                output_cmd = "scs2ascii |lpr";
+            }
+            if (This->pipe == NULL && This->spool_dir != NULL) {
+                This->pipe = tn5250_print_pipe_new_spool(
+                    output_cmd, This->pool, This->spool_dir);
+            }
+            if (This->pipe == NULL) {
+                This->pipe = tn5250_print_pipe_new(output_cmd, This->pool);
             }
+            continue;
+        }
+
+        tn5250_print_session_record(This);
+    }
+    return 1;
+}
+
+/****i* lib5250/tn5250_print_session_record
+ * NAME
+ *    tn5250_print_session_record
+ * SYNOPSIS
+ *    tn5250_print_session_record (This);
+ * INPUTS
+ *    Tn5250PrintSession * This       -
+ * DESCRIPTION
+ *    Acknowledge a print record and pass its SCS data on to the output
+ *    command, starting a job if there isn't one.
+ *****/
+static void tn5250_print_session_record(Tn5250PrintSession* This) {
+    StreamHeader header;
+    int len;
+
+    if (This->newjob && This->pipe != NULL) {
+        This->newjob = 0;
+    }
+    else if (This->newjob) {
+        This->printfile = popen(This->output_cmd != NULL ? This->output_cmd
+                                                         : "scs2ascii |lpr",
+                                "w");
+        TN5250_ASSERT(This->printfile != NULL);
+        if (This->printbuf == NULL) {
+            This->printbuf = (char*)malloc(TN5250_PRINT_SESSION_BUFSIZE);
+        }
+        if (This->printbuf != NULL) {
+            setvbuf(This->printfile, This->printbuf, _IOFBF,
+                    TN5250_PRINT_SESSION_BUFSIZE);
         }
+        This->newjob = 0;
+    }
+
+    if (tn5250_record_opcode(This->rec) == TN5250_RECORD_OPCODE_CLEAR) {
+        syslog(LOG_INFO, "Clearing print buffers");
+        return;
+    }
+
+    header.flowtype = TN5250_RECORD_FLOW_CLIENTO;
+    header.flags = TN5250_RECORD_H_NONE;
+    header.opcode = TN5250_RECORD_OPCODE_PRINT_COMPLETE;
+
+    tn5250_stream_send_packet(This->stream, 0, header, NULL);
+    This->records++;
+
+    if (tn5250_record_length(This->rec) == 0x11) {
+        syslog(LOG_INFO, "Job Complete\n");
+        if (This->pipe != NULL) {
+            tn5250_print_pipe_end_job(This->pipe);
+        }
+        else {
+            pclose(This->printfile);
+            This->printfile = NULL;
+        }
+        This->jobs++;
+        This->newjob = 1;
+        return;
+    }
+
+    len = tn5250_record_length(This->rec) - This->rec->cur_pos;
+    if (This->pipe != NULL) {
+        tn5250_print_pipe_write(
+            This->pipe, tn5250_record_data(This->rec) + This->rec->cur_pos,
+            len);
+    }
+    else {
+        /* Pass the rest of the record on in one piece. */
+        fwrite(tn5250_record_data(This->rec) + This->rec->cur_pos, 1, len,
+               This->printfile);
+    }
+    tn5250_record_skip_to_end(This->rec);
+    This->bytes += len;
+    return;
+}
+
+/****f* lib5250/tn5250_print_session_set_pool
+ * NAME
+ *    tn5250_print_session_set_pool
+ * SYNOPSIS
+ *    tn5250_print_session_set_pool (This, pool);
+ * INPUTS
+ *    Tn5250PrintSession * This       -
+ *    Tn5250PrintPool *    pool       -
+ * DESCRIPTION
+ *    Convert this session's jobs on a pool shared with other sessions,
+ *    rather than on a thread of its own.  Must be called before the
+ *    session starts.  The pool must outlive the session.
+ *****/
+void tn5250_print_session_set_pool(Tn5250PrintSession* This,
+                                   Tn5250PrintPool* pool) {
+    This->pool = pool;
+    return;
+}
+
+/****f* lib5250/tn5250_print_session_set_spool_dir
+ * NAME
+ *    tn5250_print_session_set_spool_dir
+ * SYNOPSIS
+ *    tn5250_print_session_set_spool_dir (This, dir);
+ * INPUTS
+ *    Tn5250PrintSession * This       -
+ *    const char *         dir        -
+ * DESCRIPTION
+ *    Spool each job to a file in dir as it arrives, and print it once it
+ *    is complete, so that the host isn't kept waiting by a slow output
+ *    command.  See tn5250_print_pipe_new_spool.  Must be called before
+ *    the session starts.
+ *****/
+void tn5250_print_session_set_spool_dir(Tn5250PrintSession* This,
+                                        const char* dir) {
+    if (This->spool_dir != NULL) {
+        free(This->spool_dir);
+    }
+    This->spool_dir = (char*)malloc(strlen(dir) + 1);
+    if (This->spool_dir != NULL) {
+        strcpy(This->spool_dir, dir);
+    }
+    return;
+}
+
+/****f* lib5250/tn5250_print_session_queue_depth
+ * NAME
+ *    tn5250_print_session_queue_depth
+ * SYNOPSIS
+ *    n = tn5250_print_session_queue_depth (This);
+ * INPUTS
+ *    Tn5250PrintSession * This       -
+ * DESCRIPTION
+ *    Returns how many records are waiting to be converted, or spooled
+ *    jobs waiting to be printed, or 0 if the session doesn't convert in
+ *    process.
+ *****/
+int tn5250_print_session_queue_depth(Tn5250PrintSession* This) {
+    if (This->pipe == NULL) {
+        return 0;
     }
+    return tn5250_print_pipe_depth(This->pipe);
 }
 
 /****f* lib5250/tn5250_print_session_waitevent
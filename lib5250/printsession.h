@@ -37,15 +37,27 @@ extern "C" {
  *    tn5250_print_session_destroy(ps);
  * DESCRIPTION
  *    Manages a 5250e printer session and parses the data records.
+ *
+ *    The jobs, records and bytes counters are totals since the session
+ *    started; bytes counts the SCS data passed to the output command.
  *****/
 struct _Tn5250PrintSession {
     Tn5250Stream /*@null@*/ /*@owned@*/* stream;
     Tn5250Record /*@owned@*/* rec;
     int conn_fd;
     FILE /*@null@*/* printfile;
+    char /*@null@*/* printbuf; /* stdio buffer for printfile */
+    Tn5250PrintPipe /*@null@*/* pipe; /* In-process conversion, if any */
     Tn5250CharMap* map;
     char /*@null@*/* output_cmd;
     void* script_slot;
+    Tn5250PrintPool /*@null@*/* pool; /* Shared converters, if any */
+    char /*@null@*/* spool_dir;
+    int started; /* The host has accepted the session. */
+    int newjob;  /* The next record starts a job. */
+    unsigned long jobs;
+    unsigned long records;
+    unsigned long bytes;
 };
 
 typedef struct _Tn5250PrintSession Tn5250PrintSession;
@@ -62,7 +74,13 @@ extern void tn5250_print_session_set_output_command(Tn5250PrintSession* This,
                                                     const char* output_cmd);
 extern void tn5250_print_session_set_char_map(Tn5250PrintSession* This,
                                               const char* map);
+extern void tn5250_print_session_set_pool(Tn5250PrintSession* This,
+                                          Tn5250PrintPool* pool);
+extern void tn5250_print_session_set_spool_dir(Tn5250PrintSession* This,
+                                               const char* dir);
 extern void tn5250_print_session_main_loop(Tn5250PrintSession* This);
+extern int tn5250_print_session_handle_receive(Tn5250PrintSession* This);
+extern int tn5250_print_session_queue_depth(Tn5250PrintSession* This);
 
 #define tn5250_print_session_stream(This) ((This)->stream)
 
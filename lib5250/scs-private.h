@@ -55,18 +55,26 @@ void scs_sgea(Tn5250SCS* This);
 
 void scs_process2b(Tn5250SCS* This);
 void scs_processd2(Tn5250SCS* This);
-void scs_process03(unsigned char nextchar, unsigned char curchar);
-void scs_scs(int* cpi);
+void scs_process03(Tn5250SCS* This, unsigned char nextchar,
+                   unsigned char curchar);
+void scs_scs(Tn5250SCS* This, int* cpi);
 void scs_process04(Tn5250SCS* This, unsigned char nextchar,
                    unsigned char curchar);
 void scs_processd1(Tn5250SCS* This);
-void scs_process06();
+void scs_process06(Tn5250SCS* This);
 void scs_process07(Tn5250SCS* This);
 void scs_processd103(Tn5250SCS* This);
-void scs_jtf(unsigned char curchar);
-void scs_sjm(unsigned char curchar);
+void scs_jtf(Tn5250SCS* This, unsigned char curchar);
+void scs_sjm(Tn5250SCS* This, unsigned char curchar);
 void scs_processd3(Tn5250SCS* This);
 void scs_setfont(Tn5250SCS* This);
 void scs_main(Tn5250SCS* This);
 void scs_init(Tn5250SCS* This);
 void scs_default(Tn5250SCS* This);
+Tn5250CharMap* scs_char_map();
+
+/* scs2pdf printer state carried between jobs */
+void tn5250_scs2pdf_load_init(Tn5250SCS* This, FILE* initfile);
+void tn5250_scs2pdf_save_init(Tn5250SCS* This, FILE* initfile);
+void tn5250_scs2pdf_set_compress(Tn5250SCS* This, int compress);
+void tn5250_scs2pdf_set_threads(Tn5250SCS* This, int threads);
@@ -44,7 +44,7 @@
 void scs_sic(Tn5250SCS* This) {
     unsigned char curchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
 
     if (curchar != 1 && curchar != 255) {
         if (This->usesyslog) {
@@ -89,7 +89,7 @@ void scs_sea(Tn5250SCS* This) {
     int loop;
 
     for (loop = 0; loop < This->curchar - 2; loop++) {
-        exception = fgetc(stdin);
+        exception = scs_getbyte(This);
         if (exception > 4) {
             if (This->usesyslog) {
                 SCS_LOG("Invalid exception class (%d)", exception);
@@ -101,7 +101,7 @@ void scs_sea(Tn5250SCS* This) {
             fprintf(stderr, "SEA (length %x) = %d", This->curchar, exception);
 #endif
         }
-        action = fgetc(stdin);
+        action = scs_getbyte(This);
         if (action > 3) {
             if (This->usesyslog) {
                 SCS_LOG("Invalid action (exception class: %d, action %d)",
@@ -254,7 +254,7 @@ void scs_transparent(Tn5250SCS* This) {
     int bytecount;
     int loop;
 
-    bytecount = fgetc(stdin);
+    bytecount = scs_getbyte(This);
 
     if (This->usesyslog) {
         SCS_LOG("Printing %x transparent bytes", bytecount);
@@ -263,7 +263,7 @@ void scs_transparent(Tn5250SCS* This) {
     fprintf(stderr, "TRANSPARENT (%x) = ", bytecount);
 
     for (loop = 0; loop < bytecount; loop++) {
-        fprintf(stderr, "%c", fgetc(stdin));
+        fprintf(stderr, "%c", scs_getbyte(This));
     }
     return;
 }
@@ -290,14 +290,14 @@ void scs_spsu(Tn5250SCS* This) {
     unsigned char nextchar;
     int loop;
 
-    nextchar = fgetc(stdin);
-    trayparm = fgetc(stdin);
+    nextchar = scs_getbyte(This);
+    trayparm = scs_getbyte(This);
 
 #ifdef DEBUG
     fprintf(stderr, "SPSU (%x) = %x%x", This->curchar, nextchar, trayparm);
 #endif
     for (loop = 2; loop < This->curchar - 2; loop++) {
-        nextchar = fgetc(stdin);
+        nextchar = scs_getbyte(This);
 #ifdef DEBUG
         fprintf(stderr, " %x", nextchar);
 #endif
@@ -358,9 +358,9 @@ void scs_ppm(Tn5250SCS* This) {
     fprintf(stderr, "Begin Page Presentation Media (PPM)\n");
     fprintf(stderr, "Length of PPM parameters: %d\n", This->curchar);
 #endif
-    nextchar = fgetc(stdin);
-    nextchar = fgetc(stdin);
-    formscontrol = fgetc(stdin);
+    nextchar = scs_getbyte(This);
+    nextchar = scs_getbyte(This);
+    formscontrol = scs_getbyte(This);
 
     if (This->usesyslog) {
         SCS_LOG("Forms control = %x", formscontrol);
@@ -371,7 +371,7 @@ void scs_ppm(Tn5250SCS* This) {
 #endif
 
     if (This->curchar > 5) {
-        sourcedrawer = fgetc(stdin);
+        sourcedrawer = scs_getbyte(This);
 
         if (This->usesyslog) {
             SCS_LOG("Source drawer = %x", sourcedrawer);
@@ -381,7 +381,7 @@ void scs_ppm(Tn5250SCS* This) {
 #endif
     }
     if (This->curchar > 6) {
-        destdraweroffset = fgetc(stdin);
+        destdraweroffset = scs_getbyte(This);
 
         if (This->usesyslog) {
             SCS_LOG("Destination drawer offset = %x", destdraweroffset);
@@ -391,7 +391,7 @@ void scs_ppm(Tn5250SCS* This) {
 #endif
     }
     if (This->curchar > 7) {
-        destdrawer = fgetc(stdin);
+        destdrawer = scs_getbyte(This);
 
         if (This->usesyslog) {
             SCS_LOG("Destination drawer = %x", destdrawer);
@@ -401,7 +401,7 @@ void scs_ppm(Tn5250SCS* This) {
 #endif
     }
     if (This->curchar > 8) {
-        quality = fgetc(stdin);
+        quality = scs_getbyte(This);
 
         if (This->usesyslog) {
             SCS_LOG("Quality = %x", quality);
@@ -411,7 +411,7 @@ void scs_ppm(Tn5250SCS* This) {
 #endif
     }
     if (This->curchar > 9) {
-        duplex = fgetc(stdin);
+        duplex = scs_getbyte(This);
 
         if (This->usesyslog) {
             SCS_LOG("Duplex = %x", duplex);
@@ -449,12 +449,12 @@ void scs_ppm(Tn5250SCS* This) {
 void scs_spps(Tn5250SCS* This) {
     int width, length;
 
-    width = fgetc(stdin);
-    width = (width << 8) + fgetc(stdin);
+    width = scs_getbyte(This);
+    width = (width << 8) + scs_getbyte(This);
     This->pagewidth = width;
 
-    length = fgetc(stdin);
-    length = (length << 8) + fgetc(stdin);
+    length = scs_getbyte(This);
+    length = (length << 8) + scs_getbyte(This);
     This->pagelength = length;
 
     if (This->usesyslog) {
@@ -491,10 +491,10 @@ void scs_shf(Tn5250SCS* This) {
     int length;
     int shf1 = 0;
 
-    length = fgetc(stdin);
+    length = scs_getbyte(This);
 
     if (length > 0) {
-        shf1 = fgetc(stdin);
+        shf1 = scs_getbyte(This);
     }
 
     if (shf1 != 0) {
@@ -530,10 +530,10 @@ void scs_svf(Tn5250SCS* This) {
     int length;
     int svf1 = 0;
 
-    length = fgetc(stdin);
+    length = scs_getbyte(This);
 
     if (length > 0) {
-        svf1 = fgetc(stdin);
+        svf1 = scs_getbyte(This);
     }
 
     if (svf1 != 0) {
@@ -611,10 +611,10 @@ void scs_sto(Tn5250SCS* This) {
 #ifdef DEBUG
     fprintf(stderr, "STO = ");
 #endif
-    charrot1 = fgetc(stdin);
-    charrot2 = fgetc(stdin);
-    pagerot1 = fgetc(stdin);
-    pagerot2 = fgetc(stdin);
+    charrot1 = scs_getbyte(This);
+    charrot2 = scs_getbyte(This);
+    pagerot1 = scs_getbyte(This);
+    pagerot2 = scs_getbyte(This);
 #ifdef DEBUG
     fprintf(stderr, "%x%x %x%x", charrot1, charrot2, pagerot1, pagerot2);
 #endif
@@ -704,8 +704,8 @@ void scs_sto(Tn5250SCS* This) {
 void scs_shm(Tn5250SCS* This) {
     int left, right;
 
-    left = fgetc(stdin);
-    left = (left << 8) + fgetc(stdin);
+    left = scs_getbyte(This);
+    left = (left << 8) + scs_getbyte(This);
     This->leftmargin = left;
 
     if (This->usesyslog) {
@@ -715,8 +715,8 @@ void scs_shm(Tn5250SCS* This) {
     fprintf(stderr, "SHM = %d", left);
 #endif
     if (This->curchar > 5) {
-        right = fgetc(stdin);
-        right = (right << 8) + fgetc(stdin);
+        right = scs_getbyte(This);
+        right = (right << 8) + scs_getbyte(This);
         This->rightmargin = right;
 
         if (This->usesyslog) {
@@ -749,8 +749,8 @@ void scs_shm(Tn5250SCS* This) {
 void scs_svm(Tn5250SCS* This) {
     int top, bottom;
 
-    top = fgetc(stdin);
-    top = (top << 8) + fgetc(stdin);
+    top = scs_getbyte(This);
+    top = (top << 8) + scs_getbyte(This);
     This->topmargin = top;
 
     if (This->usesyslog) {
@@ -760,8 +760,8 @@ void scs_svm(Tn5250SCS* This) {
     fprintf(stderr, "SVM = %d", top);
 #endif
     if (This->curchar > 5) {
-        bottom = fgetc(stdin);
-        bottom = (bottom << 8) + fgetc(stdin);
+        bottom = scs_getbyte(This);
+        bottom = (bottom << 8) + scs_getbyte(This);
         This->bottommargin = bottom;
 
         if (This->usesyslog) {
@@ -793,7 +793,7 @@ void scs_svm(Tn5250SCS* This) {
 void scs_sffc(Tn5250SCS* This) {
     unsigned char nextchar;
 
-    nextchar = fgetc(stdin);
+    nextchar = scs_getbyte(This);
 
     if (This->usesyslog) {
         SCS_LOG("SFFC set %x form feeds", nextchar);
@@ -817,7 +817,7 @@ void scs_sffc(Tn5250SCS* This) {
 void scs_scgl(Tn5250SCS* This) {
     unsigned char nextchar;
 
-    nextchar = fgetc(stdin);
+    nextchar = scs_getbyte(This);
 
     if (This->usesyslog) {
         SCS_LOG("SCGL = %x", nextchar);
@@ -844,8 +844,8 @@ void scs_scg(Tn5250SCS* This) {
     unsigned char gcgid;
     unsigned char cpgid;
 
-    gcgid = fgetc(stdin);
-    cpgid = fgetc(stdin);
+    gcgid = scs_getbyte(This);
+    cpgid = scs_getbyte(This);
 
     if (This->usesyslog) {
         SCS_LOG("SCG set GCGID = %x, CPGID = %x", gcgid, cpgid);
@@ -866,15 +866,15 @@ void scs_sfg(Tn5250SCS* This) {
     int fontwidth;
     unsigned char fontattribute;
 
-    globalfontid1 = fgetc(stdin);
-    globalfontid2 = fgetc(stdin);
+    globalfontid1 = scs_getbyte(This);
+    globalfontid2 = scs_getbyte(This);
 
     if (This->usesyslog) {
         SCS_LOG("SFG set global font ID %x%x", globalfontid1, globalfontid2);
     }
 
-    fontwidth = fgetc(stdin);
-    fontwidth = (fontwidth << 8) + fgetc(stdin);
+    fontwidth = scs_getbyte(This);
+    fontwidth = (fontwidth << 8) + scs_getbyte(This);
     This->charwidth = fontwidth;
     This->cpi = 1440 / fontwidth;
 
@@ -884,7 +884,7 @@ void scs_sfg(Tn5250SCS* This) {
     }
 
     This->setfont(This);
-    fontattribute = fgetc(stdin);
+    fontattribute = scs_getbyte(This);
 
     switch (fontattribute) {
     case 0x01: {
@@ -933,8 +933,8 @@ void scs_scd(Tn5250SCS* This) {
     unsigned char chardist2;
     int changefont = 0;
 
-    chardist1 = fgetc(stdin);
-    chardist2 = fgetc(stdin);
+    chardist1 = scs_getbyte(This);
+    chardist2 = scs_getbyte(This);
 #ifdef DEBUG
     fprintf(stderr, "SCD = %x%x", chardist1, chardist2);
 #endif
@@ -1015,7 +1015,7 @@ void scs_scd(Tn5250SCS* This) {
 void scs_pp(Tn5250SCS* This) {
     unsigned char curchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
 
     switch (curchar) {
     case SCS_RDPP: {
@@ -1046,7 +1046,7 @@ void scs_pp(Tn5250SCS* This) {
 void scs_rdpp(Tn5250SCS* This) {
     int rdpp;
 
-    rdpp = fgetc(stdin);
+    rdpp = scs_getbyte(This);
 
     if ((This->usesyslog) && (This->loglevel > 0)) {
         SCS_LOG("PP sent relative move down of %d", rdpp);
@@ -1064,7 +1064,7 @@ void scs_rdpp(Tn5250SCS* This) {
 void scs_ahpp(Tn5250SCS* This) {
     int position;
 
-    position = fgetc(stdin);
+    position = scs_getbyte(This);
 
     if ((This->usesyslog) && (This->loglevel > 0)) {
         SCS_LOG("PP sent absolute horizontal move of %d (cursor currently on "
@@ -1095,7 +1095,7 @@ void scs_ahpp(Tn5250SCS* This) {
 void scs_avpp(Tn5250SCS* This) {
     int newrow;
 
-    newrow = fgetc(stdin);
+    newrow = scs_getbyte(This);
 
     if ((This->usesyslog) && (This->loglevel > 0)) {
         SCS_LOG(
@@ -1137,7 +1137,7 @@ void scs_avpp(Tn5250SCS* This) {
 void scs_rrpp(Tn5250SCS* This) {
     int newcol;
 
-    newcol = fgetc(stdin);
+    newcol = scs_getbyte(This);
 
     if ((This->usesyslog) && (This->loglevel > 0)) {
         SCS_LOG("PP sent relative horizontal move of %d", newcol);
@@ -1245,7 +1245,7 @@ void scs_stab(Tn5250SCS* This) {
     fprintf(stderr, "STAB = ");
 #endif
     for (loop = 0; loop < This->curchar - 2; loop++) {
-        nextchar = fgetc(stdin);
+        nextchar = scs_getbyte(This);
 #ifdef DEBUG
         fprintf(stderr, " %x", nextchar);
 #endif
@@ -1292,7 +1292,7 @@ void scs_sil(Tn5250SCS* This) {
         SCS_LOG("Setting indent level");
     }
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
 #ifdef DEBUG
     fprintf(stderr, "SIL = %d", curchar);
 #endif
@@ -1332,7 +1332,7 @@ void scs_cr(Tn5250SCS* This) {
 void scs_process2b(Tn5250SCS* This) {
     unsigned char curchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
     switch (curchar) {
     case 0xD1: {
         scs_processd1(This);
@@ -1373,9 +1373,9 @@ void scs_processd3(Tn5250SCS* This) {
     unsigned char curchar;
     unsigned char nextchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
     This->curchar = curchar;
-    nextchar = fgetc(stdin);
+    nextchar = scs_getbyte(This);
 
     if (nextchar == 0xF6) {
         scs_sto(This);
@@ -1389,9 +1389,9 @@ void scs_processd3(Tn5250SCS* This) {
 void scs_sgea(Tn5250SCS* This) {
     unsigned char sgea1, sgea2, sgea3;
 
-    sgea1 = fgetc(stdin);
-    sgea2 = fgetc(stdin);
-    sgea3 = fgetc(stdin);
+    sgea1 = scs_getbyte(This);
+    sgea2 = scs_getbyte(This);
+    sgea3 = scs_getbyte(This);
 #ifdef DEBUG
     fprintf(stderr, "SGEA = %x %x %x\n", sgea1, sgea2, sgea3);
 #endif
@@ -1401,10 +1401,10 @@ void scs_sgea(Tn5250SCS* This) {
 void scs_processd1(Tn5250SCS* This) {
     unsigned char curchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
     switch (curchar) {
     case 0x06: {
-        scs_process06();
+        scs_process06(This);
         break;
     }
     case 0x07: {
@@ -1422,12 +1422,12 @@ void scs_processd1(Tn5250SCS* This) {
     return;
 }
 
-void scs_process06() {
+void scs_process06(Tn5250SCS* This) {
     unsigned char curchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
     if (curchar == 0x01) {
-        scs_scg(NULL);
+        scs_scg(This);
     }
     else {
         fprintf(stderr, "ERROR: Unknown 0x2BD106 command %x\n", curchar);
@@ -1438,7 +1438,7 @@ void scs_process06() {
 void scs_process07(Tn5250SCS* This) {
     unsigned char curchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
     if (curchar == 0x05) {
         scs_sfg(This);
     }
@@ -1451,7 +1451,7 @@ void scs_process07(Tn5250SCS* This) {
 void scs_processd103(Tn5250SCS* This) {
     unsigned char curchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
     switch (curchar) {
     case 0x81: {
         scs_scgl(This);
@@ -1473,9 +1473,9 @@ void scs_processd2(Tn5250SCS* This) {
     unsigned char curchar;
     unsigned char nextchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
     This->curchar = curchar;
-    nextchar = fgetc(stdin);
+    nextchar = scs_getbyte(This);
 
     switch (nextchar) {
     case 0x01: {
@@ -1483,7 +1483,7 @@ void scs_processd2(Tn5250SCS* This) {
         break;
     }
     case 0x03: {
-        scs_jtf(This->curchar);
+        scs_jtf(This, This->curchar);
         break;
     }
     case 0x0A: {
@@ -1491,7 +1491,7 @@ void scs_processd2(Tn5250SCS* This) {
         break;
     }
     case 0x0D: {
-        scs_sjm(This->curchar);
+        scs_sjm(This, This->curchar);
         break;
     }
     case 0x2A: {
@@ -1529,7 +1529,7 @@ void scs_processd2(Tn5250SCS* This) {
     default: {
         switch (curchar) {
         case 0x03: {
-            scs_process03(nextchar, curchar);
+            scs_process03(This, nextchar, curchar);
             break;
         }
         case 0x04: {
@@ -1545,7 +1545,7 @@ void scs_processd2(Tn5250SCS* This) {
     return;
 }
 
-void scs_jtf(unsigned char curchar) {
+void scs_jtf(Tn5250SCS* This, unsigned char curchar) {
     unsigned char nextchar;
     int loop;
 
@@ -1554,7 +1554,7 @@ void scs_jtf(unsigned char curchar) {
 #endif
 
     for (loop = 0; loop < curchar - 2; loop++) {
-        nextchar = fgetc(stdin);
+        nextchar = scs_getbyte(This);
 #ifdef DEBUG
         fprintf(stderr, " %x", nextchar);
 #endif
@@ -1565,7 +1565,7 @@ void scs_jtf(unsigned char curchar) {
     return;
 }
 
-void scs_sjm(unsigned char curchar) {
+void scs_sjm(Tn5250SCS* This, unsigned char curchar) {
     unsigned char nextchar;
     int loop;
 
@@ -1574,7 +1574,7 @@ void scs_sjm(unsigned char curchar) {
 #endif
 
     for (loop = 0; loop < curchar - 2; loop++) {
-        nextchar = fgetc(stdin);
+        nextchar = scs_getbyte(This);
 #ifdef DEBUG
         fprintf(stderr, " %x", nextchar);
 #endif
@@ -1585,18 +1585,19 @@ void scs_sjm(unsigned char curchar) {
     return;
 }
 
-void scs_process03(unsigned char nextchar, unsigned char curchar) {
+void scs_process03(Tn5250SCS* This, unsigned char nextchar,
+                   unsigned char curchar) {
     switch (nextchar) {
     case 0x45: {
-        scs_sic(NULL);
+        scs_sic(This);
         break;
     }
     case 0x07: {
-        scs_sil(NULL);
+        scs_sil(This);
         break;
     }
     case 0x09: {
-        scs_sls(NULL);
+        scs_sls(This);
         break;
     }
     default: {
@@ -1609,7 +1610,7 @@ void scs_process03(unsigned char nextchar, unsigned char curchar) {
 void scs_sls(Tn5250SCS* This) {
     unsigned char curchar;
 
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
 #ifdef DEBUG
     fprintf(stderr, "SLS = %d\n", curchar);
 #endif
@@ -1625,7 +1626,7 @@ void scs_process04(Tn5250SCS* This, unsigned char nextchar,
     }
     case 0x29: {
         This->scd(This);
-        /*scs_scs (cpi); */
+        /*scs_scs (This, cpi); */
         break;
     }
     default: {
@@ -1638,8 +1639,8 @@ void scs_process04(Tn5250SCS* This, unsigned char nextchar,
 void scs_ssld(Tn5250SCS* This) {
     int distance;
 
-    distance = fgetc(stdin);
-    distance = (distance << 8) + fgetc(stdin);
+    distance = scs_getbyte(This);
+    distance = (distance << 8) + scs_getbyte(This);
 
     if (distance > 0) {
         This->lpi = 1440 / distance;
@@ -1658,10 +1659,10 @@ void scs_sld(Tn5250SCS* This) {
     int length;
     int density = 0;
 
-    length = fgetc(stdin);
+    length = scs_getbyte(This);
 
     if (length > 0) {
-        density = fgetc(stdin);
+        density = scs_getbyte(This);
     }
     else {
         density = 12;
@@ -1687,13 +1688,13 @@ void scs_sld(Tn5250SCS* This) {
 void scs_setfont(Tn5250SCS* This) { return; }
 
 /* This function is obsolete - scs_scd() should be used */
-void scs_scs(int* cpi) {
+void scs_scs(Tn5250SCS* This, int* cpi) {
     unsigned char curchar;
 
     fprintf(stderr, "scs_scs was called but is obsolete!!!\n");
-    curchar = fgetc(stdin);
+    curchar = scs_getbyte(This);
     if (curchar == 0x00) {
-        curchar = fgetc(stdin);
+        curchar = scs_getbyte(This);
 
         /* Here we convert characters per inch (CPI) to point size.  In the
          * future we will probably want these to be user definable.
@@ -1747,105 +1748,249 @@ void scs_scs(int* cpi) {
 }
 
 void scs_default(Tn5250SCS* This) {
-    printf("%c", This->curchar);
+    putc(This->curchar, This->output);
     return;
 }
 
-/* scs_main - reads the scs stream and calls functions to handle events
+/* scs_char_map - the character map the converters translate with.  lp5250d
+ * passes its map= setting on in TN5250_CCSIDMAP.
  */
-void scs_main(Tn5250SCS* This) {
-    int curchar;
+Tn5250CharMap* scs_char_map() {
+    if ((getenv("TN5250_CCSIDMAP")) != NULL) {
+        return tn5250_char_map_new(getenv("TN5250_CCSIDMAP"));
+    }
+    return tn5250_char_map_new("37");
+}
 
-    while ((curchar = fgetc(stdin)) != EOF) {
-        This->curchar = curchar;
-#ifdef DEBUG
-        fprintf(stderr, "%x ", This->curchar);
-#endif
-        switch (This->curchar) {
-        case SCS_TRANSPARENT: {
-#ifdef DEBUG
-            fprintf(stderr, "doing TRANSPARENT\n");
-#endif
-            This->transparent(This);
-            break;
-        }
-        case SCS_NOOP: {
-#ifdef DEBUG
-            fprintf(stderr, "doing NOOP\n");
-#endif
-            This->noop(This);
-            break;
-        }
-        case SCS_CR: {
-#ifdef DEBUG
-            fprintf(stderr, "doing CR\n");
-#endif
-            This->cr(This);
-            break;
+/* scs_unhandled - the host sometimes sends 0xFF, which we don't know what
+ * to do with.
+ */
+static void scs_unhandled(Tn5250SCS* This) {
+    /* This is a hack */
+    /* Don't know where the 0xFF is coming from */
+    fprintf(stderr, "Unhandled op 0xFF\n");
+    return;
+}
+
+/* scs_command_length - returns how many bytes the command at the start of
+ * cmd takes, parameters included, or 0 if more than the avail bytes we
+ * have are needed to tell.  This has to agree with what the handlers read:
+ * a handler which reads past the end of its command gets EOF, and one
+ * which reads less leaves the rest to be taken for more commands.
+ */
+static int scs_command_length(const unsigned char* cmd, int avail) {
+    int len;
+
+    switch (cmd[0]) {
+    case SCS_TRANSPARENT: {
+        return avail < 2 ? 0 : 2 + cmd[1];
+    }
+    case SCS_PP: {
+        if (avail < 2) {
+            return 0;
         }
-        case SCS_FF: {
-#ifdef DEBUG
-            fprintf(stderr, "doing FF\n");
-#endif
-            This->ff(This);
-            break;
+        switch (cmd[1]) {
+        case SCS_RDPP:
+        case SCS_AHPP:
+        case SCS_AVPP:
+        case SCS_RRPP:
+            return 3;
         }
-        case SCS_RFF: {
-#ifdef DEBUG
-            fprintf(stderr, "doing RFF\n");
-#endif
-            This->rff(This);
-            break;
+        return 2;
+    }
+    case 0x2B: {
+        break;
+    }
+    default: {
+        return 1;
+    }
+    }
+
+    /* 0x2B classes.  Most of these carry their length in the byte after
+     * the class, which scs_processd2 () and friends leave in curchar. */
+    if (avail < 2) {
+        return 0;
+    }
+    switch (cmd[1]) {
+    case 0xC1: /* SHF */
+    case 0xC2: /* SVF */
+    case 0xC6: /* SLD */
+        if (avail < 3) {
+            return 0;
         }
-        case SCS_NL: {
-#ifdef DEBUG
-            fprintf(stderr, "doing NL\n");
-#endif
-            This->nl(This);
-            break;
+        return cmd[2] > 0 ? 4 : 3;
+    case 0xC8: /* SGEA */
+        return 5;
+    case 0xD1:
+        if (avail < 3) {
+            return 0;
         }
-        case SCS_RNL: {
-#ifdef DEBUG
-            fprintf(stderr, "doing RNL\n");
-#endif
-            This->rnl(This);
-            break;
+        if (cmd[2] != 0x03 && cmd[2] != 0x06 && cmd[2] != 0x07) {
+            return 3;
         }
-        case SCS_HT: {
-#ifdef DEBUG
-            fprintf(stderr, "doing HT\n");
-#endif
-            This->ht(This);
-            break;
+        if (avail < 4) {
+            return 0;
         }
-        case SCS_PP: {
-#ifdef DEBUG
-            fprintf(stderr, "doing PP\n");
-#endif
-            This->pp(This);
-            break;
+        switch (cmd[2]) {
+        case 0x06: /* SCG */
+            return cmd[3] == 0x01 ? 6 : 4;
+        case 0x07: /* SFG */
+            return cmd[3] == 0x05 ? 9 : 4;
+        case 0x03: /* SCGL, SFFC */
+            return (cmd[3] == 0x81 || cmd[3] == 0x87) ? 5 : 4;
         }
-        case 0x2B: {
-#ifdef DEBUG
-            fprintf(stderr, "doing 2B\n");
-#endif
-            This->process2b(This);
-            break;
+        return 3;
+    case 0xD3:
+        if (avail < 4) {
+            return 0;
         }
-        case 0xFF: {
-            /* This is a hack */
-            /* Don't know where the 0xFF is coming from */
-            fprintf(stderr, "Unhandled op 0xFF\n");
-            break;
-        }
-        default: {
+        return cmd[3] == 0xF6 ? 8 : 4; /* STO */
+    case 0xD2: {
+        break;
+    }
+    default: {
+        return 2;
+    }
+    }
+
+    if (avail < 4) {
+        return 0;
+    }
+    len = cmd[2];
+    switch (cmd[3]) {
+    case 0x01: /* STAB */
+    case 0x03: /* JTF */
+    case 0x0D: /* SJM */
+        return 4 + (len > 2 ? len - 2 : 0);
+    case 0x0A: /* RPT */
+    case 0x2A: /* SW */
+    case 0x2F: /* BEL */
+        return 4;
+    case 0x40: /* SPPS */
+        return 8;
+    case 0x48: /* PPM */
+        return 7 + (len > 5) + (len > 6) + (len > 7) + (len > 8) + (len > 9);
+    case 0x11: /* SHM */
+    case 0x49: /* SVM */
+        return len > 5 ? 8 : 6;
+    case 0x4C: /* SPSU */
+        return 6 + (len > 4 ? len - 4 : 0);
+    case 0x85: /* SEA */
+        return 4 + (len > 2 ? (len - 1) / 2 * 2 : 0);
+    }
+    if (len == 0x03) {
+        /* SIC, SIL, SLS */
+        return (cmd[3] == 0x45 || cmd[3] == 0x07 || cmd[3] == 0x09) ? 5 : 4;
+    }
+    if (len == 0x04) {
+        /* SSLD, SCD */
+        return (cmd[3] == 0x15 || cmd[3] == 0x29) ? 6 : 4;
+    }
+    return 4;
+}
+
+/* scs_dispatch - hands one complete command to its handler.
+ */
+static void scs_dispatch(Tn5250SCS* This, const unsigned char* cmd, int len) {
+    This->cmd = cmd;
+    This->cmd_len = len;
+    This->cmd_pos = 1;
+    This->curchar = cmd[0];
 #ifdef DEBUG
-            fprintf(stderr, "doing scsdefault()\n");
+    fprintf(stderr, "%x ", This->curchar);
 #endif
-            This->scsdefault(This);
-            break;
+    This->ops[cmd[0]](This);
+    return;
+}
+
+/* tn5250_scs_begin - gets ready to convert a document, and starts it.
+ * The opcode table is built here rather than in tn5250_scs_new (), so
+ * that it picks up the callbacks a converter has put in place.
+ */
+void tn5250_scs_begin(Tn5250SCS* This) {
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        This->ops[i] = This->scsdefault;
+    }
+    This->ops[SCS_TRANSPARENT] = This->transparent;
+    This->ops[SCS_NOOP] = This->noop;
+    This->ops[SCS_CR] = This->cr;
+    This->ops[SCS_FF] = This->ff;
+    This->ops[SCS_RFF] = This->rff;
+    This->ops[SCS_NL] = This->nl;
+    This->ops[SCS_RNL] = This->rnl;
+    This->ops[SCS_HT] = This->ht;
+    This->ops[SCS_PP] = This->pp;
+    This->ops[0x2B] = This->process2b;
+    This->ops[0xFF] = scs_unhandled;
+
+    This->cmd = NULL;
+    This->cmd_len = 0;
+    This->cmd_pos = 0;
+    This->pending_len = 0;
+
+    if (This->jobstart != NULL) {
+        This->jobstart(This);
+    }
+    return;
+}
+
+/* tn5250_scs_feed - converts the next len bytes of the document.  The data
+ * can be split anywhere, even in the middle of a command: whatever is left
+ * of a command at the end of one call is kept until the next.  Commands
+ * which are all there are handled straight out of the caller's buffer.
+ */
+void tn5250_scs_feed(Tn5250SCS* This, const unsigned char* data, int len) {
+    int need;
+
+    while (This->pending_len > 0 && len > 0) {
+        This->pending[This->pending_len++] = *data++;
+        len--;
+        need = scs_command_length(This->pending, This->pending_len);
+        if (need != 0 && need <= This->pending_len) {
+            This->pending_len = 0;
+            scs_dispatch(This, This->pending, need);
         }
+    }
+
+    while (len > 0) {
+        need = scs_command_length(data, len);
+        if (need == 0 || need > len) {
+            memcpy(This->pending, data, len);
+            This->pending_len = len;
+            return;
         }
+        scs_dispatch(This, data, need);
+        data += need;
+        len -= need;
+    }
+    return;
+}
+
+/* tn5250_scs_end - finishes the document.  A command cut short by the end
+ * of the data is still handed over, and reads EOF for what is missing.
+ */
+void tn5250_scs_end(Tn5250SCS* This) {
+    if (This->pending_len > 0) {
+        scs_dispatch(This, This->pending, This->pending_len);
+        This->pending_len = 0;
+    }
+    if (This->jobend != NULL) {
+        This->jobend(This);
+    }
+    fflush(This->output);
+    return;
+}
+
+/* scs_main - reads the scs stream from This->source and converts it.
+ */
+void scs_main(Tn5250SCS* This) {
+    unsigned char buf[8192];
+    size_t len;
+
+    while ((len = fread(buf, 1, sizeof(buf), This->source)) > 0) {
+        tn5250_scs_feed(This, buf, (int)len);
     }
     return;
 }
@@ -1918,5 +2063,55 @@ Tn5250SCS* tn5250_scs_new() {
     scs->loglevel = 0;
     scs->curchar = 0;
     scs->data = NULL;
+    scs->source = stdin;
+    scs->output = stdout;
+    scs->map = NULL;
+    scs->jobstart = NULL;
+    scs->jobend = NULL;
+    scs->destroy = NULL;
     return scs;
 }
+
+/* tn5250_scs_destroy - frees a converter along with its private data and
+ * character map.  The input and output streams are left alone.
+ */
+void tn5250_scs_destroy(Tn5250SCS* This) {
+    if (This->destroy != NULL) {
+        This->destroy(This);
+    }
+    if (This->data != NULL) {
+        free(This->data);
+    }
+    if (This->map != NULL) {
+        tn5250_char_map_destroy(This->map);
+    }
+    free(This);
+    return;
+}
+
+/* tn5250_scs_convert - converts the document in This->source to
+ * This->output.
+ */
+void tn5250_scs_convert(Tn5250SCS* This) {
+    tn5250_scs_begin(This);
+    scs_main(This);
+    tn5250_scs_end(This);
+    return;
+}
+
+/* tn5250_scs_converter_new - creates one of the converters by the name of
+ * the program which wraps it: scs2ascii, scs2ps or scs2pdf.  Returns NULL
+ * for any other name.
+ */
+Tn5250SCS* tn5250_scs_converter_new(const char* name) {
+    if (strcmp(name, "scs2ascii") == 0) {
+        return tn5250_scs2ascii_new();
+    }
+    if (strcmp(name, "scs2ps") == 0) {
+        return tn5250_scs2ps_new();
+    }
+    if (strcmp(name, "scs2pdf") == 0) {
+        return tn5250_scs2pdf_new();
+    }
+    return NULL;
+}
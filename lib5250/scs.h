@@ -55,6 +55,10 @@
 #define SCS_ROTATE180 2
 #define SCS_ROTATE270 3
 
+/* The longest command we may have to hold on to between two calls to
+ * tn5250_scs_feed (): SEA with a length byte of 255. */
+#define SCS_MAX_COMMAND 512
+
 /* Logging levels */
 #define SCS_LOG_BASIC  0
 #define SCS_LOG_DETAIL 1
@@ -67,6 +71,18 @@
 struct _Tn5250SCS {
     struct _Tn5250SCSPrivate* data;
 
+    /* Where scs_main () reads the SCS stream from, stdin by default, and
+     * where the converted output goes. */
+    FILE* source;
+    FILE* output;
+    Tn5250CharMap* map;
+
+    /* Called around scs_main () by tn5250_scs_convert (), and by
+     * tn5250_scs_destroy () to free the converter's private data. */
+    void (*jobstart)(struct _Tn5250SCS* This);
+    void (*jobend)(struct _Tn5250SCS* This);
+    void (*destroy)(struct _Tn5250SCS* This);
+
     void (*sic)(struct _Tn5250SCS* This);
     void (*sea)(struct _Tn5250SCS* This);
     void (*noop)(struct _Tn5250SCS* This);
@@ -126,8 +142,34 @@ struct _Tn5250SCS {
     int usesyslog;
     int loglevel;
     unsigned char curchar;
+
+    /* Parser state.  ops is the handler for each opcode, filled in from
+     * the callbacks above by tn5250_scs_begin ().  cmd is the command
+     * being handled, which scs_getbyte () reads; pending holds the start
+     * of a command which was cut off at the end of the data. */
+    void (*ops[256])(struct _Tn5250SCS* This);
+    const unsigned char* cmd;
+    int cmd_len;
+    int cmd_pos;
+    unsigned char pending[SCS_MAX_COMMAND];
+    int pending_len;
 };
 
 typedef struct _Tn5250SCS Tn5250SCS;
 
+/* The next parameter byte of the current command, or EOF if the data
+ * ended in the middle of it. */
+#define scs_getbyte(This)                                                      \
+    ((This)->cmd_pos < (This)->cmd_len ? (int)(This)->cmd[(This)->cmd_pos++]  \
+                                        : EOF)
+
 Tn5250SCS* tn5250_scs_new();
+void tn5250_scs_destroy(Tn5250SCS* This);
+void tn5250_scs_begin(Tn5250SCS* This);
+void tn5250_scs_feed(Tn5250SCS* This, const unsigned char* data, int len);
+void tn5250_scs_end(Tn5250SCS* This);
+void tn5250_scs_convert(Tn5250SCS* This);
+Tn5250SCS* tn5250_scs_converter_new(const char* name);
+Tn5250SCS* tn5250_scs2ascii_new();
+Tn5250SCS* tn5250_scs2ps_new();
+Tn5250SCS* tn5250_scs2pdf_new();
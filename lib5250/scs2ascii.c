@@ -0,0 +1,248 @@
+/* TN5250 - An implementation of the 5250 telnet protocol.
+ * Copyright (C) 1997-2008 Michael Madore
+ *
+ * This file is part of TN5250.
+ *
+ * TN5250 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1, or (at your option)
+ * any later version.
+ *
+ * TN5250 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "tn5250-private.h"
+#include "scs-private.h"
+
+/*
+#define DEBUG
+*/
+
+static void scs2ascii_pp(Tn5250SCS* This);
+static void scs2ascii_ahpp(Tn5250SCS* This);
+static void scs2ascii_rdpp(Tn5250SCS* This);
+static void scs2ascii_rrpp(Tn5250SCS* This);
+static void scs2ascii_avpp(Tn5250SCS* This);
+static void scs2ascii_transparent(Tn5250SCS* This);
+static void scs2ascii_ff(Tn5250SCS* This);
+static void scs2ascii_nl(Tn5250SCS* This);
+static void scs2ascii_default(Tn5250SCS* This);
+
+/* This initializes the scs callbacks
+ */
+Tn5250SCS* tn5250_scs2ascii_new() {
+    Tn5250SCS* scs = tn5250_scs_new();
+
+    if (scs == NULL) {
+        fprintf(stderr,
+                "Unable to allocate memory in tn5250_scs2ascii_new ()!\n");
+        return NULL;
+    }
+
+    scs->map = scs_char_map();
+
+    /* And now set up our callbacks */
+    scs->transparent = scs2ascii_transparent;
+    scs->ff = scs2ascii_ff;
+    scs->rff = scs2ascii_ff;
+    scs->nl = scs2ascii_nl;
+    scs->rnl = scs2ascii_nl;
+    scs->pp = scs2ascii_pp;
+    scs->avpp = scs2ascii_avpp;
+    scs->scsdefault = scs2ascii_default;
+    return scs;
+}
+
+static void scs2ascii_default(Tn5250SCS* This) {
+#ifdef DEBUG
+#ifdef VERBOSE
+    fprintf(stderr, "doing scs2ascii_default()\n");
+#endif
+#endif
+    putc(tn5250_char_map_to_local(This->map, This->curchar), This->output);
+    This->column++;
+#ifdef DEBUG
+#ifdef VERBOSE
+    fprintf(stderr, "%c (%x)\n",
+            tn5250_char_map_to_local(This->map, This->curchar), This->curchar);
+#endif
+#endif
+    return;
+}
+
+static void scs2ascii_ff(Tn5250SCS* This) {
+#ifdef DEBUG
+#ifdef VERBOSE
+    fprintf(stderr, "doing scs2ascii_ff()\n");
+#endif
+#endif
+    scs_ff(This);
+    putc('\f', This->output);
+    return;
+}
+
+static void scs2ascii_nl(Tn5250SCS* This) {
+#ifdef DEBUG
+#ifdef VERBOSE
+    fprintf(stderr, "doing scs2ascii_nl()\n");
+#endif
+#endif
+    scs_nl(This);
+    putc('\n', This->output);
+    return;
+}
+
+static void scs2ascii_pp(Tn5250SCS* This) {
+    unsigned char curchar;
+
+#ifdef DEBUG
+#ifdef VERBOSE
+    fprintf(stderr, "doing scs2ascii_pp()\n");
+#endif
+#endif
+    curchar = scs_getbyte(This);
+    switch (curchar) {
+    case SCS_AVPP: {
+        This->avpp(This);
+        break;
+    }
+    case SCS_AHPP: {
+        scs2ascii_ahpp(This);
+        break;
+    }
+    case SCS_RDPP: {
+        scs2ascii_rdpp(This);
+        break;
+    }
+    case SCS_RRPP: {
+        scs2ascii_rrpp(This);
+        break;
+    }
+    default: {
+        fprintf(stderr, "ERROR: Unknown 0x34 command %x\n", curchar);
+    }
+    }
+}
+
+static void scs2ascii_avpp(Tn5250SCS* This) {
+    int i;
+    int newrow;
+    int lines;
+
+#ifdef DEBUG
+#ifdef VERBOSE
+    fprintf(stderr, "doing scs2ascii_avpp()\n");
+#endif
+#endif
+    newrow = scs_getbyte(This);
+#ifdef DEBUG
+    fprintf(stderr, "AVPP %d\n", newrow);
+#endif
+
+    if (newrow < This->row) {
+        putc('\f', This->output);
+        This->row = 1;
+    }
+    else {
+        lines = newrow - This->row;
+
+        for (i = 0; i < lines; i++) {
+            putc('\n', This->output);
+        }
+
+        This->row = newrow;
+    }
+    return;
+}
+
+static void scs2ascii_ahpp(Tn5250SCS* This) {
+    int position;
+    int loop;
+
+#ifdef DEBUG
+#ifdef VERBOSE
+    fprintf(stderr, "doing scs2ascii_ahpp()\n");
+#endif
+#endif
+    position = scs_getbyte(This);
+#ifdef DEBUG
+    fprintf(stderr, "AHPP %d (current position: %d)\n", position, This->column);
+#endif
+
+    if (This->column > position) {
+        putc('\r', This->output);
+        for (loop = 0; loop < position; loop++) {
+            putc(' ', This->output);
+        }
+    }
+    else {
+        for (loop = 0; loop < position - This->column; loop++) {
+            putc(' ', This->output);
+        }
+    }
+    This->column = position;
+    return;
+}
+
+/* Relative moves down and to the right, in lines and columns.
+ */
+static void scs2ascii_rdpp(Tn5250SCS* This) {
+    int lines;
+    int loop;
+
+    lines = scs_getbyte(This);
+#ifdef DEBUG
+    fprintf(stderr, "RDPP %d\n", lines);
+#endif
+
+    for (loop = 0; loop < lines; loop++) {
+        putc('\n', This->output);
+    }
+    This->row = This->row + lines;
+    return;
+}
+
+static void scs2ascii_rrpp(Tn5250SCS* This) {
+    int columns;
+    int loop;
+
+    columns = scs_getbyte(This);
+#ifdef DEBUG
+    fprintf(stderr, "RRPP %d\n", columns);
+#endif
+
+    for (loop = 0; loop < columns; loop++) {
+        putc(' ', This->output);
+    }
+    This->column = This->column + columns;
+    return;
+}
+
+static void scs2ascii_transparent(Tn5250SCS* This) {
+
+    int bytecount;
+    int loop;
+
+#ifdef DEBUG
+#ifdef VERBOSE
+    fprintf(stderr, "doing scs2ascii_transparent()\n");
+#endif
+#endif
+    bytecount = scs_getbyte(This);
+#ifdef DEBUG
+    fprintf(stderr, "TRANSPARENT (%x) = ", bytecount);
+#endif
+
+    for (loop = 0; loop < bytecount; loop++) {
+        putc(scs_getbyte(This), This->output);
+    }
+}
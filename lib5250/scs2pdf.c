@@ -0,0 +1,1678 @@
+/* scs2pdf -- Converts scs from standard input into PDF.
+ * Copyright (C) 2000 Michael Madore
+ * Copyright (C) 2007-2008 James Rich
+ *
+ * This file is part of TN5250.
+ *
+ * TN5250 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * TN5250 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* Modified by James Rich to follow the Adobe PDF-1.3 specification found
+ * at http://partners.adobe.com/asn/developer/acrosdk/docs/PDFRef.pdf
+ */
+
+#include "tn5250-private.h"
+#include "scs-private.h"
+
+#ifdef HAVE_SYSLOG_H
+#include <syslog.h>
+#else
+#define syslog(priority, msg, ...)
+#endif
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#if !defined(_WIN32) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define PDF_POOL
+#endif
+#endif
+
+/*
+#define DEBUG
+#define VERBOSE
+*/
+
+/* Define a default page size of 8.5x11 inches.  These numbers are a little
+ * magic.  The iSeries sends a page size in terms of characters per inch,
+ * but PDF uses points.  The ratio of the numbers below and 1440 is the
+ * same ratio as 612 and 72.  So multiplying the ratio of numbers below over
+ * 1440 by 72 will result in a 8.5x11 inch page,
+ * i.e. (12240/1440) = (612/72) = 8.5 = page width
+ *
+ * Note that the 1440 constant came from Michael Madore.
+ */
+#define DEFAULT_PAGE_WIDTH  12240
+#define DEFAULT_PAGE_LENGTH 15840
+/* Define a maximum number of columns that fit in the default page size
+ * above.  If the page size is not specified and we are given more characters
+ * to print on a line than MAX_COLUMNS we increase the page width.
+ */
+#define MAX_COLUMNS         80
+
+/* Define font names with a number that the PDF can use.  Numbers must be
+ * greater than 0, but it doesn't matter what numbers are chosen.
+ */
+#define COURIER      1
+#define COURIER_BOLD 2
+
+static void scs2pdf_nl(Tn5250SCS* This);
+static void scs2pdf_pp(Tn5250SCS* This);
+static void scs2pdf_ff(Tn5250SCS* This);
+static void scs2pdf_avpp(Tn5250SCS* This);
+static int scs2pdf_ahpp(Tn5250SCS* This, int* boldchars);
+static void scs2pdf_cr(Tn5250SCS* This);
+static void scs2pdf_ssld(Tn5250SCS* This);
+static void scs2pdf_sld(Tn5250SCS* This);
+static void scs2pdf_default(Tn5250SCS* This);
+static void scs2pdf_setfont(Tn5250SCS* This);
+
+static void do_newpage(Tn5250SCS* This);
+static void pdf_page_begin(Tn5250SCS* This);
+static void pdf_page_end(Tn5250SCS* This);
+
+static int pdf_header(Tn5250SCS* This);
+static int pdf_catalog(Tn5250SCS* This, int objnum, int outlinesobject,
+                       int pageobject);
+static int pdf_outlines(Tn5250SCS* This, int objnum);
+static int pdf_stream_header(Tn5250SCS* This, int objnum);
+static int pdf_begin_stream(Tn5250SCS* This, int fontname);
+static int pdf_end_stream(Tn5250SCS* This);
+static int pdf_stream_length(Tn5250SCS* This, int objnum, int objlength);
+static int pdf_pages(Tn5250SCS* This, int objnum, int pagechildren,
+                     int pages);
+static int pdf_page(Tn5250SCS* This, int objnum, int parent, int contents,
+                    int procset, int font, int boldfont, int pagewidth,
+                    int pagelength, int pdfleftmargin, int pdftopmargin);
+static int pdf_procset(Tn5250SCS* This, int objnum);
+static int pdf_font(Tn5250SCS* This, int objnum, int fontname);
+static void pdf_xreftable(Tn5250SCS* This, int objnum);
+static void pdf_trailer(Tn5250SCS* This, int offset, int size, int root);
+static int pdf_process_char(Tn5250SCS* This, char character, int flush);
+static int pdf_stream_puts(Tn5250SCS* This, const char* text);
+#ifdef HAVE_LIBZ
+static int pdf_deflate(Tn5250SCS* This, int flush);
+#endif
+#ifdef PDF_POOL
+static struct _pdf_pool* pdf_pool_new(int threads);
+static void pdf_pool_destroy(struct _pdf_pool* pool);
+static void pdf_pool_submit(Tn5250SCS* This);
+static void pdf_pool_write(Tn5250SCS* This, int wait);
+static void* pdf_pool_worker(void* arg);
+#endif
+static void scs2pdf_jobstart(Tn5250SCS* This);
+static void scs2pdf_jobend(Tn5250SCS* This);
+static void scs2pdf_destroy(Tn5250SCS* This);
+
+struct _expanding_array {
+    int* data;
+    int elems;
+    int alloc;
+};
+typedef struct _expanding_array expanding_array;
+
+static expanding_array* array_new(void);
+static void array_append_val(expanding_array* array, int value);
+static int array_index(expanding_array* array, int idx);
+static void array_set(expanding_array* array, int idx, int value);
+static void array_free(expanding_array* array);
+
+/* Everything we know about the document being written.  The PDF goes to
+ * This->output, which the caller sets before the job starts, so any number
+ * of documents can be converted at once, each on its own Tn5250SCS.
+ */
+struct _Tn5250SCSPrivate {
+    int newfontsize;
+    int fontpointsize;
+    int fontscalingfactor;
+    unsigned long objcount;
+    unsigned long streamsize;
+    unsigned long filesize;
+    int fontsize;
+    int pdfleftmargin;
+    int pdftopmargin;
+    unsigned int pagenumber;
+    int columncheck;
+    int boldchars;
+    int do_bold;
+    char text[255];
+    int newpage;
+
+    /* The stream object of each page, and the file offset of each object
+     * for the cross reference table. */
+    expanding_array* textobjects;
+    expanding_array* objectlist;
+
+    /* Text waiting to go out in the next Tj, see pdf_process_char (). */
+    char buf[249];
+    int bufloc;
+
+    /* With compress set, each page's content stream is deflated as it is
+     * written.  streamout counts the compressed bytes that have reached
+     * the file, which is what the stream's /Length has to be. */
+    int compress;
+#ifdef HAVE_LIBZ
+    int zactive;
+    z_stream zstream;
+    unsigned char zbuf[4096];
+#endif
+    unsigned long streamout;
+
+    /* With more than one thread, pages are deflated by a pool of workers
+     * while we carry on with the next.  The current page's contents are
+     * kept in page until it is handed over, and each page is written out
+     * once it and all the pages before it are done. */
+    int threads;
+    struct _pdf_pool* pool;
+    Tn5250Buffer page;
+};
+
+#ifdef PDF_POOL
+/* The PDF pages are numbered in order, and the stream objects must be
+ * written in that order, so the pool keeps a list of pages from the oldest
+ * one still to be written to the newest.
+ */
+struct _pdf_page_job {
+    struct _pdf_page_job* next;
+    int objnum; /* Stream object; its length object follows. */
+    Tn5250Buffer content;
+    unsigned char* deflated;
+    unsigned long deflated_len;
+    int done;
+};
+
+struct _pdf_pool {
+    pthread_t* workers;
+    int nworkers;
+    pthread_mutex_t lock;
+    pthread_cond_t work; /* A page was queued, or we are stopping. */
+    pthread_cond_t done; /* A page was deflated. */
+    struct _pdf_page_job* head;  /* Oldest page not yet written. */
+    struct _pdf_page_job* tail;  /* Newest page. */
+    struct _pdf_page_job* queue; /* Oldest page no worker has picked up. */
+    int pages;                   /* Pages in the list. */
+    int stop;
+};
+#endif
+
+/* This initializes the scs callbacks
+ */
+Tn5250SCS* tn5250_scs2pdf_new() {
+    Tn5250SCS* scs = tn5250_scs_new();
+
+    if (scs == NULL) {
+        fprintf(stderr,
+                "Unable to allocate memory in tn5250_scs2pdf_new ()!\n");
+        return NULL;
+    }
+
+    scs->data = tn5250_new(struct _Tn5250SCSPrivate, 1);
+    if (scs->data == NULL) {
+        free(scs);
+        return NULL;
+    }
+    scs->map = scs_char_map();
+
+    scs->cpi = 10;
+    scs->topmargin = 240;
+    scs->data->newfontsize = 0;
+    scs->data->fontpointsize = 12;
+    scs->data->fontscalingfactor = 100;
+    scs->data->pdfleftmargin = 18;
+    scs->data->pdftopmargin = 18;
+
+    /* And now set up our callbacks */
+    scs->jobstart = scs2pdf_jobstart;
+    scs->jobend = scs2pdf_jobend;
+    scs->destroy = scs2pdf_destroy;
+    scs->pp = scs2pdf_pp;
+    scs->nl = scs2pdf_nl;
+    scs->rnl = scs2pdf_nl;
+    scs->ff = scs2pdf_ff;
+    scs->rff = scs2pdf_ff;
+    scs->cr = scs2pdf_cr;
+    scs->ssld = scs2pdf_ssld;
+    scs->sld = scs2pdf_sld;
+    scs->setfont = scs2pdf_setfont;
+    scs->avpp = scs2pdf_avpp;
+    scs->scsdefault = scs2pdf_default;
+    return scs;
+}
+
+/* Read the printer state saved by tn5250_scs2pdf_save_init () from a
+ * previous job, so that settings the host only sends once carry over.
+ */
+void tn5250_scs2pdf_load_init(Tn5250SCS* This, FILE* initfile) {
+    int result = 0;
+    int i;
+
+    if (This->usesyslog) {
+        syslog(LOG_INFO, "Reading printer state initialization file");
+    }
+    for (i = 0; fscanf(initfile, "%d", &result) != EOF; i++) {
+        switch (i) {
+        case 0:
+            This->pagewidth = result;
+            break;
+        case 1:
+            This->pagelength = result;
+            break;
+        case 2:
+            This->charwidth = result;
+            break;
+        case 3:
+            This->cpi = result;
+            break;
+        case 4:
+            This->lpi = result;
+            break;
+        case 5:
+            This->data->fontpointsize = result;
+            break;
+        case 6:
+            This->data->fontscalingfactor = result;
+            break;
+        case 7:
+            This->leftmargin = result;
+            break;
+        case 8:
+            This->rightmargin = result;
+            break;
+        case 9:
+            This->topmargin = result;
+            break;
+        case 10:
+            This->bottommargin = result;
+            break;
+        case 11:
+            This->rotation = result;
+            break;
+        }
+    }
+    rewind(initfile);
+
+    if (This->usesyslog) {
+        syslog(LOG_INFO, "Page width: %d", This->pagewidth);
+        syslog(LOG_INFO, "Page length: %d", This->pagelength);
+        syslog(LOG_INFO, "Character width: %d", This->charwidth);
+        syslog(LOG_INFO, "CPI: %d", This->cpi);
+        syslog(LOG_INFO, "LPI: %d", This->lpi);
+        syslog(LOG_INFO, "Font size: %d", This->data->fontpointsize);
+        syslog(LOG_INFO, "Font scaling factor: %d",
+               This->data->fontscalingfactor);
+        syslog(LOG_INFO, "Left margin: %d", This->leftmargin);
+        syslog(LOG_INFO, "Right margin: %d", This->rightmargin);
+        syslog(LOG_INFO, "Top margin: %d", This->topmargin);
+        syslog(LOG_INFO, "Bottom margin: %d", This->bottommargin);
+        syslog(LOG_INFO, "Page orientation: %d", This->rotation);
+        syslog(LOG_INFO, "End of printer state initialization");
+    }
+    return;
+}
+
+/* Save the printer state at the end of a job for the next one.
+ */
+void tn5250_scs2pdf_save_init(Tn5250SCS* This, FILE* initfile) {
+    fprintf(initfile, "%d\n", This->pagewidth);
+    fprintf(initfile, "%d\n", This->pagelength);
+    fprintf(initfile, "%d\n", This->charwidth);
+    fprintf(initfile, "%d\n", This->cpi);
+    fprintf(initfile, "%d\n", This->lpi);
+    fprintf(initfile, "%d\n", This->data->fontpointsize);
+    fprintf(initfile, "%d\n", This->data->fontscalingfactor);
+    fprintf(initfile, "%d\n", This->leftmargin);
+    fprintf(initfile, "%d\n", This->rightmargin);
+    fprintf(initfile, "%d\n", This->topmargin);
+    fprintf(initfile, "%d\n", This->bottommargin);
+    fprintf(initfile, "%d\n", This->rotation);
+    return;
+}
+
+/* Turn compression of the page content streams on or off.  This has to be
+ * done before the job starts, and is ignored when we were built without
+ * zlib.
+ */
+void tn5250_scs2pdf_set_compress(Tn5250SCS* This, int compress) {
+#ifdef HAVE_LIBZ
+    This->data->compress = compress;
+#else
+    if (compress) {
+        fprintf(stderr, "scs2pdf: built without zlib, not compressing\n");
+    }
+#endif
+    return;
+}
+
+/* Deflate pages on this many threads.  Only used along with compression,
+ * since there is nothing else worth doing in parallel.
+ */
+void tn5250_scs2pdf_set_threads(Tn5250SCS* This, int threads) {
+    This->data->threads = threads;
+    return;
+}
+
+/* Start a document: write the PDF header and open the first page's
+ * content stream.
+ */
+static void scs2pdf_jobstart(Tn5250SCS* This) {
+    This->data->objectlist = array_new();
+    This->data->textobjects = array_new();
+    This->data->bufloc = 0;
+#ifdef HAVE_LIBZ
+    if (This->data->compress && !This->data->zactive) {
+        memset(&This->data->zstream, 0, sizeof(z_stream));
+        if (deflateInit(&This->data->zstream, Z_DEFAULT_COMPRESSION) ==
+            Z_OK) {
+            This->data->zactive = 1;
+        }
+        else {
+            fprintf(stderr, "scs2pdf: deflateInit failed, not compressing\n");
+            This->data->compress = 0;
+        }
+    }
+#endif
+#ifdef PDF_POOL
+    if (This->data->compress && This->data->threads > 1) {
+        This->data->pool = pdf_pool_new(This->data->threads);
+        tn5250_buffer_init(&This->data->page);
+    }
+#endif
+
+    This->column = 1;
+    This->data->objcount = 0;
+    This->data->streamsize = 0;
+    This->data->filesize = 0;
+    This->data->pagenumber = 1;
+    This->data->columncheck = 0;
+    This->data->boldchars = 0;
+    This->data->do_bold = 0;
+    This->data->text[0] = '\0';
+    This->data->newpage = 0;
+
+    /* Write out the PDF header.  filesize tracks how big the PDF is since
+     * we need that information later.
+     */
+    This->data->filesize += pdf_header(This);
+
+    /* objectlist contains an entry for the filesize when the object was
+     * created.  Since the cross reference of a PDF needs to know what the
+     * byte count is for the beginning of each object we use objectlist to
+     * track it.
+     */
+    pdf_page_begin(This);
+#ifdef DEBUG
+    fprintf(stderr, "objcount = %lu\n", This->data->objcount);
+#endif
+    return;
+}
+
+/* Finish a document: close the last page, then write out the document
+ * catalog, fonts, page tree, cross reference table and trailer.
+ */
+static void scs2pdf_jobend(Tn5250SCS* This) {
+    int pageparent, procsetobject, fontobject, boldfontobject, rootobject;
+    int i;
+
+    pdf_page_end(This);
+#ifdef DEBUG
+    fprintf(stderr, "stream length objcount = %d\n", This->data->objcount);
+#endif
+#ifdef PDF_POOL
+    if (This->data->pool != NULL) {
+        pdf_pool_write(This, 1);
+        pdf_pool_destroy(This->data->pool);
+        This->data->pool = NULL;
+        tn5250_buffer_free(&This->data->page);
+    }
+#endif
+
+    array_append_val(This->data->objectlist, This->data->filesize);
+    This->data->objcount++;
+    This->data->filesize +=
+        pdf_catalog(This, This->data->objcount, This->data->objcount + 1,
+                    This->data->objcount + 5);
+    rootobject = This->data->objcount;
+#ifdef DEBUG
+    fprintf(stderr, "catalog objcount = %d\n", This->data->objcount);
+#endif
+
+    array_append_val(This->data->objectlist, This->data->filesize);
+    This->data->objcount++;
+    This->data->filesize += pdf_outlines(This, This->data->objcount);
+#ifdef DEBUG
+    fprintf(stderr, "outlines objcount = %d\n", This->data->objcount);
+#endif
+
+    array_append_val(This->data->objectlist, This->data->filesize);
+    This->data->objcount++;
+    This->data->filesize += pdf_procset(This, This->data->objcount);
+    procsetobject = This->data->objcount;
+#ifdef DEBUG
+    fprintf(stderr, "procedure set objcount = %d\n", This->data->objcount);
+#endif
+
+    /* We need to create a font object for every font we use.  Since we don't
+     * necessarily know if we used bold just make a bold font object anyway.
+     * It doesn't hurt to have objects that aren't used.
+     */
+    array_append_val(This->data->objectlist, This->data->filesize);
+    This->data->objcount++;
+    This->data->filesize += pdf_font(This, This->data->objcount, COURIER);
+    fontobject = This->data->objcount;
+#ifdef DEBUG
+    fprintf(stderr, "font objcount = %d\n", This->data->objcount);
+#endif
+
+    array_append_val(This->data->objectlist, This->data->filesize);
+    This->data->objcount++;
+    This->data->filesize +=
+        pdf_font(This, This->data->objcount, COURIER_BOLD);
+    boldfontobject = This->data->objcount;
+#ifdef DEBUG
+    fprintf(stderr, "bold font objcount = %d\n", This->data->objcount);
+#endif
+
+    /* If the page size was not specified and we have lines longer than we
+     * think we can fit on a page increase the page width a half inch at a time.
+     */
+    if ((This->pagewidth == 0) && (This->data->columncheck > MAX_COLUMNS)) {
+        for (i = 0; i < 15; i++) {
+            if (This->data->columncheck < (MAX_COLUMNS + (5 * i))) {
+#ifdef DEBUG
+                fprintf(stderr, "columncheck = %d, pagewidth = %d\n",
+                        This->data->columncheck, This->pagewidth);
+#endif
+                break;
+            }
+            This->pagewidth = DEFAULT_PAGE_WIDTH + (720 * i);
+        }
+    }
+    array_append_val(This->data->objectlist, This->data->filesize);
+    This->data->objcount++;
+    This->data->filesize += pdf_pages(This, 
+        This->data->objcount, This->data->objcount + 1, This->data->pagenumber);
+    pageparent = This->data->objcount;
+#ifdef DEBUG
+    fprintf(stderr, "pages objcount = %lu\n", This->data->objcount);
+#endif
+
+    for (i = 0; i < This->data->pagenumber; i++) {
+        array_append_val(This->data->objectlist, This->data->filesize);
+        This->data->objcount++;
+        This->data->filesize += pdf_page(
+            This, This->data->objcount, pageparent,
+            array_index(This->data->textobjects, i), procsetobject,
+            fontobject, boldfontobject, This->pagewidth, This->pagelength,
+            This->data->pdfleftmargin, This->data->pdftopmargin);
+#ifdef DEBUG
+        fprintf(stderr, "page objcount = %lu\n", This->data->objcount);
+#endif
+    }
+
+    pdf_xreftable(This, This->data->objcount);
+    pdf_trailer(This, This->data->filesize, This->data->objcount + 1,
+                rootobject);
+
+    array_free(This->data->textobjects);
+    array_free(This->data->objectlist);
+    This->data->textobjects = NULL;
+    This->data->objectlist = NULL;
+#ifdef HAVE_LIBZ
+    if (This->data->zactive) {
+        deflateEnd(&This->data->zstream);
+        This->data->zactive = 0;
+    }
+#endif
+    return;
+}
+
+/* Free what a document cut short left behind.
+ */
+static void scs2pdf_destroy(Tn5250SCS* This) {
+    if (This->data->textobjects != NULL) {
+        array_free(This->data->textobjects);
+    }
+    if (This->data->objectlist != NULL) {
+        array_free(This->data->objectlist);
+    }
+#ifdef HAVE_LIBZ
+    if (This->data->zactive) {
+        deflateEnd(&This->data->zstream);
+    }
+#endif
+#ifdef PDF_POOL
+    if (This->data->pool != NULL) {
+        pdf_pool_destroy(This->data->pool);
+        tn5250_buffer_free(&This->data->page);
+    }
+#endif
+    return;
+}
+
+static void scs2pdf_default(Tn5250SCS* This) {
+    if (This->data->newpage == 1) {
+        do_newpage(This);
+    }
+
+    This->data->streamsize +=
+        pdf_process_char(This,
+                         tn5250_char_map_to_local(This->map, This->curchar), 0);
+
+    /* If you want to feed this program non-EBCDIC text then uncomment
+     * the line below and comment the line above.
+     *
+     * streamsize += pdf_process_char(This, curchar, 0);
+     */
+    This->column = This->column + 1;
+
+    /* If the current position on the page (column) is further to the
+     * right than our current maximum line length (columncheck)
+     * increase our length.  This is used later to see if we need a
+     * larger page width if the page width is unspecified.
+     */
+    if (This->column > This->data->columncheck) {
+        This->data->columncheck = This->column;
+    }
+
+    /* If we are currently printing bold character then decrement the
+     * bold character count (boldchars) given above by
+     * scs2pdf_pp() until there aren't any bold characters left
+     * to print.  When out of bold character reset the font and allow
+     * changing to bold again.
+     */
+    if (This->data->boldchars > 0) {
+        This->data->boldchars = This->data->boldchars - 1;
+        if (This->data->boldchars == 0) {
+#ifdef DEBUG
+            fprintf(stderr, "Ending bold font\n");
+#endif
+            This->data->do_bold = 0;
+            This->data->streamsize += pdf_process_char(This, '\0', 1);
+            sprintf(This->data->text,
+                    "\t\t/F%d %d Tf\n"
+                    "\t\t/F%d %d Tz\n",
+                    COURIER, This->data->fontpointsize, COURIER,
+                    This->data->fontscalingfactor);
+            This->data->streamsize += pdf_stream_puts(This, This->data->text);
+        }
+    }
+    return;
+}
+
+/* Handle new lines uniquely to track column number
+ */
+static void scs2pdf_nl(Tn5250SCS* This) {
+    float leftmargin;
+    int leftmarginint;
+    int currentcol;
+    char text[256] = { '\0' };
+
+    if (This->data->newpage == 1) {
+        do_newpage(This);
+    }
+
+    currentcol = This->column;
+    scs_nl(This);
+
+    /* If the current position on the page (column) is further to the
+     * right than our current maximum line length (columncheck)
+     * increase our length.  This is used later to see if we need a
+     * larger page width if the page width is unspecified.
+     */
+    if (currentcol > This->data->columncheck) {
+        This->data->columncheck = currentcol;
+    }
+
+    leftmargin = (This->leftmargin - 1) / 1440.0;
+    leftmarginint = leftmargin * 72;
+
+    /* On newline flush the buffer and move the active line down
+     * 12 points.
+     */
+    This->data->streamsize += pdf_process_char(This, '\0', 1);
+    sprintf(text, "%d -%d Td\n", leftmarginint, 72 / This->lpi);
+    This->data->streamsize += pdf_stream_puts(This, text);
+    return;
+}
+
+static void scs2pdf_ff(Tn5250SCS* This) {
+    scs_ff(This);
+    This->data->newpage = 1;
+    return;
+}
+
+/* This function is different than what is in scs.c because we want to pass
+ * a pointer to the number of bold characters to print to scs2pdf_ahpp()
+ * (which is a unique version of scs_ahpp()).  Since this program is the only
+ * one that handles bold this is unique.
+ */
+static void scs2pdf_pp(Tn5250SCS* This) {
+    unsigned char curchar;
+    int bytes;
+
+    bytes = 0;
+    This->data->boldchars = 0;
+    curchar = scs_getbyte(This);
+    switch (curchar) {
+    case SCS_RDPP: {
+        scs_rdpp(This);
+        break;
+    }
+    case SCS_AVPP: {
+        This->avpp(This);
+        break;
+    }
+    case SCS_AHPP: {
+        bytes = scs2pdf_ahpp(This, &(This->data->boldchars));
+        break;
+    }
+    case SCS_RRPP: {
+        scs_rrpp(This);
+        break;
+    }
+    default: {
+        fprintf(stderr, "ERROR: Unknown 0x34 command %x\n", curchar);
+    }
+    }
+    This->data->streamsize += bytes;
+
+    /* If scs2pdf_ahpp() tells us that there are bold characters
+     * to write and we aren't already in the middle of writing some
+     * bold character, flush the buffer and send the bold font to the
+     * PDF.
+     */
+    if ((This->data->boldchars > 0) && (This->data->do_bold == 0)) {
+        This->data->do_bold = 1;
+#ifdef DEBUG
+        fprintf(stderr, "Starting bold font\n");
+#endif
+        This->data->streamsize += pdf_process_char(This, '\0', 1);
+        sprintf(This->data->text,
+                "\t\t/F%d %d Tf\n"
+                "\t\t/F%d %d Tz\n",
+                COURIER_BOLD, This->data->fontpointsize, COURIER,
+                This->data->fontscalingfactor);
+        This->data->streamsize += pdf_stream_puts(This, This->data->text);
+    }
+    return;
+}
+
+/* Absolute Vertical move (AVPP).  This is part of Cursor Controls.
+ */
+static void scs2pdf_avpp(Tn5250SCS* This) {
+    int i;
+    int newrow;
+    int lines;
+
+    newrow = scs_getbyte(This);
+
+    if ((This->usesyslog) && (This->loglevel > 0)) {
+        syslog(
+            LOG_INFO,
+            "PP sent absolute vertical move of %d (cursor currently on row %d)",
+            newrow, This->row);
+    }
+
+#ifdef DEBUG
+    fprintf(stderr, "AVPP %d\n", newrow);
+#endif
+
+    if (newrow < This->row) {
+        /* From the IPDS and SCS Technical Reference:
+         * Absolute vertical moves above the current cursor position cause
+         * the current page to be printed and the cursor to be positioned at
+         * that line on the next page.  An absolute vertical move to line 1
+         * guarantees that the printer is on a page boundary and will not
+         * cause a form feed of a blank sheet if the printer is already on
+         * line 1.  Absolute vertical moves below the bottom margin trigger
+         * a new page.
+         *
+         * So it appears that if newrow is less than This->row we should send
+         * a form feed.  However, in practice that doesn't work.  Simply
+         * sending a form feed whenever newrow is less than This->row results
+         * in extra form feeds being sent.  I am unsure of exactly what
+         * conditions are supposed to trigger a form feed as described above.
+         */
+        /*This->ff (This);*/
+        This->row = newrow;
+    }
+    else {
+        lines = newrow - This->row;
+
+        if ((This->usesyslog) && (This->loglevel > 0)) {
+            syslog(LOG_INFO, "Forcing %d new lines", lines);
+        }
+
+        for (i = 0; i < lines; i++) {
+            scs2pdf_nl(This);
+        }
+        This->row = newrow;
+    }
+    return;
+}
+
+/* This function is different than what is in scs.c because we want to pass
+ * a pointer to the number of bold characters to print.  Since this program
+ * is the only one that handles bold this is unique.
+ */
+static int scs2pdf_ahpp(Tn5250SCS* This, int* boldchars) {
+    int position, bytes;
+    int i;
+
+    if (This->data->newpage == 1) {
+        do_newpage(This);
+    }
+
+    bytes = 0;
+    position = scs_getbyte(This);
+
+    if ((This->usesyslog) && (This->loglevel > 0)) {
+        syslog(LOG_INFO,
+               "PP sent absolute horizontal move of %d (cursor currently on "
+               "column %d)",
+               position, This->column);
+    }
+
+    if (This->column > position) {
+        if ((This->usesyslog) && (This->loglevel > 0)) {
+            syslog(LOG_INFO, "Moving left");
+        }
+    }
+    else {
+        if ((This->usesyslog) && (This->loglevel > 0)) {
+            syslog(LOG_INFO, "Moving right");
+        }
+    }
+
+#ifdef DEBUG
+    fprintf(stderr, "AHPP %d (current position: %d)\n", position, This->column);
+#endif
+
+    if ((This->column - 1) > position) {
+        /* Frank Richter <frichter@esda.com> noticed that we should be
+         * going back and printing over the same line if This->column is greater
+         * than position.  Without this his reports were wrong.  His patch
+         * fixes the printouts.  What this does now is to go back to the
+         * beginning of the line and print blanks over what is already there
+         * up to position.  At that point we will receive the same text that
+         * is already at position, which we will print over the top of itself.
+         * This is gives a bold effect on real SCS printers.  This ought to
+         * be handled a better way to get bold.
+         */
+        *boldchars = This->column - position;
+        bytes += pdf_process_char(This, '\0', 1);
+        bytes += pdf_stream_puts(This, "0 0 Td\n");
+
+        for (i = 0; i < position - 1; i++) {
+            bytes += pdf_process_char(This, ' ', 0);
+        }
+    }
+    else {
+        for (i = 0; i < (position - This->column); i++) {
+            bytes += pdf_process_char(This, ' ', 0);
+        }
+    }
+    This->column = position;
+    return (bytes);
+}
+
+/* Handle carriage return uniquely to track column number
+ */
+static void scs2pdf_cr(Tn5250SCS* This) {
+    if (This->data->newpage == 1) {
+        do_newpage(This);
+    }
+
+    scs_cr(This);
+
+    /* If the current position on the page (column) is further to the
+     * right than our current maximum line length (columncheck)
+     * increase our length.  This is used later to see if we need a
+     * larger page width if the page width is unspecified.
+     */
+    if (This->column > This->data->columncheck) {
+        This->data->columncheck = This->column;
+    }
+    /* On carriage return flush the buffer and move to the beginning of the
+     * current line.
+     */
+    This->data->streamsize += pdf_process_char(This, '\0', 1);
+    This->data->streamsize += pdf_stream_puts(This, "0 0 Td\n");
+    This->column = 1;
+    return;
+}
+
+/* Handle line density uniquely for font sizing.
+ */
+static void scs2pdf_ssld(Tn5250SCS* This) {
+    scs_ssld(This);
+    /* This doesn't give good results yet, so just leave it at 12 */
+    /*This->data->fontpointsize = 72 / This->lpi;*/
+    return;
+}
+
+/* Handle line density uniquely for font sizing.
+ */
+static void scs2pdf_sld(Tn5250SCS* This) {
+    scs_sld(This);
+    /* This doesn't give good results yet, so just leave it at 12 */
+    /*This->data->fontpointsize = 72 / This->lpi;*/
+    return;
+}
+
+/* Set the correct font width.
+ */
+static void scs2pdf_setfont(Tn5250SCS* This) {
+    float scale;
+
+    /* The scaling factor is based on a 12 point Courier font which is 10 CPI.
+     * 10 CPI means each character 144 units wide (one inch = 1440 units : 1440
+     * units divided by 10 characters per inch equals 144 units per character)
+     */
+    scale = This->charwidth / 144.0;
+    This->data->fontscalingfactor = scale * 100;
+
+    This->data->streamsize += pdf_process_char(This, '\0', 1);
+    sprintf(This->data->text, "\t\t/F%d %d Tz\n", COURIER,
+            This->data->fontscalingfactor);
+    This->data->streamsize += pdf_stream_puts(This, This->data->text);
+    return;
+}
+
+static void do_newpage(Tn5250SCS* This) {
+    pdf_page_end(This);
+    This->data->streamsize = 0;
+#ifdef DEBUG
+    fprintf(stderr, "objcount = %d\n", This->data->objcount);
+#endif
+
+    /* Ending the stream object above and starting a new one
+     * here constitutes a new page, in conjuction with the
+     * pdf_page() function below.
+     */
+    pdf_page_begin(This);
+#ifdef DEBUG
+    fprintf(stderr, "objcount = %d\n", This->data->objcount);
+#endif
+
+    This->data->pagenumber++;
+#ifdef DEBUG
+    fprintf(stderr, "pagenumber: %d\n", This->data->pagenumber);
+#endif
+    This->column = 1;
+    This->data->newpage = 0;
+    return;
+}
+
+/* Start the stream object holding a page's contents.
+ */
+static void pdf_page_begin(Tn5250SCS* This) {
+    array_append_val(This->data->objectlist, This->data->filesize);
+    This->data->objcount++;
+    This->data->filesize += pdf_begin_stream(This, COURIER);
+    return;
+}
+
+/* Finish the current page's stream object, and write its length.  When
+ * the pool is deflating pages, the page is handed over instead, and
+ * written by pdf_pool_write() along with the offsets of both objects.
+ */
+static void pdf_page_end(Tn5250SCS* This) {
+    /* We need to know what stream objects (textobjects) were
+     * put on this page.  We put one stream object on each
+     * page.
+     */
+    array_append_val(This->data->textobjects, This->data->objcount);
+
+    This->data->streamsize += pdf_process_char(This, '\0', 1);
+#ifdef PDF_POOL
+    if (This->data->pool != NULL) {
+        This->data->streamsize += pdf_stream_puts(This, "\tET\n");
+        array_append_val(This->data->objectlist, 0);
+        This->data->objcount++;
+        pdf_pool_submit(This);
+        pdf_pool_write(This, 0);
+        return;
+    }
+#endif
+    This->data->filesize += pdf_end_stream(This);
+
+    array_append_val(This->data->objectlist, This->data->filesize);
+    This->data->objcount = This->data->objcount + 1;
+#ifdef DEBUG
+    fprintf(stderr, "objcount: %d\n", This->data->objcount);
+#endif
+    This->data->filesize += pdf_stream_length(This, This->data->objcount,
+                                              This->data->streamsize);
+    return;
+}
+
+/* This header is required on all PDFs to identify what level of the PDF
+ * specification was used to create this PDF.
+ */
+static int pdf_header(Tn5250SCS* This) {
+    char* text = "%PDF-1.3\n\n";
+
+    fprintf(This->output, "%s", text);
+
+    return (strlen(text));
+}
+
+/* This is required to tell the reader where to find stuff.*/
+static int pdf_catalog(Tn5250SCS* This, int objnum, int outlinesobject,
+                       int pageobject) {
+    char text[255];
+
+    sprintf(text,
+            "%d 0 obj\n"
+            "\t<<\n"
+            "\t\t/Type /Catalog\n"
+            "\t\t/Outlines %d 0 R\n"
+            "\t\t/Pages %d 0 R\n"
+            "\t>>\n"
+            "endobj\n\n",
+            objnum, outlinesobject, pageobject);
+
+    fprintf(This->output, "%s", text);
+
+    return (strlen(text));
+}
+
+/* We don't really use outlines but they are required.*/
+static int pdf_outlines(Tn5250SCS* This, int objnum) {
+    char text[255];
+
+    sprintf(text,
+            "%d 0 obj\n"
+            "\t<<\n"
+            "\t\t/Type Outlines\n"
+            "\t\t/Count 0\n"
+            "\t>>\n"
+            "endobj\n\n",
+            objnum);
+
+    fprintf(This->output, "%s", text);
+
+    return (strlen(text));
+}
+
+/* The start of a stream object, up to the stream data.
+ */
+static int pdf_stream_header(Tn5250SCS* This, int objnum) {
+    char text[255];
+
+    sprintf(text,
+            "%d 0 obj\n"
+            "\t<<\n"
+            "\t\t/Length %d 0 R\n"
+            "%s"
+            "\t>>\n"
+            "stream\n",
+            objnum, objnum + 1,
+            This->data->compress ? "\t\t/Filter /FlateDecode\n" : "");
+    fprintf(This->output, "%s", text);
+    return (strlen(text));
+}
+
+/* Each time we begin a page we use this to start the stream object that the
+ * page will contain.
+ */
+static int pdf_begin_stream(Tn5250SCS* This, int fontname) {
+    char text2[255] = { '\0' };
+    int header;
+    int leftmargin;
+    int pagelength;
+    float topsize;
+    int topmargin;
+
+    /* A page going to the pool gets its header when it is written. */
+    header = 0;
+    if (This->data->pool == NULL) {
+        header = pdf_stream_header(This, This->data->objcount);
+    }
+    This->data->streamout = 0;
+#ifdef HAVE_LIBZ
+    if (This->data->compress) {
+        deflateReset(&This->data->zstream);
+    }
+#endif
+
+    if (This->leftmargin == 0) {
+        leftmargin = 1;
+    }
+    else {
+        leftmargin = This->leftmargin;
+    }
+
+    if (This->pagelength == 0) {
+        pagelength = 15840;
+    }
+    else {
+        pagelength = This->pagelength;
+    }
+
+    topsize = ((pagelength - This->topmargin) / 1440.0) * 72.0;
+    topmargin = topsize - This->data->pdftopmargin;
+    sprintf(text2,
+            "\tBT\n"
+            "\t\t/F%d %d Tf\n"
+            "\t\t/F%d %d Tz\n"
+            "\t\t%d %d Td\n",
+            fontname, This->data->fontpointsize, COURIER,
+            This->data->fontscalingfactor,
+            (((leftmargin - 1) / 1440) * 72) + This->data->pdfleftmargin,
+            topmargin);
+    This->data->streamsize += pdf_stream_puts(This, text2);
+
+    /* Don't return the length added to the stream size since the stream size
+     * will be added to the file size once the stream has finished.
+     */
+    /*return (strlen (text1) + strlen (text2)); */
+    return (header);
+}
+
+/* And this ends the stream object started above.  Returns everything the
+ * stream object added to the file since pdf_begin_stream(), and leaves the
+ * stream's length in streamsize.
+ */
+static int pdf_end_stream(Tn5250SCS* This) {
+    char* text = "endstream\n"
+                 "endobj\n\n";
+
+    This->data->streamsize += pdf_stream_puts(This, "\tET\n");
+#ifdef HAVE_LIBZ
+    if (This->data->compress) {
+        pdf_deflate(This, Z_FINISH);
+        This->data->streamsize = This->data->streamout;
+
+        /* Compressed data doesn't end with a newline of its own, and the
+         * one we add isn't part of the stream's length. */
+        fprintf(This->output, "\n%s", text);
+        return (This->data->streamsize + 1 + strlen(text));
+    }
+#endif
+    fprintf(This->output, "%s", text);
+    return (This->data->streamsize + strlen(text));
+}
+
+/* Since we don't know how long the stream object is when we start it we use
+ * an indirect object to specify its length.  That indirect object points to
+ * this function's output which is the length of the stream object created.
+ */
+static int pdf_stream_length(Tn5250SCS* This, int objnum, int objlength) {
+    char text[255];
+
+    sprintf(text,
+            "%d 0 obj\n"
+            "\t%d\n"
+            "endobj\n\n",
+            objnum, objlength);
+    fprintf(This->output, "%s", text);
+    return (strlen(text));
+}
+
+/* This starts the page tree.  We only have one root (this function) which
+ * contains all the page leaves (created by pdf_page()).
+ */
+static int pdf_pages(Tn5250SCS* This, int objnum, int pagechildren,
+                     int pages) {
+    char text[255];
+    int bytes;
+    int i;
+
+    sprintf(text,
+            "%d 0 obj\n"
+            "\t<<\n"
+            "\t\t/Type /Pages\n"
+            "\t\t/Kids [",
+            objnum);
+    fprintf(This->output, "%s", text);
+    bytes = strlen(text);
+    sprintf(text, " %d 0 R\n", pagechildren);
+    fprintf(This->output, "%s", text);
+    bytes += strlen(text);
+    for (i = 1; i < pages; i++) {
+        sprintf(text, "\t\t      %d 0 R\n", pagechildren + i);
+        fprintf(This->output, "%s", text);
+        bytes += strlen(text);
+    }
+    sprintf(text,
+            "\t\t      ]\n"
+            "\t\t/Count %d\n"
+            "\t>>\n"
+            "endobj\n\n",
+            pages);
+
+    fprintf(This->output, "%s", text);
+    bytes += strlen(text);
+
+    return (bytes);
+}
+
+/* This describes the page size and contents for a page.  This is called once
+ * for each page that is in the PDF.
+ */
+static int pdf_page(Tn5250SCS* This, int objnum, int parent, int contents,
+                    int procset, int font, int boldfont, int pagewidth,
+                    int pagelength, int pdfleftmargin, int pdftopmargin) {
+    char text[255];
+    float width, length;
+
+    /* PDF uses 72 points per inch so 8.5x11 in. page is 612x792 points
+     * You can set MediaBox to [0 0 612 792] to force this
+     */
+    if (pagewidth == 0) {
+#ifdef DEBUG
+        fprintf(stderr, "No page width given, using default.\n");
+#endif
+        pagewidth = DEFAULT_PAGE_WIDTH;
+    }
+    if (pagelength == 0) {
+#ifdef DEBUG
+        fprintf(stderr, "No page length given, using default.\n");
+#endif
+        pagelength = DEFAULT_PAGE_LENGTH;
+    }
+    width = ((pagewidth / 1440.0) * 72) + (pdfleftmargin * 2);
+    length = ((pagelength / 1440.0) * 72) + (pdftopmargin * 2);
+#ifdef DEBUG
+    fprintf(stderr, "Setting page to %d (%f) by %d (%f) points\n", (int)width,
+            width, (int)length, length);
+#endif
+    sprintf(text,
+            "%d 0 obj\n"
+            "\t<<\n"
+            "\t\t/Type /Page\n"
+            "\t\t/Parent %d 0 R\n"
+            "\t\t/MediaBox [0 0 %d %d]\n"
+            "\t\t/Contents %d 0 R\n"
+            "\t\t/Resources\n"
+            "\t\t\t<<\n"
+            "\t\t\t\t/ProcSet %d 0 R\n"
+            "\t\t\t\t/Font\n"
+            "\t\t\t\t\t<< /F%d %d 0 R\n"
+            "\t\t\t\t\t   /F%d %d 0 R >>\n"
+            "\t\t\t>>\n"
+            "\t>>\n"
+            "endobj\n\n",
+            objnum, parent, (int)width, (int)length, contents, procset, COURIER,
+            font, COURIER_BOLD, boldfont);
+
+    fprintf(This->output, "%s", text);
+
+    return (strlen(text));
+}
+
+/* The required procedure set.*/
+static int pdf_procset(Tn5250SCS* This, int objnum) {
+    char text[255];
+
+    sprintf(text,
+            "%d 0 obj\n"
+            "\t[/PDF /Text]\n"
+            "endobj\n\n",
+            objnum);
+
+    fprintf(This->output, "%s", text);
+
+    return (strlen(text));
+}
+
+/* This creates the font objects used in the PDF.*/
+static int pdf_font(Tn5250SCS* This, int objnum, int fontname) {
+    char text[255];
+
+    switch (fontname) {
+    case COURIER: {
+        sprintf(text,
+                "%d 0 obj\n"
+                "\t<<\n"
+                "\t\t/Type /Font\n"
+                "\t\t/Subtype /Type1\n"
+                "\t\t/Name /F%d\n"
+                "\t\t/BaseFont /Courier\n"
+                "\t\t/Encoding /WinAnsiEncoding\n"
+                "\t>>\n"
+                "endobj\n\n",
+                objnum, fontname);
+        break;
+    }
+    case COURIER_BOLD: {
+        sprintf(text,
+                "%d 0 obj\n"
+                "\t<<\n"
+                "\t\t/Type /Font\n"
+                "\t\t/Subtype /Type1\n"
+                "\t\t/Name /F%d\n"
+                "\t\t/BaseFont /Courier-Bold\n"
+                "\t\t/Encoding /WinAnsiEncoding\n"
+                "\t>>\n"
+                "endobj\n\n",
+                objnum, fontname);
+        break;
+    }
+    default: {
+        sprintf(text,
+                "%d 0 obj\n"
+                "\t<<\n"
+                "\t\t/Type /Font\n"
+                "\t\t/Subtype /Type1\n"
+                "\t\t/Name /F%d\n"
+                "\t\t/BaseFont /Courier\n"
+                "\t\t/Encoding /WinAnsiEncoding\n"
+                "\t>>\n"
+                "endobj\n\n",
+                objnum, fontname);
+        break;
+    }
+    }
+
+    fprintf(This->output, "%s", text);
+
+    return (strlen(text));
+}
+
+/* The required cross reference table.*/
+static void pdf_xreftable(Tn5250SCS* This, int objnum) {
+    int curobj;
+
+    /* This part is important to get right or the PDF cannot be read.
+     * The cross reference section always begins with the keyword 'xref'
+     */
+    fprintf(This->output, "xref\n");
+    /* Then we follow with one or more cross reference subsections.  Since
+     * this is always the first revision this cross reference will have no
+     * more than one subsection.  The subsection numbering begins with 0.
+     * After the subsection number we must indicate how many entries (objects)
+     * are in this subsection.
+     */
+    fprintf(This->output, "0 %d\n", objnum + 1);
+    /* The entries consist of a 10-digit byte offset (the number of bytes
+     * from the beginning of the file to the beginning of the object to
+     * which the entry refers), followed by a space, followed by a 5-digit
+     * generation number, followed by a two character end of line sequence
+     * (either carriage return and line feed or space and line feed).
+     * Object 0 is always free and always has a generation number of 65535
+     * so we list that first.  We will never have more free entries.
+     */
+    fprintf(This->output, "0000000000 65535 f \n");
+    /* The generation number will always be zeros for all in-use objects
+     * since we are not updating anything.  We must have an entry for all
+     * objects we created.
+     */
+    for (curobj = 0; curobj < objnum; curobj++) {
+        fprintf(This->output, "%010d 00000 n \n",
+                array_index(This->data->objectlist, curobj));
+    }
+}
+
+/* And the required trailer.*/
+static void pdf_trailer(Tn5250SCS* This, int offset, int size, int root) {
+    char text[255];
+
+    sprintf(text,
+            "\ntrailer\n"
+            "\t<<\n"
+            "\t\t/Size %d\n"
+            "\t\t/Root %d 0 R\n"
+            "\t>>\n"
+            "startxref\n"
+            "%d\n"
+            "%%%%EOF\n",
+            size, root, offset);
+
+    fprintf(This->output, "%s", text);
+}
+
+/* Here we process the characters given in the input stream (stdin).  If
+ * flush is 1 then flush the buffer.  The buffer is 255 bytes long since
+ * that is what Adobe recommends because of limitations of some operating
+ * environments.
+ */
+static int pdf_process_char(Tn5250SCS* This, char character, int flush) {
+    char* buf = This->data->buf;
+    char text[256];
+    int byteswritten;
+
+    byteswritten = 0;
+
+    if (character == '(' || character == ')') {
+        byteswritten = pdf_process_char(This, '\\', 0);
+    }
+
+    if (This->data->bufloc >= 247 || flush == 1) {
+        /* This should never happen */
+        if (This->data->bufloc > 247) {
+            buf[247] = character;
+            buf[248] = '\0';
+        }
+        else {
+            buf[This->data->bufloc] = character;
+            buf[This->data->bufloc + 1] = '\0';
+        }
+        sprintf(text, "(%s) Tj\n", buf);
+        byteswritten += pdf_stream_puts(This, text);
+        memset(buf, '\0', 249);
+        This->data->bufloc = 0;
+        return (byteswritten);
+    }
+    else {
+        buf[This->data->bufloc] = character;
+        This->data->bufloc++;
+        return (byteswritten);
+    }
+}
+
+/* Everything inside a page's content stream is written through here, so
+ * that it can be compressed.  Returns the uncompressed length.
+ */
+static int pdf_stream_puts(Tn5250SCS* This, const char* text) {
+    int len = strlen(text);
+
+#ifdef PDF_POOL
+    if (This->data->pool != NULL) {
+        tn5250_buffer_append_data(&This->data->page, (unsigned char*)text,
+                                  len);
+        return (len);
+    }
+#endif
+#ifdef HAVE_LIBZ
+    if (This->data->compress) {
+        This->data->zstream.next_in = (Bytef*)text;
+        This->data->zstream.avail_in = len;
+        pdf_deflate(This, Z_NO_FLUSH);
+        return (len);
+    }
+#endif
+    fwrite(text, 1, len, This->output);
+    This->data->streamout += len;
+    return (len);
+}
+
+#ifdef HAVE_LIBZ
+/* Run the deflate stream, writing out whatever it gives us.  The output
+ * buffer is emptied into the file each time it fills, so memory use stays
+ * the same however long the page is.
+ */
+static int pdf_deflate(Tn5250SCS* This, int flush) {
+    z_stream* zs = &This->data->zstream;
+    int ret, len;
+
+    do {
+        zs->next_out = This->data->zbuf;
+        zs->avail_out = sizeof(This->data->zbuf);
+        ret = deflate(zs, flush);
+        len = sizeof(This->data->zbuf) - zs->avail_out;
+        fwrite(This->data->zbuf, 1, len, This->output);
+        This->data->streamout += len;
+    } while (zs->avail_out == 0);
+    return (ret);
+}
+#endif
+
+#ifdef PDF_POOL
+/* Start the threads which deflate pages.
+ */
+static struct _pdf_pool* pdf_pool_new(int threads) {
+    struct _pdf_pool* pool;
+    int i;
+
+    pool = tn5250_new(struct _pdf_pool, 1);
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->workers = tn5250_new(pthread_t, threads);
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&pool->workers[i], NULL, pdf_pool_worker, pool) !=
+            0) {
+            break;
+        }
+    }
+    pool->nworkers = i;
+    if (pool->nworkers == 0) {
+        pdf_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+/* Stop the threads, and throw away any pages not yet written.
+ */
+static void pdf_pool_destroy(struct _pdf_pool* pool) {
+    struct _pdf_page_job* job;
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->nworkers; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    while ((job = pool->head) != NULL) {
+        pool->head = job->next;
+        tn5250_buffer_free(&job->content);
+        if (job->deflated != NULL) {
+            free(job->deflated);
+        }
+        free(job);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+    return;
+}
+
+/* Hand the page just finished to the workers.  The contents are moved to
+ * the job rather than copied.
+ */
+static void pdf_pool_submit(Tn5250SCS* This) {
+    struct _pdf_pool* pool = This->data->pool;
+    struct _pdf_page_job* job;
+
+    job = tn5250_new(struct _pdf_page_job, 1);
+    if (job == NULL) {
+        fprintf(stderr, "pdf_pool_submit: Out of memory!\n");
+        exit(1);
+    }
+    job->objnum = This->data->objcount - 1;
+    job->content = This->data->page;
+    tn5250_buffer_init(&This->data->page);
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail != NULL) {
+        pool->tail->next = job;
+    }
+    else {
+        pool->head = job;
+    }
+    pool->tail = job;
+    if (pool->queue == NULL) {
+        pool->queue = job;
+    }
+    pool->pages++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    return;
+}
+
+/* Write out the pages that are done, oldest first, stopping at the first
+ * one that isn't.  With wait set, wait for every page.  Without it, only
+ * wait while there are more than a few pages per thread held in memory.
+ */
+static void pdf_pool_write(Tn5250SCS* This, int wait) {
+    struct _pdf_pool* pool = This->data->pool;
+    struct _pdf_page_job* job;
+    char* text = "\nendstream\n"
+                 "endobj\n\n";
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        job = pool->head;
+        while (job != NULL && !job->done &&
+               (wait || pool->pages > 4 * pool->nworkers)) {
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        if (job == NULL || !job->done) {
+            pthread_mutex_unlock(&pool->lock);
+            return;
+        }
+        pool->head = job->next;
+        if (pool->head == NULL) {
+            pool->tail = NULL;
+        }
+        pool->pages--;
+        pthread_mutex_unlock(&pool->lock);
+
+        /* The same objects pdf_begin_stream(), pdf_end_stream() and
+         * pdf_stream_length() would have written. */
+        array_set(This->data->objectlist, job->objnum - 1,
+                  This->data->filesize);
+        This->data->filesize += pdf_stream_header(This, job->objnum);
+        fwrite(job->deflated, 1, job->deflated_len, This->output);
+        fprintf(This->output, "%s", text);
+        This->data->filesize += job->deflated_len + strlen(text);
+        array_set(This->data->objectlist, job->objnum, This->data->filesize);
+        This->data->filesize +=
+            pdf_stream_length(This, job->objnum + 1, job->deflated_len);
+
+        tn5250_buffer_free(&job->content);
+        free(job->deflated);
+        free(job);
+    }
+}
+
+/* Deflate pages until the pool is stopped.
+ */
+static void* pdf_pool_worker(void* arg) {
+    struct _pdf_pool* pool = (struct _pdf_pool*)arg;
+    struct _pdf_page_job* job;
+    z_stream zs;
+    uLong bound;
+
+    memset(&zs, 0, sizeof(z_stream));
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return NULL;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stop && pool->queue == NULL) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        job = pool->queue;
+        pool->queue = job->next;
+        pthread_mutex_unlock(&pool->lock);
+
+        /* deflateBound() is enough for the whole page in one go. */
+        deflateReset(&zs);
+        bound = deflateBound(&zs, job->content.len);
+        job->deflated = (unsigned char*)malloc(bound);
+        if (job->deflated == NULL) {
+            fprintf(stderr, "pdf_pool_worker: Out of memory!\n");
+            exit(1);
+        }
+        zs.next_in = job->content.data;
+        zs.avail_in = job->content.len;
+        zs.next_out = job->deflated;
+        zs.avail_out = bound;
+        deflate(&zs, Z_FINISH);
+        job->deflated_len = bound - zs.avail_out;
+
+        pthread_mutex_lock(&pool->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    deflateEnd(&zs);
+    return NULL;
+}
+#endif
+
+static expanding_array* array_new(void) {
+    expanding_array* array = NULL;
+
+    array = malloc(sizeof(expanding_array));
+    if (array == NULL) {
+        return NULL;
+    }
+
+    array->data = NULL;
+    array->elems = 0;
+    array->alloc = 0;
+
+    return array;
+}
+
+static void array_append_val(expanding_array* array, int value) {
+    int* newdata;
+
+    array->elems++;
+
+    if (array->elems > array->alloc) {
+        array->alloc += 64;
+        if (array->data == NULL) {
+            array->data = malloc(sizeof(int) * array->alloc);
+        }
+        else {
+            newdata = realloc(array->data, sizeof(int) * array->alloc);
+            if (newdata == NULL) {
+                free(array->data);
+            }
+            array->data = newdata;
+        }
+        if (array->data == NULL) {
+            fprintf(stderr, "array_append_val: Out of memory!\n");
+            exit(1);
+        }
+    }
+
+    array->data[array->elems - 1] = value;
+    return;
+}
+
+static int array_index(expanding_array* array, int idx) {
+    return array->data[idx];
+}
+
+static void array_set(expanding_array* array, int idx, int value) {
+    array->data[idx] = value;
+    return;
+}
+
+static void array_free(expanding_array* array) {
+    if (array->data != NULL) {
+        free(array->data);
+    }
+    free(array);
+    array = NULL;
+    return;
+}
@@ -0,0 +1,349 @@
+/* TN5250 - An implementation of the 5250 telnet protocol.
+ * Copyright (C) 1997-2008 Michael Madore
+ * Converted by Rich Duzenbury from scs2ascii.c (Author Michael Madore)
+ * to this file.
+ *
+ * This file is part of TN5250.
+ *
+ * TN5250 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1, or (at your option)
+ * any later version.
+ *
+ * TN5250 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "tn5250-private.h"
+#include "scs-private.h"
+
+static void scs2ps_pp(Tn5250SCS* This);
+static void scs2ps_cr(Tn5250SCS* This);
+static void scs2ps_nl(Tn5250SCS* This);
+static void scs2ps_ahpp(Tn5250SCS* This);
+static void scs2ps_ff(Tn5250SCS* This);
+static void scs2ps_default(Tn5250SCS* This);
+
+static void scs2ps_jobheader(Tn5250SCS* This);
+static void scs2ps_jobfooter(Tn5250SCS* This);
+static void scs2ps_pageheader(Tn5250SCS* This);
+static void scs2ps_pagefooter(Tn5250SCS* This);
+static void scs2ps_printchar(Tn5250SCS* This, unsigned char curchar);
+static void scs2ps_flush(Tn5250SCS* This);
+static float scs2ps_getx(Tn5250SCS* This);
+static float scs2ps_gety(Tn5250SCS* This);
+
+/* Longest run of characters printed with one show, escapes included. */
+#define SCS2PS_RUN_SIZE 512
+
+/* Spaces to carry in a run before starting a new one is shorter. */
+#define SCS2PS_MAX_GAP 16
+
+struct _Tn5250SCSPrivate {
+    int current_line;
+    int new_line;
+    int mpp;
+    int ccp;
+
+    int mlp;
+    int new_page;
+    int page;
+    int pw;
+    int pl;
+    int tm;
+    int bm;
+    int lm;
+    int rm;
+    int paw;
+    int pal;
+    float palf;
+    float pawf;
+    float mlpf;
+    float mppf;
+    float charwidth;
+    float charheight;
+
+    /* Characters next to each other on a line are collected into a run,
+     * and printed together when the next one isn't next to them. */
+    unsigned char run[SCS2PS_RUN_SIZE];
+    int run_len;    /* Bytes in run, or 0 if there is no run. */
+    int run_line;   /* Line of the run. */
+    int run_next;   /* Column the next character must be in to join it. */
+    int run_spaces; /* Spaces after the run, only added if it goes on. */
+    float run_x;
+    float run_y;
+};
+
+/* This initializes the scs callbacks
+ */
+Tn5250SCS* tn5250_scs2ps_new() {
+    Tn5250SCS* scs = tn5250_scs_new();
+
+    if (scs == NULL) {
+        fprintf(stderr, "Unable to allocate memory in tn5250_scs2ps_new ()!\n");
+        return NULL;
+    }
+
+    scs->data = tn5250_new(struct _Tn5250SCSPrivate, 1);
+    if (scs->data == NULL) {
+        free(scs);
+        return NULL;
+    }
+    scs->map = scs_char_map();
+
+    /* And now set up our callbacks */
+    scs->jobstart = scs2ps_jobheader;
+    scs->jobend = scs2ps_jobfooter;
+    scs->ff = scs2ps_ff;
+    scs->rff = scs2ps_ff;
+    scs->nl = scs2ps_nl;
+    scs->rnl = scs2ps_nl;
+    scs->pp = scs2ps_pp;
+    scs->cr = scs2ps_cr;
+    scs->scsdefault = scs2ps_default;
+    return scs;
+}
+
+static void scs2ps_printchar(Tn5250SCS* This, unsigned char curchar) {
+    struct _Tn5250SCSPrivate* ps = This->data;
+    Tn5250Char printchar;
+
+    printchar = tn5250_char_map_to_local(This->map, curchar);
+
+    if (printchar == ' ') {
+        /* Spaces only take up room, unless they are inside a run. */
+        if (ps->run_len > 0 && ps->ccp == ps->run_next &&
+            ps->current_line == ps->run_line) {
+            ps->run_spaces++;
+            ps->run_next++;
+        }
+        return;
+    }
+
+    if (ps->run_len > 0 &&
+        (ps->ccp != ps->run_next || ps->current_line != ps->run_line ||
+         ps->run_spaces > SCS2PS_MAX_GAP ||
+         ps->run_len + ps->run_spaces + 2 > SCS2PS_RUN_SIZE)) {
+        scs2ps_flush(This);
+    }
+
+    if (ps->run_len == 0) {
+        /* print page header if needed */
+        if (ps->new_page == 1) {
+            scs2ps_pageheader(This);
+            ps->new_page = 0;
+        }
+        ps->run_line = ps->current_line;
+        ps->run_x = scs2ps_getx(This);
+        ps->run_y = scs2ps_gety(This);
+        ps->run_spaces = 0;
+    }
+
+    for (; ps->run_spaces > 0; ps->run_spaces--) {
+        ps->run[ps->run_len++] = ' ';
+    }
+    /* escape any backslash, left paren, right paren */
+    if ((printchar == '\\') || (printchar == '(') || (printchar == ')')) {
+        ps->run[ps->run_len++] = '\\';
+    }
+    ps->run[ps->run_len++] = (unsigned char)printchar;
+    ps->run_next = ps->ccp + 1;
+}
+
+/* Print the run of characters collected so far, if there is one. */
+static void scs2ps_flush(Tn5250SCS* This) {
+    struct _Tn5250SCSPrivate* ps = This->data;
+
+    if (ps->run_len == 0) {
+        return;
+    }
+    fprintf(This->output, "%.2f %.2f (", ps->run_x, ps->run_y);
+    fwrite(ps->run, 1, ps->run_len, This->output);
+    fputs(") s\n", This->output);
+    ps->run_len = 0;
+    ps->run_spaces = 0;
+}
+
+/* Set up the page geometry and write the document prolog.
+ */
+static void scs2ps_jobheader(Tn5250SCS* This) {
+    struct _Tn5250SCSPrivate* ps = This->data;
+    FILE* out = This->output;
+
+    ps->current_line = 1;
+    ps->new_line = 1;
+    ps->new_page = 1;
+    ps->mpp = 132;
+    ps->mlp = 66;
+    ps->ccp = 1;
+    ps->page = 0;
+    ps->run_len = 0;
+
+    ps->tm = 36;  /* top margin in points */
+    ps->lm = 36;  /* left margin in points */
+    ps->rm = 36;  /* right margin in points */
+    ps->bm = 36;  /* bottom margin in points */
+    ps->pw = 612; /* maximum page width in points, 8.5 * 72 */
+    ps->pl = 792; /* maximum page length in points, 11 * 72 */
+
+    /* printable area */
+    ps->paw = ps->pw - ps->lm - ps->rm;
+    ps->pal = ps->pl - ps->tm - ps->bm;
+
+    /* calculate width & height of each character
+     * kluge - can't seem to cast int to float,
+     * (Boy it's been a long time since I coded any C!)
+     * so I just assigned the ints to temporary float vars
+     * This should be fixed!
+     */
+    ps->mppf = ps->mpp;
+    ps->pawf = ps->paw;
+    ps->charwidth = ps->pawf / ps->mppf;
+    ps->mlpf = ps->mlp;
+    ps->palf = ps->pal;
+    ps->charheight = ps->palf / ps->mlpf;
+
+    fprintf(out, "%%!PS-Adobe-3.0\n");
+    fprintf(out, "%%%%Pages: (atend)\n");
+    fprintf(out, "%%%%Title: scs2ps\n");
+    fprintf(out, "%%%%BoundingBox: 0 0 %d %d\n", ps->pw, ps->pl);
+    fprintf(out, "%%%%LanguageLevel: 2\n");
+    fprintf(out, "%%%%EndComments\n\n");
+    fprintf(out, "%%%%BeginProlog\n");
+    fprintf(out, "%%%%BeginResource: procset general 1.1.0\n");
+    fprintf(out, "%%%%Title: (General Procedures)\n");
+    fprintf(out, "%%%%Version: 1.1\n");
+    /* The font is scaled once here, and only selected on each page.  A
+     * character is cw points wide, and dx is added to each one's width
+     * so that a run of them lines up with the columns. */
+    fprintf(out, "/cw %.4f def\n", ps->charwidth);
+    fprintf(out, "/scsfont /Courier findfont [%.2f 0 0 %.2f 0 0] makefont",
+            ps->charwidth, ps->charheight);
+    fprintf(out, " def\n");
+    fprintf(out, "/s { %% x y (string)\n");
+    fprintf(out, "  3 1 roll\n");
+    fprintf(out, "  moveto\n");
+    fprintf(out, "  dx 0 3 -1 roll ashow\n");
+    fprintf(out, "} bind def\n");
+    fprintf(out, "%%%%EndResource\n");
+    fprintf(out, "%%%%EndProlog\n\n");
+}
+
+static void scs2ps_jobfooter(Tn5250SCS* This) {
+    scs2ps_flush(This);
+    fprintf(This->output, "%%%%Trailer\n");
+    fprintf(This->output, "%%%%Pages: %d\n", This->data->page);
+    fprintf(This->output, "%%%%EOF\n");
+}
+
+static void scs2ps_pageheader(Tn5250SCS* This) {
+    struct _Tn5250SCSPrivate* ps = This->data;
+    FILE* out = This->output;
+
+    ps->page++;
+    fprintf(out, "%%%%Page: %d %d\n", ps->page, ps->page);
+    fprintf(out, "%%%%BeginPageSetup\n");
+    fprintf(out, "/pgsave save def\n");
+    fprintf(out, "scsfont setfont\n");
+    fprintf(out, "/dx cw (0) stringwidth pop sub def\n");
+    fprintf(out, "%%%%EndPageSetup\n");
+}
+
+static void scs2ps_pagefooter(Tn5250SCS* This) {
+    fprintf(This->output, "pgsave restore\n");
+    fprintf(This->output, "showpage\n");
+    fprintf(This->output, "%%%%PageTrailer\n");
+}
+
+static float scs2ps_getx(Tn5250SCS* This) {
+    struct _Tn5250SCSPrivate* ps = This->data;
+
+    return ps->lm + (ps->ccp - 1) * ps->charwidth;
+}
+
+static float scs2ps_gety(Tn5250SCS* This) {
+    struct _Tn5250SCSPrivate* ps = This->data;
+
+    return ps->pl - (ps->tm + (ps->current_line * ps->charheight));
+}
+
+static void scs2ps_default(Tn5250SCS* This) {
+    if (This->data->new_line) {
+        This->data->new_line = 0;
+    }
+    scs2ps_printchar(This, This->curchar);
+    This->data->ccp++;
+#ifdef DEBUG
+    fprintf(stderr, ">%x\n", This->curchar);
+#endif
+    return;
+}
+
+static void scs2ps_nl(Tn5250SCS* This) {
+    This->data->new_line = 1;
+    This->data->current_line++;
+    This->data->ccp = 1;
+#ifdef DEBUG
+    fprintf(stderr, "NL\n");
+#endif
+}
+
+static void scs2ps_ff(Tn5250SCS* This) {
+    scs2ps_flush(This);
+    scs2ps_pagefooter(This);
+    This->data->new_page = 1;
+    This->data->current_line = 1;
+    This->data->ccp = 1;
+#ifdef DEBUG
+    fprintf(stderr, "FF\n");
+#endif
+}
+
+static void scs2ps_cr(Tn5250SCS* This) {
+#ifdef DEBUG
+    fprintf(stderr, "CR\n");
+#endif
+    This->data->ccp = 1;
+}
+
+static void scs2ps_pp(Tn5250SCS* This) {
+    unsigned char curchar;
+
+    curchar = scs_getbyte(This);
+    switch (curchar) {
+    case SCS_AVPP: {
+        This->avpp(This);
+        break;
+    }
+    case SCS_AHPP: {
+        scs2ps_ahpp(This);
+        break;
+    }
+    case SCS_RDPP: {
+        This->data->current_line += scs_getbyte(This);
+        break;
+    }
+    case SCS_RRPP: {
+        This->data->ccp += scs_getbyte(This);
+        break;
+    }
+    default: {
+        fprintf(stderr, "ERROR: Unknown 0x34 command %x\n", curchar);
+    }
+    }
+}
+
+static void scs2ps_ahpp(Tn5250SCS* This) {
+    This->data->ccp = scs_getbyte(This);
+#ifdef DEBUG
+    fprintf(stderr, "AHPP %d\n", This->data->ccp);
+#endif
+}
@@ -44,6 +44,9 @@ static void tn5250_session_read_immediate(Tn5250Session* This);
 static void tn5250_session_output_only(Tn5250Session* This);
 static void tn5250_session_save_screen(Tn5250Session* This);
 static void tn5250_session_save_partial_screen(Tn5250Session* This);
+static void tn5250_session_send_saved_screen(Tn5250Session* This);
+static void tn5250_session_keep_saved_screen(Tn5250Session* This);
+static int tn5250_session_restore_saved_screen(Tn5250Session* This);
 static void tn5250_session_roll(Tn5250Session* This);
 static void tn5250_session_start_of_field(Tn5250Session* This);
 static void tn5250_session_start_of_header(Tn5250Session* This);
@@ -52,6 +55,8 @@ static void tn5250_session_write_extended_attribute(Tn5250Session* This);
 static void tn5250_session_write_structured_field(Tn5250Session* This);
 static void tn5250_session_write_display_structured_field(Tn5250Session* This);
 static void tn5250_session_transparent_data(Tn5250Session* This);
+static int tn5250_session_wtd_order_p(unsigned char c);
+static void tn5250_session_write_data(Tn5250Session* This);
 static void tn5250_session_move_cursor(Tn5250Session* This);
 static void tn5250_session_insert_cursor(Tn5250Session* This);
 static void tn5250_session_erase_to_address(Tn5250Session* This);
@@ -95,6 +100,7 @@ static void tn5250_session_write_data_structured_field(Tn5250Session* This,
  *****/
 Tn5250Session* tn5250_session_new() {
     Tn5250Session* This;
+    int i;
 
     This = tn5250_new(Tn5250Session, 1);
     if (This == NULL) {
@@ -112,6 +118,18 @@ Tn5250Session* tn5250_session_new() {
     This->invited = 1;
     This->read_opcode = 0;
 
+    tn5250_buffer_init(&This->save_cache);
+    This->save_cache_wtd_len = 0;
+    This->save_cache_read_opcode = 0;
+    This->save_cache_serial = 0;
+    This->save_cache_generation = 0;
+
+    for (i = 0; i < TN5250_SESSION_SAVED_SCREENS; i++) {
+        This->saved_screens[i].dbuffer = NULL;
+        tn5250_buffer_init(&This->saved_screens[i].data);
+    }
+    This->saved_screen_next = 0;
+
     This->handle_aidkey = tn5250_session_handle_aidkey;
     This->display = NULL;
     return This;
@@ -128,6 +146,8 @@ Tn5250Session* tn5250_session_new() {
  *    DOCUMENT ME!!!
  *****/
 void tn5250_session_destroy(Tn5250Session* This) {
+    int i;
+
     if (This->stream != NULL) {
         tn5250_stream_destroy(This->stream);
         This->stream = NULL;
@@ -140,6 +160,11 @@ void tn5250_session_destroy(Tn5250Session* This) {
         tn5250_config_unref(This->config);
         This->config = NULL;
     }
+    tn5250_buffer_free(&This->save_cache);
+    /* The saved display buffers belong to the display, which frees them. */
+    for (i = 0; i < TN5250_SESSION_SAVED_SCREENS; i++) {
+        tn5250_buffer_free(&This->saved_screens[i].data);
+    }
     free(This);
     return;
 }
@@ -411,14 +436,11 @@ static void tn5250_session_send_fields(Tn5250Session* This, int aidcode) {
 
     case CMD_READ_IMMEDIATE_ALT:
         if (tn5250_dbuffer_send_data_for_aid_key(dbuffer, aidcode)) {
-            field = dbuffer->field_list;
-            if (field != NULL) {
-                do {
-                    if (tn5250_field_mdt(field)) {
-                        tn5250_session_send_field(This, &field_buf, field);
-                    }
-                    field = field->next;
-                } while (field != dbuffer->field_list);
+            field = tn5250_dbuffer_next_mdt_field(dbuffer, NULL);
+            while (field != NULL) {
+                TN5250_ASSERT(tn5250_field_mdt(field));
+                tn5250_session_send_field(This, &field_buf, field);
+                field = tn5250_dbuffer_next_mdt_field(dbuffer, field);
             }
         }
         break;
@@ -629,6 +651,13 @@ static void tn5250_session_process_stream(Tn5250Session* This) {
         cur_command = tn5250_record_get_byte(This->record);
         TN5250_LOG(("ProcessStream: cur_command = 0x%02X\n", cur_command));
 
+        /* Anything but a save may change the display buffer in ways it
+         * doesn't track itself, so make sure a cached save is not reused. */
+        if (cur_command != CMD_SAVE_SCREEN &&
+            cur_command != CMD_SAVE_PARTIAL_SCREEN) {
+            tn5250_dbuffer_touch(tn5250_display_dbuffer(This->display));
+        }
+
         switch (cur_command) {
         case CMD_CLEAR_UNIT:
             tn5250_session_clear_unit(This);
@@ -688,9 +717,12 @@ static void tn5250_session_process_stream(Tn5250Session* This) {
             tn5250_session_save_partial_screen(This);
             break;
         case CMD_RESTORE_SCREEN:
-            /* Ignored, the data following this should be a valid
-             * Write To Display command. */
-            TN5250_LOG(("RestoreScreen (ignored)\n"));
+            /* If this is one of our own saved screens, switch back to it.
+             * Otherwise ignore it, the data following this should be a
+             * valid Write To Display command. */
+            if (!tn5250_session_restore_saved_screen(This)) {
+                TN5250_LOG(("RestoreScreen (ignored)\n"));
+            }
             break;
         case CMD_RESTORE_PARTIAL_SCREEN:
             /* Ignored, the data following this should be a valid
@@ -969,21 +1001,7 @@ static void tn5250_session_write_to_display(Tn5250Session* This) {
             default:
                 if (tn5250_char_map_printable_p(
                         tn5250_display_char_map(This->display), cur_order)) {
-                    tn5250_display_addch(This->display, cur_order);
-#ifndef NDEBUG
-                    if (tn5250_char_map_attribute_p(
-                            tn5250_display_char_map(This->display),
-                            cur_order)) {
-                        TN5250_LOG(("(0x%02X) ", cur_order));
-                    }
-                    else {
-                        TN5250_LOG(("%c (0x%02X) ",
-                                    tn5250_char_map_to_local(
-                                        tn5250_display_char_map(This->display),
-                                        cur_order),
-                                    cur_order));
-                    }
-#endif
+                    tn5250_session_write_data(This);
                 }
                 else {
                     TN5250_LOG(
@@ -1019,6 +1037,82 @@ static void tn5250_session_write_to_display(Tn5250Session* This) {
     return;
 }
 
+/****i* lib5250/tn5250_session_wtd_order_p
+ * NAME
+ *    tn5250_session_wtd_order_p
+ * SYNOPSIS
+ *    if (tn5250_session_wtd_order_p (c))
+ *       ;
+ * INPUTS
+ *    unsigned char        c          -
+ * DESCRIPTION
+ *    Returns 1 if c starts an order (or ends the Write To Display command)
+ *    when it appears in Write To Display data, and 0 if it's display data.
+ *****/
+static int tn5250_session_wtd_order_p(unsigned char c) {
+    switch (c) {
+    case ESC:
+    case SOH:
+    case RA:
+    case EA:
+    case TD:
+    case SBA:
+    case WEA:
+    case IC:
+    case MC:
+    case WDSF:
+    case SF:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/****i* lib5250/tn5250_session_write_data
+ * NAME
+ *    tn5250_session_write_data
+ * SYNOPSIS
+ *    tn5250_session_write_data (This);
+ * INPUTS
+ *    Tn5250Session *      This       -
+ * DESCRIPTION
+ *    Write the display data starting at the byte we just read, up to the
+ *    next order or the end of the record, to the display buffer in one go.
+ *    Full-screen writes from the host are mostly long runs of data, so
+ *    this saves a trip through the order switch for every character.
+ *****/
+static void tn5250_session_write_data(Tn5250Session* This) {
+    Tn5250CharMap* map = tn5250_display_char_map(This->display);
+    unsigned char* data = tn5250_record_data(This->record);
+    int len = tn5250_record_length(This->record);
+    int start = This->record->cur_pos - 1;
+    int end = start + 1;
+
+    while (end < len && !tn5250_session_wtd_order_p(data[end]) &&
+           tn5250_char_map_printable_p(map, data[end])) {
+        end++;
+    }
+
+    tn5250_display_addstr(This->display, data + start, end - start);
+    tn5250_record_set_cur_pos(This->record, end);
+
+#ifndef NDEBUG
+    if (tn5250_logfile != NULL) {
+        int i;
+        for (i = start; i < end; i++) {
+            if (tn5250_char_map_attribute_p(map, data[i])) {
+                TN5250_LOG(("(0x%02X) ", data[i]));
+            }
+            else {
+                TN5250_LOG(("%c (0x%02X) ",
+                            tn5250_char_map_to_local(map, data[i]), data[i]));
+            }
+        }
+    }
+#endif
+    return;
+}
+
 /****i* lib5250/tn5250_session_handle_cc2
  * NAME
  *    tn5250_session_handle_cc2
@@ -1375,34 +1469,197 @@ static void tn5250_session_output_only(Tn5250Session* This) {
  *    DOCUMENT ME!!!
  *****/
 static void tn5250_session_save_screen(Tn5250Session* This) {
-    Tn5250Buffer buffer;
-    StreamHeader header;
-
     TN5250_LOG(("SaveScreen: entered.\n"));
 
-    tn5250_buffer_init(&buffer);
-    tn5250_display_make_wtd_data(This->display, &buffer, NULL);
+    tn5250_session_send_saved_screen(This);
+    return;
+}
+
+/****i* lib5250/tn5250_session_send_saved_screen
+ * NAME
+ *    tn5250_session_send_saved_screen
+ * SYNOPSIS
+ *    tn5250_session_send_saved_screen (This);
+ * INPUTS
+ *    Tn5250Session *      This       -
+ * DESCRIPTION
+ *    Send the host a WTD data stream which will restore the current
+ *    display.  The response is kept in This->save_cache, and if the
+ *    display buffer has not changed since it was made it is sent again
+ *    as it is rather than being regenerated.
+ *****/
+static void tn5250_session_send_saved_screen(Tn5250Session* This) {
+    Tn5250DBuffer* dbuffer = tn5250_display_dbuffer(This->display);
+    StreamHeader header;
+
+    if (This->save_cache_serial != tn5250_dbuffer_serial(dbuffer) ||
+        This->save_cache_generation != tn5250_dbuffer_generation(dbuffer)) {
+        This->save_cache.len = 0;
+        tn5250_display_make_wtd_data(This->display, &This->save_cache, NULL);
+        This->save_cache_wtd_len = tn5250_buffer_length(&This->save_cache);
+        This->save_cache_read_opcode = 0;
+        This->save_cache_serial = tn5250_dbuffer_serial(dbuffer);
+        This->save_cache_generation = tn5250_dbuffer_generation(dbuffer);
+        tn5250_session_keep_saved_screen(This);
+    }
+    else {
+        TN5250_LOG(("SaveScreen: display unchanged, reusing last save.\n"));
+    }
 
     /* Okay, now if we were in a Read MDT Fields or a Read Input Fields,
      * we need to append a command which would put us back in the appropriate
      * read. */
-    if (This->read_opcode != 0) {
-        tn5250_buffer_append_byte(&buffer, ESC);
-        tn5250_buffer_append_byte(&buffer, This->read_opcode);
-        tn5250_buffer_append_byte(&buffer, 0x00); /* FIXME: ? CC1 */
-        tn5250_buffer_append_byte(&buffer, 0x00); /* FIXME: ? CC2 */
+    if (This->save_cache_read_opcode != This->read_opcode) {
+        This->save_cache.len = This->save_cache_wtd_len;
+        if (This->read_opcode != 0) {
+            tn5250_buffer_append_byte(&This->save_cache, ESC);
+            tn5250_buffer_append_byte(&This->save_cache, This->read_opcode);
+            tn5250_buffer_append_byte(&This->save_cache, 0x00); /* FIXME: CC1 */
+            tn5250_buffer_append_byte(&This->save_cache, 0x00); /* FIXME: CC2 */
+        }
+        This->save_cache_read_opcode = This->read_opcode;
     }
 
     header.flowtype = TN5250_RECORD_FLOW_DISPLAY;
     header.flags = TN5250_RECORD_H_NONE;
     header.opcode = TN5250_RECORD_OPCODE_SAVE_SCR;
 
-    tn5250_stream_send_packet(This->stream, tn5250_buffer_length(&buffer),
-                              header, tn5250_buffer_data(&buffer));
-    tn5250_buffer_free(&buffer);
+    tn5250_stream_send_packet(This->stream,
+                              tn5250_buffer_length(&This->save_cache), header,
+                              tn5250_buffer_data(&This->save_cache));
     return;
 }
 
+/****i* lib5250/tn5250_session_keep_saved_screen
+ * NAME
+ *    tn5250_session_keep_saved_screen
+ * SYNOPSIS
+ *    tn5250_session_keep_saved_screen (This);
+ * INPUTS
+ *    Tn5250Session *      This       -
+ * DESCRIPTION
+ *    Put a copy of the current display buffer aside along with the WTD
+ *    data just generated for it in This->save_cache, replacing the oldest
+ *    one we kept.  Screens with windows, menu bars or scroll bars are not
+ *    kept, since restoring those has to go through the terminal.
+ *****/
+static void tn5250_session_keep_saved_screen(Tn5250Session* This) {
+    Tn5250DBuffer* dbuffer = tn5250_display_dbuffer(This->display);
+    int n = This->saved_screen_next;
+
+    if (dbuffer->window_count > 0 || dbuffer->menubar_count > 0 ||
+        dbuffer->scrollbar_count > 0) {
+        return;
+    }
+
+    if (This->saved_screens[n].dbuffer != NULL) {
+        tn5250_display_discard_dbuffer(This->display,
+                                       This->saved_screens[n].dbuffer);
+    }
+    This->saved_screens[n].dbuffer =
+        tn5250_display_push_dbuffer(This->display);
+    This->saved_screens[n].data.len = 0;
+    if (This->saved_screens[n].dbuffer != NULL) {
+        tn5250_buffer_append_data(&This->saved_screens[n].data,
+                                  tn5250_buffer_data(&This->save_cache),
+                                  This->save_cache_wtd_len);
+    }
+    This->saved_screen_next = (n + 1) % TN5250_SESSION_SAVED_SCREENS;
+    return;
+}
+
+/****i* lib5250/tn5250_session_restore_saved_screen
+ * NAME
+ *    tn5250_session_restore_saved_screen
+ * SYNOPSIS
+ *    if (tn5250_session_restore_saved_screen (This))
+ *       ;
+ * INPUTS
+ *    Tn5250Session *      This       -
+ * DESCRIPTION
+ *    Called just after the Restore Screen command.  If the rest of the
+ *    record starts with the WTD data of one of our kept screens, do what
+ *    the Clear Unit and Write To Display in it would do by switching to
+ *    the kept display buffer, skip over that data and return 1.
+ *    Otherwise return 0 and leave the record alone so the data is parsed.
+ *****/
+static int tn5250_session_restore_saved_screen(Tn5250Session* This) {
+    Tn5250DBuffer* dbuffer;
+    Tn5250Buffer* saved;
+    unsigned char* data;
+    unsigned char CC1, CC2;
+    int start, length, i;
+
+    if (tn5250_record_opcode(This->record) !=
+        TN5250_RECORD_OPCODE_RESTORE_SCR) {
+        return 0;
+    }
+
+    /* Our WTD data starts with the Restore Screen command itself. */
+    start = This->record->cur_pos - 2;
+    data = tn5250_record_data(This->record) + start;
+    length = tn5250_record_length(This->record) - start;
+
+    for (i = 0; i < TN5250_SESSION_SAVED_SCREENS; i++) {
+        saved = &This->saved_screens[i].data;
+        if (This->saved_screens[i].dbuffer != NULL &&
+            tn5250_buffer_length(saved) <= length &&
+            memcmp(tn5250_buffer_data(saved), data,
+                   tn5250_buffer_length(saved)) == 0) {
+            break;
+        }
+    }
+    if (i == TN5250_SESSION_SAVED_SCREENS) {
+        return 0;
+    }
+
+    TN5250_LOG(("RestoreScreen: switching to saved display buffer.\n"));
+
+    /* ESC, Clear Unit or Clear Unit Alternate, as written by
+     * tn5250_wtd_context_convert. */
+    tn5250_record_get_byte(This->record);
+    if (tn5250_record_get_byte(This->record) == CMD_CLEAR_UNIT_ALTERNATE) {
+        tn5250_session_clear_unit_alternate(This);
+    }
+    else {
+        tn5250_session_clear_unit(This);
+    }
+
+    /* ESC, Write To Display, CC1, CC2. */
+    tn5250_record_get_byte(This->record);
+    tn5250_record_get_byte(This->record);
+    CC1 = tn5250_record_get_byte(This->record);
+    CC2 = tn5250_record_get_byte(This->record);
+    tn5250_session_handle_cc1(This, CC1);
+
+    if (tn5250_display_restore_dbuffer(This->display,
+                                       This->saved_screens[i].dbuffer) == -1) {
+        /* Not ours any more, so parse the screen after all. */
+        This->saved_screens[i].dbuffer = NULL;
+        tn5250_record_set_cur_pos(This->record, start + 2);
+        return 0;
+    }
+    This->saved_screens[i].dbuffer = NULL;
+    dbuffer = tn5250_display_dbuffer(This->display);
+    tn5250_dbuffer_touch(dbuffer);
+
+    /* The fields come back with their MDT bits, but SF orders don't set
+     * the master MDT, so don't let this path set it either. */
+    dbuffer->master_mdt = 0;
+
+    /* The IC order put the cursor back where it was, and a Restore Screen
+     * sends the cursor home. */
+    tn5250_display_set_pending_insert(This->display,
+                                      tn5250_display_cursor_y(This->display),
+                                      tn5250_display_cursor_x(This->display));
+    tn5250_display_set_cursor_home(This->display);
+    tn5250_session_handle_cc2(This, CC2);
+
+    tn5250_record_set_cur_pos(This->record,
+                              start + tn5250_buffer_length(saved));
+    return 1;
+}
+
 /****i* lib5250/tn5250_session_save_partial_screen
  * NAME
  *    tn5250_session_save_partial_screen
@@ -1414,8 +1671,6 @@ static void tn5250_session_save_screen(Tn5250Session* This) {
  *    DOCUMENT ME!!!
  *****/
 static void tn5250_session_save_partial_screen(Tn5250Session* This) {
-    Tn5250Buffer buffer;
-    StreamHeader header;
     unsigned char flagbyte;
     int toprow, leftcol, windepth, winwidth;
 
@@ -1427,26 +1682,8 @@ static void tn5250_session_save_partial_screen(Tn5250Session* This) {
     windepth = tn5250_record_get_byte(This->record);
     winwidth = tn5250_record_get_byte(This->record);
 
-    tn5250_buffer_init(&buffer);
-    tn5250_display_make_wtd_data(This->display, &buffer, NULL);
-
-    /* Okay, now if we were in a Read MDT Fields or a Read Input Fields,
-     * we need to append a command which would put us back in the appropriate
-     * read. */
-    if (This->read_opcode != 0) {
-        tn5250_buffer_append_byte(&buffer, ESC);
-        tn5250_buffer_append_byte(&buffer, This->read_opcode);
-        tn5250_buffer_append_byte(&buffer, 0x00); /* FIXME: ? CC1 */
-        tn5250_buffer_append_byte(&buffer, 0x00); /* FIXME: ? CC2 */
-    }
-
-    header.flowtype = TN5250_RECORD_FLOW_DISPLAY;
-    header.flags = TN5250_RECORD_H_NONE;
-    header.opcode = TN5250_RECORD_OPCODE_SAVE_SCR;
-
-    tn5250_stream_send_packet(This->stream, tn5250_buffer_length(&buffer),
-                              header, tn5250_buffer_data(&buffer));
-    tn5250_buffer_free(&buffer);
+    /* We save the whole screen, which restores the partial screen too. */
+    tn5250_session_send_saved_screen(This);
     return;
 }
 
@@ -1500,6 +1737,7 @@ static void tn5250_session_start_of_field(Tn5250Session* This) {
     int Y, X;
     /* int done, curpos; */
     Tn5250Field* field;
+    Tn5250Field* added;
     unsigned char FFW1, FFW2, FCW1, FCW2;
     Tn5250Uint16 FCW;
     unsigned char Attr;
@@ -1720,6 +1958,8 @@ static void tn5250_session_start_of_field(Tn5250Session* This) {
                 tn5250_field_start_row(field) == Y) {
                 field->FFW = (FFW1 << 8) | FFW2;
                 field->attribute = Attr;
+                tn5250_dbuffer_update_mdt(
+                    tn5250_display_dbuffer(This->display), field);
             }
         }
         else {
@@ -1754,8 +1994,12 @@ static void tn5250_session_start_of_field(Tn5250Session* This) {
             field->start_row = Y;
             field->start_col = X;
 
-            tn5250_dbuffer_add_field(tn5250_display_dbuffer(This->display),
-                                     field);
+            added = tn5250_dbuffer_add_field_copy(
+                tn5250_display_dbuffer(This->display), field);
+            tn5250_field_destroy(field);
+            if ((field = added) == NULL) {
+                return;
+            }
         }
     }
     else {
@@ -1991,6 +2235,7 @@ static void tn5250_session_transparent_data(Tn5250Session* This) {
     int curx;
     int cury;
     int end;
+    int avail;
     int errorcode;
 
     width = tn5250_display_width(This->display);
@@ -2013,11 +2258,16 @@ static void tn5250_session_transparent_data(Tn5250Session* This) {
         return;
     }
 
-    while (td_len > 0) {
-        l1 = tn5250_record_get_byte(This->record);
-        tn5250_display_addch(This->display, l1);
-        td_len--;
+    /* Don't run off the end of a short record. */
+    avail = tn5250_record_length(This->record) - This->record->cur_pos;
+    if (td_len > (unsigned)avail) {
+        td_len = avail;
     }
+    tn5250_display_addstr(This->display,
+                          tn5250_record_data(This->record) +
+                              This->record->cur_pos,
+                          td_len);
+    tn5250_record_set_cur_pos(This->record, This->record->cur_pos + td_len);
     return;
 }
 
@@ -2194,16 +2444,8 @@ static void tn5250_session_repeat_to_address(Tn5250Session* This) {
         return;
     }
 
-    while (1) {
-        y = tn5250_display_cursor_y(This->display);
-        x = tn5250_display_cursor_x(This->display);
-
-        tn5250_display_addch(This->display, temp[2]);
-
-        if (y == temp[0] - 1 && x == temp[1] - 1) {
-            break;
-        }
-    }
+    /* start and end are both one-based, and the end is included. */
+    tn5250_display_repeat(This->display, temp[2], end - start + 1);
     return;
 }
 
@@ -81,7 +81,11 @@ extern "C" {
 
 #define TN5250_SESSION_KB_SIZE 100
 
+/* How many saved screens we remember for Restore Screen. */
+#define TN5250_SESSION_SAVED_SCREENS 4
+
 struct _Tn5250Display;
+struct _Tn5250DBuffer;
 struct _Tn5250Config;
 
 /****s* lib5250/Tn5250Session
@@ -108,6 +112,23 @@ struct _Tn5250Session {
     struct _Tn5250Config* config;
     int read_opcode; /* Current read opcode. */
     int invited;
+
+    /* The last Save Screen response we sent.  It is sent again as long as
+     * the display buffer's serial and generation still match. */
+    Tn5250Buffer save_cache;
+    int save_cache_wtd_len;
+    int save_cache_read_opcode;
+    unsigned long save_cache_serial;
+    unsigned long save_cache_generation;
+
+    /* Display buffers put aside when we answered a Save Screen, with the
+     * WTD data we sent for each.  When a Restore Screen brings the same
+     * data back we switch to the buffer instead of parsing it again. */
+    struct {
+        struct _Tn5250DBuffer* dbuffer;
+        Tn5250Buffer data;
+    } saved_screens[TN5250_SESSION_SAVED_SCREENS];
+    int saved_screen_next;
 };
 
 typedef struct _Tn5250Session Tn5250Session;
@@ -122,10 +122,6 @@ static const UCHAR SB_Str_TermType[] = {
     IAC, SB, TERMINAL_TYPE, SEND, IAC, SE
 };
 
-/* FIXME: This should be added to Tn5250Stream structure, or something
-    else better than this :) */
-int errnum;
-
 #ifdef NDEBUG
 #define IACVERB_LOG(tag, verb, what)
 #define TNSB_LOG(sb_buf, sb_len)
@@ -167,12 +163,14 @@ static char* ssl_getTelOpt(unsigned char what) {
 static void ssl_log_error_stack(void) {
     FILE* errfp = tn5250_logfile ? tn5250_logfile : stderr;
 
+    tn5250_log_flush();
     ERR_print_errors_fp(errfp);
 }
 
 static void ssl_logError(char* tag, int ecode) {
     FILE* errfp = tn5250_logfile ? tn5250_logfile : stderr;
 
+    tn5250_log_flush();
     fprintf(errfp, "%s: ERROR (code=%d) - %s\n", tag, ecode, strerror(ecode));
 }
 
@@ -182,6 +180,7 @@ static void ssl_log_IAC_verb(char* tag, int verb, int what) {
     if (!tn5250_logfile) {
         return;
     }
+    tn5250_log_flush();
     switch (verb) {
     case DO:
         vcp = "<DO>";
@@ -269,6 +268,7 @@ static void ssl_log_SB_buf(unsigned char* buf, int len) {
     if (!tn5250_logfile) {
         return;
     }
+    tn5250_log_flush();
     fprintf(tn5250_logfile, "%s", ssl_getTelOpt(type = *buf++));
     switch (c = *buf++) {
     case IS:
@@ -452,7 +452,7 @@ static int ssl_stream_connect(Tn5250Stream* This, const char* to) {
     int ioctlarg = 1;
     // Should hold a hostname + :port/service name
     char address[512], *host, *port;
-    int r;
+    int r, errnum;
     X509* server_cert;
     long certvfy;
 
@@ -669,7 +669,7 @@ static void ssl_stream_destroy(Tn5250Stream* This) { /* noop */
 static int ssl_stream_get_next(Tn5250Stream* This, unsigned char* buf,
                                int size) {
 
-    int rc;
+    int rc, errnum;
     fd_set wrwait;
 
     /*  read data.
@@ -724,7 +724,7 @@ static int ssl_sendWill(Tn5250Stream* This, unsigned char what) {
 static void ssl_stream_do_verb(Tn5250Stream* This, unsigned char verb,
                                unsigned char what) {
     unsigned char reply[3];
-    int ret;
+    int ret, errnum;
 
     IACVERB_LOG("GotVerb(2)", verb, what);
     reply[0] = IAC;
@@ -819,7 +819,7 @@ static void ssl_stream_sb_var_value(Tn5250Buffer* buf, unsigned char* var,
 static void ssl_stream_sb(Tn5250Stream* This, unsigned char* sb_buf,
                           int sb_len) {
     Tn5250Buffer out_buf;
-    int ret;
+    int ret, errnum;
 
     TN5250_LOG(("GotSB:<IAC><SB>"));
     TNSB_LOG(sb_buf, sb_len);
@@ -1031,7 +1031,7 @@ static int ssl_stream_get_byte(Tn5250Stream* This) {
  *****/
 static void ssl_stream_write(Tn5250Stream* This, unsigned char* data,
                              int size) {
-    int r;
+    int r, errnum;
     fd_set fdw;
 
     while (size > 0) {
@@ -309,3 +309,29 @@ void tn5250_stream_unsetenv(Tn5250Stream* This, const char* name) {
 int tn5250_stream_socket_handle(Tn5250Stream* This) {
     return (int)This->sockfd;
 }
+
+/****f* lib5250/tn5250_stream_pending
+ * NAME
+ *    tn5250_stream_pending
+ * SYNOPSIS
+ *    ret = tn5250_stream_pending (This);
+ * INPUTS
+ *    Tn5250Stream *       This       -
+ * DESCRIPTION
+ *    Return non-zero if data has been received from the host which the
+ *    stream is holding and hasn't handed over yet, either in its own
+ *    receive buffer or, for an SSL stream, decrypted in the SSL layer.
+ *    Such data won't make the socket readable, so callers which select()
+ *    on the socket should ask this first.
+ *****/
+int tn5250_stream_pending(Tn5250Stream* This) {
+    if (This->rcvbufpos + 1 < This->rcvbuflen) {
+        return 1;
+    }
+#ifdef HAVE_LIBSSL
+    if (This->ssl_handle != NULL && SSL_pending(This->ssl_handle) > 0) {
+        return 1;
+    }
+#endif
+    return 0;
+}
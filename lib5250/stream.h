@@ -87,6 +87,7 @@ tn5250_stream_getenv(Tn5250Stream* This, const char* name);
 
 #define tn5250_stream_record_count(This) ((This)->record_count)
 extern int tn5250_stream_socket_handle(Tn5250Stream* This);
+extern int tn5250_stream_pending(Tn5250Stream* This);
 
 #ifdef __cplusplus
 }
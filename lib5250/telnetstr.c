@@ -157,6 +157,7 @@ static char* getTelOpt(unsigned char what) {
 static void logError(char* tag, int ecode) {
     FILE* errfp = tn5250_logfile ? tn5250_logfile : stderr;
 
+    tn5250_log_flush();
     fprintf(errfp, "%s: ERROR (code=%d) - %s\n", tag, ecode, strerror(ecode));
 }
 
@@ -166,6 +167,7 @@ static void log_IAC_verb(char* tag, int verb, int what) {
     if (!tn5250_logfile) {
         return;
     }
+    tn5250_log_flush();
     switch (verb) {
     case DO:
         vcp = "<DO>";
@@ -253,6 +255,7 @@ static void log_SB_buf(unsigned char* buf, int len) {
     if (!tn5250_logfile) {
         return;
     }
+    tn5250_log_flush();
     fprintf(tn5250_logfile, "%s", getTelOpt(type = *buf++));
     switch (c = *buf++) {
     case IS:
@@ -74,6 +74,7 @@
 #include "codes5250.h"
 #include "scrollbar.h"
 #include "session.h"
+#include "printpipe.h"
 #include "printsession.h"
 #include "display.h"
 #include "macro.h"
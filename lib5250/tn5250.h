@@ -44,6 +44,7 @@ extern "C" {
 
 #include <tn5250/terminal.h>
 #include <tn5250/session.h>
+#include <tn5250/printpipe.h>
 #include <tn5250/printsession.h>
 #include <tn5250/debug.h>
 
@@ -151,7 +151,17 @@ int tn5250_daemon(int nochdir, int noclose, int ignsigcld) {
 
 #endif /* ifndef _WIN32 */
 
-static struct {
+/* The last error is kept for each thread, so that threads opening
+ * streams at the same time, like lp5250d's connector threads, don't see
+ * each other's errors.  Compilers older than C11 get one for the process.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define TN5250_THREAD_LOCAL _Thread_local
+#else
+#define TN5250_THREAD_LOCAL
+#endif
+
+static TN5250_THREAD_LOCAL struct {
     Tn5250ErrorType type;
     unsigned long code; // for compat with OpenSSL
 } tn5250_error;
@@ -378,6 +388,690 @@ int tn5250_char_map_attribute_p(Tn5250CharMap* map, Tn5250Char data) {
 #ifndef NDEBUG
 FILE* tn5250_logfile = NULL;
 
+/* The asynchronous trace writer needs POSIX threads and C11 atomics.  On
+ * anything else tn5250_log_set_async() is accepted but the trace is
+ * written synchronously, as it always has been. */
+#if defined(HAVE_PTHREAD_H) && defined(__STDC_VERSION__) &&                    \
+    __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#define TN5250_LOG_ASYNC
+#endif
+
+#ifdef TN5250_LOG_ASYNC
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define LOG_RING_SIZE 512 /* Records per thread, must be a power of two. */
+#define LOG_MAX_ARGS  8
+#define LOG_SPEC_MAX  24
+#define LOG_STR_SIZE  192
+
+enum {
+    LOG_ARG_NONE, /* %% */
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_LDOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+    LOG_ARG_BAD /* Anything we can't capture (%n, %*d, %ls, ...) */
+};
+
+/****is* lib5250/Tn5250LogRecord
+ * NAME
+ *    Tn5250LogRecord
+ * DESCRIPTION
+ *    One captured TN5250_LOG() call.  Format strings passed to TN5250_LOG()
+ *    are always literals, so we keep only the pointer and the raw
+ *    arguments; formatting is done later by the writer thread.  Strings
+ *    are copied into str (truncated if need be), since the caller's buffer
+ *    may be gone by then.  A NULL fmt means that the format couldn't be
+ *    captured and str holds the already formatted text instead.
+ * SOURCE
+ */
+typedef struct _Tn5250LogRecord {
+    const char* fmt;
+    union {
+        int i;
+        long l;
+        long long ll;
+        size_t z;
+        double d;
+        long double ld;
+        const void* p;
+        size_t s; /* Offset of the string in str. */
+    } args[LOG_MAX_ARGS];
+    char str[LOG_STR_SIZE];
+} Tn5250LogRecord;
+/*******/
+
+/****is* lib5250/Tn5250LogRing
+ * NAME
+ *    Tn5250LogRing
+ * DESCRIPTION
+ *    A single-producer, single-consumer ring of trace records.  Each thread
+ *    which logs asynchronously gets its own ring, so producers never
+ *    contend with each other and never take a lock.  The rings are freed
+ *    when the tracefile is closed.
+ * SOURCE
+ */
+typedef struct _Tn5250LogRing {
+    struct _Tn5250LogRing* next;
+    atomic_uint head;        /* Next slot the producer fills. */
+    atomic_uint tail;        /* Next slot the writer drains. */
+    atomic_ulong dropped;    /* Records lost because the ring was full. */
+    unsigned long reported;  /* Drops already noted in the tracefile. */
+    Tn5250LogRecord slots[LOG_RING_SIZE];
+} Tn5250LogRing;
+/*******/
+
+/* States of the writer thread. */
+enum {
+    LOG_DIRECT,  /* No writer thread, everything is written directly. */
+    LOG_QUEUED,  /* The writer is running and takes queued records. */
+    LOG_CLOSING  /* The tracefile is being closed, records are dropped. */
+};
+
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t log_wait_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_work = PTHREAD_COND_INITIALIZER; /* For writer. */
+static pthread_cond_t log_idle = PTHREAD_COND_INITIALIZER; /* For close. */
+static pthread_t log_writer;
+static Tn5250LogRing* log_rings = NULL;
+static atomic_int log_state = LOG_DIRECT;
+static atomic_int log_producers = 0; /* Threads in tn5250_log_printf(). */
+static atomic_uint log_generation = 0; /* Bumped when the rings are freed. */
+static int log_stop = 0; /* Under log_wait_mutex. */
+static _Thread_local int log_async = 0;
+static _Thread_local Tn5250LogRing* log_ring = NULL;
+static _Thread_local unsigned int log_ring_generation = 0;
+
+/****i* lib5250/tn5250_log_scan_spec
+ * NAME
+ *    tn5250_log_scan_spec
+ * SYNOPSIS
+ *    len = tn5250_log_scan_spec (spec, &kind);
+ * INPUTS
+ *    const char *         spec       - Points just past a '%'.
+ *    int *                kind       - Receives the LOG_ARG_* argument type.
+ * DESCRIPTION
+ *    Scan a printf conversion specification and work out which type of
+ *    argument it consumes.  Returns the length of the specification, not
+ *    counting the '%'.
+ *****/
+static int tn5250_log_scan_spec(const char* spec, int* kind) {
+    const char* p = spec;
+    int size = 0; /* 1 = l, 2 = ll, 3 = z/t, 4 = L */
+
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL) {
+        p++;
+    }
+    while (isdigit((unsigned char)*p) || *p == '.') {
+        p++;
+    }
+
+    switch (*p) {
+    case 'h':
+        if (*++p == 'h') {
+            p++;
+        }
+        break;
+    case 'l':
+        size = 1;
+        if (*++p == 'l') {
+            size = 2;
+            p++;
+        }
+        break;
+    case 'z':
+    case 't':
+        size = 3;
+        p++;
+        break;
+    case 'L':
+        size = 4;
+        p++;
+        break;
+    }
+
+    switch (*p) {
+    case 'c':
+        *kind = size == 0 ? LOG_ARG_INT : LOG_ARG_BAD;
+        break;
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        *kind = size == 1   ? LOG_ARG_LONG
+                : size == 2 ? LOG_ARG_LLONG
+                : size == 3 ? LOG_ARG_SIZE
+                            : LOG_ARG_INT;
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        *kind = size == 4 ? LOG_ARG_LDOUBLE : LOG_ARG_DOUBLE;
+        break;
+    case 's':
+        *kind = size == 0 ? LOG_ARG_STR : LOG_ARG_BAD;
+        break;
+    case 'p':
+        *kind = LOG_ARG_PTR;
+        break;
+    case '%':
+        *kind = p == spec ? LOG_ARG_NONE : LOG_ARG_BAD;
+        break;
+    case '\0':
+        *kind = LOG_ARG_BAD;
+        return p - spec;
+    default:
+        *kind = LOG_ARG_BAD;
+        break;
+    }
+    return p + 1 - spec;
+}
+
+/****i* lib5250/tn5250_log_capture
+ * NAME
+ *    tn5250_log_capture
+ * SYNOPSIS
+ *    ok = tn5250_log_capture (rec, fmt, vl);
+ * INPUTS
+ *    Tn5250LogRecord *    rec        -
+ *    const char *         fmt        -
+ *    va_list              vl         -
+ * DESCRIPTION
+ *    Store the format pointer and the raw arguments in a trace record.
+ *    Returns 0 if the format uses something we don't know how to capture,
+ *    in which case the caller should format the record itself.
+ *****/
+static int tn5250_log_capture(Tn5250LogRecord* rec, const char* fmt,
+                              va_list vl) {
+    const char* p;
+    const char* s;
+    size_t used = 0, len;
+    int n = 0, kind, speclen;
+
+    rec->fmt = fmt;
+    for (p = fmt; (p = strchr(p, '%')) != NULL; p += speclen + 1) {
+        speclen = tn5250_log_scan_spec(p + 1, &kind);
+        if (kind == LOG_ARG_NONE) {
+            continue;
+        }
+        if (kind == LOG_ARG_BAD || n == LOG_MAX_ARGS ||
+            speclen + 1 >= LOG_SPEC_MAX) {
+            return 0;
+        }
+
+        switch (kind) {
+        case LOG_ARG_INT:
+            rec->args[n].i = va_arg(vl, int);
+            break;
+        case LOG_ARG_LONG:
+            rec->args[n].l = va_arg(vl, long);
+            break;
+        case LOG_ARG_LLONG:
+            rec->args[n].ll = va_arg(vl, long long);
+            break;
+        case LOG_ARG_SIZE:
+            rec->args[n].z = va_arg(vl, size_t);
+            break;
+        case LOG_ARG_DOUBLE:
+            rec->args[n].d = va_arg(vl, double);
+            break;
+        case LOG_ARG_LDOUBLE:
+            rec->args[n].ld = va_arg(vl, long double);
+            break;
+        case LOG_ARG_PTR:
+            rec->args[n].p = va_arg(vl, const void*);
+            break;
+        case LOG_ARG_STR:
+            if ((s = va_arg(vl, const char*)) == NULL) {
+                s = "(null)";
+            }
+            if (used == sizeof(rec->str)) {
+                /* Out of room, point at the last terminator. */
+                rec->args[n].s = used - 1;
+                break;
+            }
+            len = strlen(s);
+            if (len > sizeof(rec->str) - used - 1) {
+                len = sizeof(rec->str) - used - 1;
+            }
+            memcpy(rec->str + used, s, len);
+            rec->str[used + len] = '\0';
+            rec->args[n].s = used;
+            used += len + 1;
+            break;
+        }
+        n++;
+    }
+    return 1;
+}
+
+/****i* lib5250/tn5250_log_append
+ * NAME
+ *    tn5250_log_append
+ * SYNOPSIS
+ *    tn5250_log_append (out, spec, );
+ * INPUTS
+ *    Tn5250Buffer *       out        -
+ *    const char *         spec       -
+ * DESCRIPTION
+ *    Format one conversion with its argument onto the end of a buffer.
+ *****/
+static void tn5250_log_append(Tn5250Buffer* out, const char* spec, ...) {
+    char text[256];
+    char* big;
+    va_list vl;
+    int len;
+
+    va_start(vl, spec);
+    len = vsnprintf(text, sizeof(text), spec, vl);
+    va_end(vl);
+    if (len < 0) {
+        return;
+    }
+    if (len < (int)sizeof(text)) {
+        tn5250_buffer_append_data(out, (unsigned char*)text, len);
+        return;
+    }
+
+    if ((big = (char*)malloc(len + 1)) == NULL) {
+        return;
+    }
+    va_start(vl, spec);
+    vsnprintf(big, len + 1, spec, vl);
+    va_end(vl);
+    tn5250_buffer_append_data(out, (unsigned char*)big, len);
+    free(big);
+    return;
+}
+
+/****i* lib5250/tn5250_log_write_record
+ * NAME
+ *    tn5250_log_write_record
+ * SYNOPSIS
+ *    tn5250_log_write_record (out, rec);
+ * INPUTS
+ *    Tn5250Buffer *       out        -
+ *    const Tn5250LogRecord * rec     -
+ * DESCRIPTION
+ *    Format a captured trace record onto the end of a buffer.  Literal
+ *    text is copied as-is and each conversion is formatted with its
+ *    argument.
+ *****/
+static void tn5250_log_write_record(Tn5250Buffer* out,
+                                    const Tn5250LogRecord* rec) {
+    const char* p;
+    const char* q;
+    char spec[LOG_SPEC_MAX];
+    int n = 0, kind, len;
+
+    if (rec->fmt == NULL) {
+        tn5250_buffer_append_data(out, (unsigned char*)rec->str,
+                                  strlen(rec->str));
+        return;
+    }
+
+    for (p = rec->fmt; *p != '\0'; p = q) {
+        if (*p != '%') {
+            if ((q = strchr(p, '%')) == NULL) {
+                q = p + strlen(p);
+            }
+            tn5250_buffer_append_data(out, (unsigned char*)p, q - p);
+            continue;
+        }
+
+        len = tn5250_log_scan_spec(p + 1, &kind) + 1;
+        q = p + len;
+        if (kind == LOG_ARG_NONE) {
+            tn5250_buffer_append_byte(out, '%');
+            continue;
+        }
+        memcpy(spec, p, len);
+        spec[len] = '\0';
+
+        switch (kind) {
+        case LOG_ARG_INT:
+            tn5250_log_append(out, spec, rec->args[n].i);
+            break;
+        case LOG_ARG_LONG:
+            tn5250_log_append(out, spec, rec->args[n].l);
+            break;
+        case LOG_ARG_LLONG:
+            tn5250_log_append(out, spec, rec->args[n].ll);
+            break;
+        case LOG_ARG_SIZE:
+            tn5250_log_append(out, spec, rec->args[n].z);
+            break;
+        case LOG_ARG_DOUBLE:
+            tn5250_log_append(out, spec, rec->args[n].d);
+            break;
+        case LOG_ARG_LDOUBLE:
+            tn5250_log_append(out, spec, rec->args[n].ld);
+            break;
+        case LOG_ARG_PTR:
+            tn5250_log_append(out, spec, rec->args[n].p);
+            break;
+        case LOG_ARG_STR:
+            tn5250_log_append(out, spec, rec->str + rec->args[n].s);
+            break;
+        }
+        n++;
+    }
+    return;
+}
+
+/****i* lib5250/tn5250_log_drain
+ * NAME
+ *    tn5250_log_drain
+ * SYNOPSIS
+ *    count = tn5250_log_drain ();
+ * INPUTS
+ *    None
+ * DESCRIPTION
+ *    Write out every record queued in every thread's ring, and note any
+ *    records which were dropped.  Each batch goes to the tracefile in a
+ *    single write, so it can't be split by a thread writing directly.
+ *    Returns the number of records written.
+ *****/
+static int tn5250_log_drain(void) {
+    Tn5250LogRing* ring;
+    Tn5250Buffer out;
+    unsigned int head, tail;
+    unsigned long dropped;
+    int count = 0;
+
+    tn5250_buffer_init(&out);
+    pthread_mutex_lock(&log_mutex);
+    for (ring = log_rings; ring != NULL; ring = ring->next) {
+        tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        while (tail != head) {
+            tn5250_log_write_record(&out,
+                                    &ring->slots[tail & (LOG_RING_SIZE - 1)]);
+            /* Sequentially consistent, to pair with the check in
+             * tn5250_log_enqueue(). */
+            atomic_store(&ring->tail, ++tail);
+            count++;
+        }
+
+        dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != ring->reported) {
+            tn5250_log_append(
+                &out, "\n*** %lu trace records dropped (ring full) ***\n",
+                dropped - ring->reported);
+            ring->reported = dropped;
+            count++;
+        }
+    }
+    if (tn5250_buffer_length(&out) > 0) {
+        fwrite(tn5250_buffer_data(&out), 1, tn5250_buffer_length(&out),
+               tn5250_logfile);
+        fflush(tn5250_logfile);
+    }
+    pthread_mutex_unlock(&log_mutex);
+    tn5250_buffer_free(&out);
+    return count;
+}
+
+/****i* lib5250/tn5250_log_pending
+ * NAME
+ *    tn5250_log_pending
+ * SYNOPSIS
+ *    pending = tn5250_log_pending ();
+ * INPUTS
+ *    None
+ * DESCRIPTION
+ *    Returns non-zero if any thread's ring has records for the writer.
+ *****/
+static int tn5250_log_pending(void) {
+    Tn5250LogRing* ring;
+    int pending = 0;
+
+    pthread_mutex_lock(&log_mutex);
+    for (ring = log_rings; ring != NULL && !pending; ring = ring->next) {
+        pending = atomic_load(&ring->head) != atomic_load(&ring->tail);
+    }
+    pthread_mutex_unlock(&log_mutex);
+    return pending;
+}
+
+/****i* lib5250/tn5250_log_writer_main
+ * NAME
+ *    tn5250_log_writer_main
+ * SYNOPSIS
+ *    pthread_create (&log_writer, NULL, tn5250_log_writer_main, NULL);
+ * INPUTS
+ *    void *               arg        - Unused.
+ * DESCRIPTION
+ *    Body of the background writer thread.  Drains the rings until asked
+ *    to stop, and sleeps on log_work whenever they are all empty.
+ *****/
+static void* tn5250_log_writer_main(void* arg) {
+    int stop;
+
+    do {
+        tn5250_log_drain();
+        pthread_mutex_lock(&log_wait_mutex);
+        while (!log_stop && !tn5250_log_pending()) {
+            pthread_cond_wait(&log_work, &log_wait_mutex);
+        }
+        stop = log_stop;
+        pthread_mutex_unlock(&log_wait_mutex);
+    } while (!stop);
+    tn5250_log_drain();
+    return NULL;
+}
+
+/****i* lib5250/tn5250_log_ring_get
+ * NAME
+ *    tn5250_log_ring_get
+ * SYNOPSIS
+ *    ring = tn5250_log_ring_get ();
+ * INPUTS
+ *    None
+ * DESCRIPTION
+ *    Return the calling thread's ring, creating and registering it the
+ *    first time a thread logs asynchronously, or the first time since the
+ *    rings were last freed.  Returns NULL if we're out of memory.
+ *****/
+static Tn5250LogRing* tn5250_log_ring_get(void) {
+    Tn5250LogRing* ring;
+    unsigned int generation = atomic_load(&log_generation);
+
+    if (log_ring != NULL && log_ring_generation == generation) {
+        return log_ring;
+    }
+    if ((ring = tn5250_new(Tn5250LogRing, 1)) == NULL) {
+        return NULL;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+
+    pthread_mutex_lock(&log_mutex);
+    ring->next = log_rings;
+    log_rings = ring;
+    pthread_mutex_unlock(&log_mutex);
+
+    log_ring = ring;
+    log_ring_generation = generation;
+    return ring;
+}
+
+/****i* lib5250/tn5250_log_start_writer
+ * NAME
+ *    tn5250_log_start_writer
+ * SYNOPSIS
+ *    tn5250_log_start_writer ();
+ * INPUTS
+ *    None
+ * DESCRIPTION
+ *    Start the writer thread, unless it is already running.  This is done
+ *    the first time a record is queued, so that a process in which no
+ *    thread logs asynchronously never has one.
+ *****/
+static void tn5250_log_start_writer(void) {
+    pthread_mutex_lock(&log_mutex);
+    if (atomic_load(&log_state) == LOG_DIRECT && tn5250_logfile != NULL) {
+        log_stop = 0;
+        if (pthread_create(&log_writer, NULL, tn5250_log_writer_main, NULL) ==
+            0) {
+            atomic_store(&log_state, LOG_QUEUED);
+        }
+    }
+    pthread_mutex_unlock(&log_mutex);
+    return;
+}
+
+/****i* lib5250/tn5250_log_stop_writer
+ * NAME
+ *    tn5250_log_stop_writer
+ * SYNOPSIS
+ *    tn5250_log_stop_writer ();
+ * INPUTS
+ *    None
+ * DESCRIPTION
+ *    Stop taking records and wait on log_idle for any thread in the
+ *    middle of logging one.  Then, if the writer is running, have it
+ *    write out everything queued and join it.  Only then are the rings
+ *    freed.  Records logged while this is going on are dropped rather
+ *    than written directly, where they could land ahead of ones still
+ *    queued.  The caller puts
+ *    log_state back to LOG_DIRECT once the tracefile is closed.
+ *****/
+static void tn5250_log_stop_writer(void) {
+    Tn5250LogRing* ring;
+    int state;
+
+    state = atomic_exchange(&log_state, LOG_CLOSING);
+    pthread_mutex_lock(&log_wait_mutex);
+    while (atomic_load(&log_producers) != 0) {
+        pthread_cond_wait(&log_idle, &log_wait_mutex);
+    }
+    if (state == LOG_QUEUED) {
+        log_stop = 1;
+        pthread_cond_signal(&log_work);
+    }
+    pthread_mutex_unlock(&log_wait_mutex);
+    if (state == LOG_QUEUED) {
+        pthread_join(log_writer, NULL);
+    }
+
+    pthread_mutex_lock(&log_mutex);
+    while ((ring = log_rings) != NULL) {
+        log_rings = ring->next;
+        free(ring);
+    }
+    atomic_fetch_add(&log_generation, 1);
+    pthread_mutex_unlock(&log_mutex);
+    return;
+}
+
+/****i* lib5250/tn5250_log_enqueue
+ * NAME
+ *    tn5250_log_enqueue
+ * SYNOPSIS
+ *    ok = tn5250_log_enqueue (fmt, vl);
+ * INPUTS
+ *    const char *         fmt        -
+ *    va_list              vl         -
+ * DESCRIPTION
+ *    Queue a trace record on the calling thread's ring, starting the
+ *    writer if need be, and waking it if it had emptied the ring.  If the
+ *    ring is full the record is dropped and counted.  Returns 0 only if
+ *    we couldn't queue the record, and the caller should log
+ *    synchronously.
+ *****/
+static int tn5250_log_enqueue(const char* fmt, va_list vl) {
+    Tn5250LogRing* ring;
+    Tn5250LogRecord* rec;
+    unsigned int head;
+    va_list args;
+    int state;
+
+    if (atomic_load(&log_state) == LOG_DIRECT) {
+        tn5250_log_start_writer();
+    }
+    if ((state = atomic_load(&log_state)) != LOG_QUEUED ||
+        (ring = tn5250_log_ring_get()) == NULL) {
+        return state == LOG_CLOSING;
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) ==
+        LOG_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return 1;
+    }
+
+    rec = &ring->slots[head & (LOG_RING_SIZE - 1)];
+    va_copy(args, vl);
+    if (!tn5250_log_capture(rec, fmt, args)) {
+        vsnprintf(rec->str, sizeof(rec->str), fmt, vl);
+        rec->fmt = NULL;
+    }
+    va_end(args);
+
+    /* The writer only sleeps once it has found every ring empty, so it
+     * needs waking only if it had caught up with this one.  Both this
+     * store and load are sequentially consistent, as are the writer's
+     * tail store and its check, so that either it sees this record or we
+     * see that it caught up. */
+    atomic_store(&ring->head, head + 1);
+    if (atomic_load(&ring->tail) == head) {
+        pthread_mutex_lock(&log_wait_mutex);
+        pthread_cond_signal(&log_work);
+        pthread_mutex_unlock(&log_wait_mutex);
+    }
+    return 1;
+}
+#endif /* TN5250_LOG_ASYNC */
+
+/****f* lib5250/tn5250_log_set_async
+ * NAME
+ *    tn5250_log_set_async
+ * SYNOPSIS
+ *    old = tn5250_log_set_async (1);
+ * INPUTS
+ *    int                  async      - Non-zero to write asynchronously.
+ * DESCRIPTION
+ *    Select whether TN5250_LOG() calls made by the calling thread are
+ *    written by a background thread.  In that mode TN5250_LOG() only copies
+ *    the format pointer and its arguments into a per-thread ring, which is
+ *    cheap enough to leave tracing on in production.  If a ring fills up,
+ *    records are dropped and the number lost is noted in the tracefile.
+ *
+ *    The setting belongs to the thread, so a program serving several
+ *    sessions from one thread can switch it as it moves between them.
+ *    Switching it off writes out what is queued first, so records stay in
+ *    order.  Returns the previous setting.  On platforms without threads
+ *    this has no effect, and always returns 0.
+ *****/
+int tn5250_log_set_async(int async) {
+#ifdef TN5250_LOG_ASYNC
+    int old = log_async;
+
+    log_async = async != 0;
+    if (old && !log_async && atomic_load(&log_state) == LOG_QUEUED) {
+        tn5250_log_drain();
+    }
+    return old;
+#else
+    return 0;
+#endif
+}
+
 /****f* lib5250/tn5250_log_open
  * NAME
  *    tn5250_log_open
@@ -390,7 +1084,7 @@ FILE* tn5250_logfile = NULL;
  *****/
 void tn5250_log_open(const char* fname) {
     if (tn5250_logfile != NULL) {
-        fclose(tn5250_logfile);
+        tn5250_log_close();
     }
     tn5250_logfile = fopen(fname, "w");
     if (tn5250_logfile == NULL) {
@@ -405,6 +1099,30 @@ void tn5250_log_open(const char* fname) {
     setbuf(tn5250_logfile, NULL);
 }
 
+/****f* lib5250/tn5250_log_flush
+ * NAME
+ *    tn5250_log_flush
+ * SYNOPSIS
+ *    tn5250_log_flush ();
+ * INPUTS
+ *    None
+ * DESCRIPTION
+ *    Write out any trace records still queued for the writer thread.
+ *    Code which writes to tn5250_logfile directly should call this first
+ *    so that its output lands in the right place.
+ *****/
+void tn5250_log_flush(void) {
+#ifdef TN5250_LOG_ASYNC
+    if (atomic_load(&log_state) == LOG_QUEUED) {
+        tn5250_log_drain();
+        return;
+    }
+#endif
+    if (tn5250_logfile != NULL) {
+        fflush(tn5250_logfile);
+    }
+}
+
 /****f* lib5250/tn5250_log_close
  * NAME
  *    tn5250_log_close
@@ -413,13 +1131,21 @@ void tn5250_log_open(const char* fname) {
  * INPUTS
  *    None
  * DESCRIPTION
- *    Close the current tracefile if one is open.
+ *    Close the current tracefile if one is open.  Records still queued
+ *    for the writer thread are written out first, and anything other
+ *    threads log while we're closing is dropped.
  *****/
 void tn5250_log_close() {
+#ifdef TN5250_LOG_ASYNC
+    tn5250_log_stop_writer();
+#endif
     if (tn5250_logfile != NULL) {
         fclose(tn5250_logfile);
         tn5250_logfile = NULL;
     }
+#ifdef TN5250_LOG_ASYNC
+    atomic_store(&log_state, LOG_DIRECT);
+#endif
 }
 
 /****f* lib5250/tn5250_log_printf
@@ -435,11 +1161,29 @@ void tn5250_log_close() {
  *****/
 void tn5250_log_printf(const char* fmt, ...) {
     va_list vl;
+#ifdef TN5250_LOG_ASYNC
+    /* tn5250_log_close() waits for us once it has seen this. */
+    atomic_fetch_add(&log_producers, 1);
+    if (atomic_load(&log_state) != LOG_CLOSING && tn5250_logfile != NULL) {
+        va_start(vl, fmt);
+        if (!log_async || !tn5250_log_enqueue(fmt, vl)) {
+            vfprintf(tn5250_logfile, fmt, vl);
+        }
+        va_end(vl);
+    }
+    if (atomic_fetch_sub(&log_producers, 1) == 1 &&
+        atomic_load(&log_state) == LOG_CLOSING) {
+        pthread_mutex_lock(&log_wait_mutex);
+        pthread_cond_broadcast(&log_idle);
+        pthread_mutex_unlock(&log_wait_mutex);
+    }
+#else
     if (tn5250_logfile != NULL) {
         va_start(vl, fmt);
         vfprintf(tn5250_logfile, fmt, vl);
         va_end(vl);
     }
+#endif
 }
 
 /****f* lib5250/tn5250_log_assert
@@ -462,6 +1206,7 @@ void tn5250_log_assert(int val, char const* expr, char const* file, int line) {
                           line);
         fprintf(stderr, "\nAssertion %s failed at %s, line %d.\n", expr, file,
                 line);
+        tn5250_log_flush();
         abort();
     }
 }
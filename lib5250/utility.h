@@ -88,8 +88,10 @@ int tn5250_char_map_attribute_p(Tn5250CharMap* This, Tn5250Char data);
 
 #define TN5250_MAKESTRING(expr) #expr
 #ifndef NDEBUG
+int tn5250_log_set_async(int async);
 void tn5250_log_open(const char* fname);
 void tn5250_log_printf(const char* fmt, ...);
+void tn5250_log_flush(void);
 void tn5250_log_close(void);
 void tn5250_log_assert(int val, char const* expr, char const* file, int line);
 #define TN5250_LOG(args) tn5250_log_printf args
@@ -25,6 +25,13 @@
  * - We need to generate TD (Transparent Data) orders if needed.
  */
 
+/* A field which gets an SF order, and the display position of the
+ * attribute byte just in front of it, where the order is written. */
+typedef struct _Tn5250WTDMark {
+    int pos;
+    Tn5250Field* field;
+} Tn5250WTDMark;
+
 static void tn5250_wtd_context_putc(Tn5250WTDContext* This, unsigned char c);
 static void tn5250_wtd_context_ra_putc(Tn5250WTDContext* This, unsigned char c);
 static void tn5250_wtd_context_ra_flush(Tn5250WTDContext* This);
@@ -32,6 +39,16 @@ static void tn5250_wtd_context_write_field(Tn5250WTDContext* This,
                                            Tn5250Field* field,
                                            unsigned char attr);
 static void tn5250_wtd_context_convert_nosrc(Tn5250WTDContext* This);
+static Tn5250WTDMark* tn5250_wtd_context_marks(Tn5250WTDContext* This,
+                                               int* count);
+static int tn5250_wtd_context_mark_cmp(const void* a, const void* b);
+static void tn5250_wtd_context_convert_row(Tn5250WTDContext* This,
+                                           Tn5250WTDMark** mark,
+                                           Tn5250WTDMark* marks_end);
+static void tn5250_wtd_context_convert_cells(Tn5250WTDContext* This,
+                                             Tn5250WTDMark** mark,
+                                             Tn5250WTDMark* marks_end);
+static int tn5250_wtd_run_length(const unsigned char* s, int n);
 static Tn5250Field* tn5250_wtd_context_peek_field(Tn5250WTDContext* This);
 static void tn5250_wtd_context_write_cwsf(Tn5250WTDContext* This,
                                           Tn5250Window* window);
@@ -138,13 +155,21 @@ void tn5250_wtd_context_convert(Tn5250WTDContext* This) {
  *    of the format table or display buffer.
  *****/
 static void tn5250_wtd_context_convert_nosrc(Tn5250WTDContext* This) {
-    unsigned char c;
-    Tn5250Field* field;
+    Tn5250WTDMark *marks, *mark, *marks_end;
     Tn5250Window* window;
-    Tn5250Menubar* menubar;
+    int count, w, h, special;
 
     TN5250_LOG(("wtd_context_convert entered.\n"));
 
+    w = tn5250_dbuffer_width(This->dst);
+    h = tn5250_dbuffer_height(This->dst);
+    marks = tn5250_wtd_context_marks(This, &count);
+
+    /* Each display position costs at most one byte, and each field at most
+     * the 14 bytes of its SF order. */
+    tn5250_buffer_reserve(This->buffer, w * h + 14 * (count > 0 ? count : 0) +
+                                            This->dst->header_length + 32);
+
     tn5250_wtd_context_putc(This, ESC);
     tn5250_wtd_context_putc(This, CMD_RESTORE_SCREEN);
 
@@ -185,33 +210,34 @@ static void tn5250_wtd_context_convert_nosrc(Tn5250WTDContext* This) {
     tn5250_wtd_context_putc(This, This->y);
     tn5250_wtd_context_putc(This, This->x);
 
-    for (This->y = 0; This->y < tn5250_dbuffer_height(This->dst); This->y++) {
-        for (This->x = 0; This->x < tn5250_dbuffer_width(This->dst);
-             This->x++) {
-            if ((window = tn5250_window_hit_test(This->dst->window_list,
-                                                 This->x + 1, This->y + 1)) !=
-                NULL) {
-                tn5250_wtd_context_write_cwsf(This, window);
-            }
-            else if ((menubar = tn5250_menubar_hit_test(
-                          This->dst->menubar_list, This->x, This->y)) != NULL) {
-                tn5250_wtd_context_write_dsfsf(This, menubar);
-                This->x = tn5250_dbuffer_width(This->dst);
-            }
-            else {
-                c = tn5250_dbuffer_char_at(This->dst, This->y, This->x);
-                field = tn5250_wtd_context_peek_field(This);
-                if (field != NULL) {
-                    /* Start of a field, write an SF order.  We have to remove
-                     * the last byte we put on the buffer (since its the
-                     * attribute, which is taken care of here. */
-                    tn5250_wtd_context_write_field(This, field, c);
-                }
-                else {
-                    tn5250_wtd_context_ra_putc(This, c);
+    mark = marks;
+    marks_end = marks + count;
+    for (This->y = 0; This->y < h; This->y++) {
+        /* Rows with a window or a menubar on them are done a position at a
+         * time; the rest can be done a run at a time. */
+        special = (tn5250_menubar_hit_test(This->dst->menubar_list, 0,
+                                           This->y) != NULL);
+        if (!special && (window = This->dst->window_list) != NULL) {
+            do {
+                if (window->row == This->y + 1) {
+                    special = 1;
+                    break;
                 }
-            }
+                window = window->next;
+            } while (window != This->dst->window_list);
+        }
+
+        if (special || count < 0) {
+            tn5250_wtd_context_convert_cells(This, count < 0 ? NULL : &mark,
+                                             marks_end);
         }
+        else {
+            tn5250_wtd_context_convert_row(This, &mark, marks_end);
+        }
+    }
+
+    if (marks != NULL) {
+        free(marks);
     }
 
 #ifndef NDEBUG
@@ -220,6 +246,264 @@ static void tn5250_wtd_context_convert_nosrc(Tn5250WTDContext* This) {
     return;
 }
 
+/****i* lib5250/tn5250_wtd_context_marks
+ * NAME
+ *    tn5250_wtd_context_marks
+ * SYNOPSIS
+ *    marks = tn5250_wtd_context_marks (This, &count);
+ * INPUTS
+ *    Tn5250WTDContext *   This       -
+ *    int *                count      - Receives the number of marks.
+ * DESCRIPTION
+ *    Work out where SF orders go, all at once, in display order.  This
+ *    gives the same answers as calling tn5250_wtd_context_peek_field() at
+ *    every position: a field gets an SF order if it is the first field in
+ *    the format table that covers its own starting position.  Sets count
+ *    to -1 if that can't be done (out of memory, or a field of a different
+ *    width to the display) and returns NULL.  The caller frees the result.
+ *****/
+static Tn5250WTDMark* tn5250_wtd_context_marks(Tn5250WTDContext* This,
+                                               int* count) {
+    Tn5250WTDMark* marks;
+    Tn5250Field* iter;
+    unsigned char* covered;
+    int w, h, size, n, start, end;
+
+    *count = 0;
+    if ((iter = This->dst->field_list) == NULL) {
+        return NULL;
+    }
+
+    w = tn5250_dbuffer_width(This->dst);
+    h = tn5250_dbuffer_height(This->dst);
+    size = w * h;
+
+    n = 0;
+    do {
+        n++;
+        iter = iter->next;
+    } while (iter != This->dst->field_list);
+
+    covered = (unsigned char*)calloc(size, 1);
+    marks = (Tn5250WTDMark*)malloc(n * sizeof(Tn5250WTDMark));
+    if (covered == NULL || marks == NULL) {
+        goto fail;
+    }
+
+    n = 0;
+    do {
+        if (iter->w != w) {
+            goto fail;
+        }
+        start = tn5250_field_start_pos(iter);
+        end = tn5250_field_end_pos(iter);
+
+        if (start > 0 && start < size && start <= end &&
+            iter->start_row < h && iter->start_col >= 0 &&
+            iter->start_col < w && !covered[start]) {
+            marks[n].pos = start - 1;
+            marks[n].field = iter;
+            n++;
+        }
+
+        if (start < 0) {
+            start = 0;
+        }
+        if (end >= size) {
+            end = size - 1;
+        }
+        if (start <= end) {
+            memset(covered + start, 1, end - start + 1);
+        }
+        iter = iter->next;
+    } while (iter != This->dst->field_list);
+
+    free(covered);
+    qsort(marks, n, sizeof(Tn5250WTDMark), tn5250_wtd_context_mark_cmp);
+    *count = n;
+    return marks;
+
+fail:
+    if (covered != NULL) {
+        free(covered);
+    }
+    if (marks != NULL) {
+        free(marks);
+    }
+    *count = -1;
+    return NULL;
+}
+
+/****i* lib5250/tn5250_wtd_context_mark_cmp
+ * NAME
+ *    tn5250_wtd_context_mark_cmp
+ * SYNOPSIS
+ *    qsort (marks, n, sizeof (Tn5250WTDMark), tn5250_wtd_context_mark_cmp);
+ * INPUTS
+ *    const void *         a          -
+ *    const void *         b          -
+ * DESCRIPTION
+ *    Order marks by display position.
+ *****/
+static int tn5250_wtd_context_mark_cmp(const void* a, const void* b) {
+    return ((const Tn5250WTDMark*)a)->pos - ((const Tn5250WTDMark*)b)->pos;
+}
+
+/****i* lib5250/tn5250_wtd_context_convert_row
+ * NAME
+ *    tn5250_wtd_context_convert_row
+ * SYNOPSIS
+ *    tn5250_wtd_context_convert_row (This, &mark, marks_end);
+ * INPUTS
+ *    Tn5250WTDContext *   This       -
+ *    Tn5250WTDMark **     mark       - Next SF order to write.
+ *    Tn5250WTDMark *      marks_end  - End of the SF orders.
+ * DESCRIPTION
+ *    Write the row This->y, which has no windows or menubars on it.  The
+ *    characters between SF orders are taken a run of equal bytes at a
+ *    time, and the RA buffer is only flushed when the character changes.
+ *****/
+static void tn5250_wtd_context_convert_row(Tn5250WTDContext* This,
+                                           Tn5250WTDMark** mark,
+                                           Tn5250WTDMark* marks_end) {
+    const unsigned char* row = tn5250_dbuffer_row(This->dst, This->y);
+    int w = tn5250_dbuffer_width(This->dst);
+    int rowpos = This->y * w;
+    int x = 0, limit, n;
+
+    while (x < w) {
+        if (*mark != marks_end && (*mark)->pos < rowpos + w) {
+            limit = (*mark)->pos - rowpos;
+        }
+        else {
+            limit = w;
+        }
+
+        while (x < limit) {
+            n = tn5250_wtd_run_length(row + x, limit - x);
+            if (row[x] != This->ra_char) {
+                This->x = x;
+                tn5250_wtd_context_ra_flush(This);
+                This->ra_char = row[x];
+            }
+            This->ra_count += n;
+            x += n;
+        }
+
+        if (limit < w) {
+            This->x = limit;
+            tn5250_wtd_context_write_field(This, (*mark)->field, row[limit]);
+            (*mark)++;
+            x = limit + 1;
+        }
+    }
+    This->x = w;
+    return;
+}
+
+/****i* lib5250/tn5250_wtd_context_convert_cells
+ * NAME
+ *    tn5250_wtd_context_convert_cells
+ * SYNOPSIS
+ *    tn5250_wtd_context_convert_cells (This, &mark, marks_end);
+ * INPUTS
+ *    Tn5250WTDContext *   This       -
+ *    Tn5250WTDMark **     mark       - Next SF order to write, or NULL to
+ *                                      look fields up as we go.
+ *    Tn5250WTDMark *      marks_end  - End of the SF orders.
+ * DESCRIPTION
+ *    Write the row This->y a position at a time, checking each one for a
+ *    window or a menubar.
+ *****/
+static void tn5250_wtd_context_convert_cells(Tn5250WTDContext* This,
+                                             Tn5250WTDMark** mark,
+                                             Tn5250WTDMark* marks_end) {
+    unsigned char c;
+    Tn5250Field* field;
+    Tn5250Window* window;
+    Tn5250Menubar* menubar;
+    int w = tn5250_dbuffer_width(This->dst);
+    int pos;
+
+    for (This->x = 0; This->x < w; This->x++) {
+        pos = This->y * w + This->x;
+        field = NULL;
+        if (mark != NULL) {
+            while (*mark != marks_end && (*mark)->pos < pos) {
+                (*mark)++;
+            }
+            if (*mark != marks_end && (*mark)->pos == pos) {
+                field = (*mark)->field;
+            }
+        }
+
+        if ((window = tn5250_window_hit_test(This->dst->window_list,
+                                             This->x + 1, This->y + 1)) !=
+            NULL) {
+            tn5250_wtd_context_write_cwsf(This, window);
+        }
+        else if ((menubar = tn5250_menubar_hit_test(This->dst->menubar_list,
+                                                    This->x, This->y)) !=
+                 NULL) {
+            tn5250_wtd_context_write_dsfsf(This, menubar);
+            This->x = w;
+        }
+        else {
+            c = tn5250_dbuffer_char_at(This->dst, This->y, This->x);
+            if (mark == NULL) {
+                field = tn5250_wtd_context_peek_field(This);
+            }
+            if (field != NULL) {
+                /* Start of a field, write an SF order.  We have to remove
+                 * the last byte we put on the buffer (since its the
+                 * attribute, which is taken care of here. */
+                tn5250_wtd_context_write_field(This, field, c);
+            }
+            else {
+                tn5250_wtd_context_ra_putc(This, c);
+            }
+        }
+    }
+
+    /* Skip the SF orders of anything the menubar hid. */
+    if (mark != NULL) {
+        while (*mark != marks_end && (*mark)->pos < (This->y + 1) * w) {
+            (*mark)++;
+        }
+    }
+    return;
+}
+
+/****i* lib5250/tn5250_wtd_run_length
+ * NAME
+ *    tn5250_wtd_run_length
+ * SYNOPSIS
+ *    n = tn5250_wtd_run_length (s, n);
+ * INPUTS
+ *    const unsigned char * s         - Start of the run.
+ *    int                  n          - Bytes available at s.
+ * DESCRIPTION
+ *    Return how many bytes at s are equal to s[0].  A word at a time is
+ *    compared while we can, since screens are mostly long runs of blanks.
+ *****/
+static int tn5250_wtd_run_length(const unsigned char* s, int n) {
+    unsigned long pattern, word;
+    int i = 1;
+
+    pattern = (unsigned long)s[0] * (~0UL / 0xff);
+    while (i + (int)sizeof(unsigned long) <= n) {
+        memcpy(&word, s + i, sizeof(unsigned long));
+        if (word != pattern) {
+            break;
+        }
+        i += sizeof(unsigned long);
+    }
+    while (i < n && s[i] == s[0]) {
+        i++;
+    }
+    return i;
+}
+
 /****i* lib5250/tn5250_wtd_context_peek_field
  * NAME
  *    tn5250_wtd_context_peek_field
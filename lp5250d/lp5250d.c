@@ -22,6 +22,11 @@
 
 #include "tn5250-private.h"
 #include <syslog.h>
+#include <signal.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 /* If getopt.h exists then getopt_long() probably does as well.  If
  * getopt.h doesn't exist (like on Solaris) then we probably need to use
@@ -34,6 +39,65 @@
 
 static void syntax(void);
 
+/* One printer device served by a multi-device lp5250d (see devices= in
+ * tn5250rc(5)).  The counters are carried over from earlier connections,
+ * as each new connection starts a new print session.
+ */
+typedef struct _lp5250d_device {
+    char* name;
+    Tn5250Config* config;
+    Tn5250PrintSession* /*@null@*/ printsess;
+    time_t retry;    /* When to connect again, while disconnected. */
+    int backoff;     /* Seconds to wait after the next failure. */
+    int trace_async; /* Queue this device's trace records. */
+    int connecting;  /* A connector thread is opening a stream. */
+    Tn5250Stream* /*@null@*/ stream; /* The stream it opened, if any. */
+#ifdef HAVE_PTHREAD_H
+    pthread_t connector;
+#endif
+    unsigned long jobs;
+    unsigned long bytes;
+    unsigned long status_bytes; /* bytes when the status was last written */
+} lp5250d_device;
+
+/* Longest wait between attempts to reconnect a device. */
+#define LP5250D_MAX_BACKOFF 300
+
+/* Seconds between updates of the status file. */
+#define LP5250D_STATUS_INTERVAL 10
+
+/* This sets up a print session on a newly opened stream.
+ */
+static void setup_session(Tn5250PrintSession* printsess, Tn5250Stream* stream,
+                          Tn5250Config* config);
+
+/* These run a multi-device lp5250d.
+ */
+static lp5250d_device* load_devices(int argc, char** argv, const char* list,
+                                    int* count);
+static int serve_devices(lp5250d_device* devices, int count,
+                         Tn5250Config* config);
+static void connect_device(lp5250d_device* device, Tn5250PrintPool* pool,
+                           time_t now);
+static void connected_device(lp5250d_device* device, Tn5250Stream* stream,
+                             Tn5250PrintPool* pool, time_t now);
+#ifdef HAVE_PTHREAD_H
+static void* connect_thread(void* arg);
+#endif
+static void disconnect_device(lp5250d_device* device, time_t now);
+static void write_status(const char* filename, lp5250d_device* devices,
+                         int count, time_t now, time_t last);
+static void trace_device(lp5250d_device* device);
+static void request_quit(int sig);
+
+static volatile sig_atomic_t quit = 0;
+
+/* A connector thread writes its device's address here when it is done,
+ * to wake up the event loop.  Devices are connected in the loop itself if
+ * there is no pipe.
+ */
+static int connect_pipe[2] = { -1, -1 };
+
 /* This just checks what arguments (options) were passed to lp5250d on the
  * command line.
  */
@@ -52,6 +116,9 @@ Tn5250Config* config = NULL;
 int main(int argc, char* argv[]) {
     char* user = NULL;
     int nodaemon = 0;
+    lp5250d_device* devices = NULL;
+    int count = 0;
+    int ret;
 
     if (check_options(argc, argv, &user, &nodaemon) != 0) {
         exit(1);
@@ -82,6 +149,14 @@ int main(int argc, char* argv[]) {
         printf("tn5250 version %s\n", version_string);
         exit(0);
     }
+    else if (tn5250_config_get(config, "devices")) {
+        devices = load_devices(argc, argv, tn5250_config_get(config, "devices"),
+                               &count);
+        if (devices == NULL) {
+            tn5250_config_unref(config);
+            exit(1);
+        }
+    }
     else if (!tn5250_config_get(config, "host")) {
         syntax();
     }
@@ -99,6 +174,7 @@ int main(int argc, char* argv[]) {
 
 #ifndef NDEBUG
     if (tn5250_config_get(config, "trace")) {
+        tn5250_log_set_async(tn5250_config_get_bool(config, "trace_async"));
         tn5250_log_open(tn5250_config_get(config, "trace"));
         TN5250_LOG(
             ("lp5250d version %s, built on %s\n", version_string, __DATE__));
@@ -108,6 +184,15 @@ int main(int argc, char* argv[]) {
 
     openlog("lp5250d", LOG_PID, LOG_DAEMON);
 
+    if (devices != NULL) {
+        ret = serve_devices(devices, count, config);
+        tn5250_config_unref(config);
+#ifndef NDEBUG
+        tn5250_log_close();
+#endif
+        return ret;
+    }
+
     stream = tn5250_stream_open(tn5250_config_get(config, "host"), config);
     if (stream == NULL) {
         syslog(LOG_INFO, "Couldn't connect to %s",
@@ -116,6 +201,30 @@ int main(int argc, char* argv[]) {
     }
 
     printsess = tn5250_print_session_new();
+    setup_session(printsess, stream, config);
+
+    tn5250_print_session_main_loop(printsess);
+    if (tn5250_has_error()) {
+        printf("Could not start session: %s\n", tn5250_strerror());
+    }
+
+    tn5250_print_session_destroy(printsess);
+    tn5250_stream_destroy(stream);
+    if (config != NULL) {
+        tn5250_config_unref(config);
+    }
+#ifndef NDEBUG
+    tn5250_log_close();
+#endif
+    return 0;
+}
+
+/* This sets the environment the host sees for a printer device, and tells
+ * the print session how to handle its jobs.  The session takes over the
+ * stream.
+ */
+static void setup_session(Tn5250PrintSession* printsess, Tn5250Stream* stream,
+                          Tn5250Config* config) {
     tn5250_stream_setenv(stream, "TERM", "IBM-3812-1");
     /*    tn5250_stream_setenv(stream, "DEVNAME", sessionname); */
     tn5250_stream_setenv(stream, "IBMFONT", "12");
@@ -146,31 +255,418 @@ int main(int argc, char* argv[]) {
     else {
         tn5250_print_session_set_output_command(printsess, "scs2ascii|lpr");
     }
+    if (tn5250_config_get(config, "spooldir")) {
+        tn5250_print_session_set_spool_dir(
+            printsess, tn5250_config_get(config, "spooldir"));
+    }
+    return;
+}
 
-    tn5250_print_session_main_loop(printsess);
-    if (tn5250_has_error()) {
-        printf("Could not start session: %s\n", tn5250_strerror());
+/* This builds the configuration of each device named in list, which is
+ * separated by commas.  Each device is a group in tn5250rc, and settings
+ * on the command line apply to all of them, unless the group sets them.
+ * Each device spools to a directory of its own under spooldir.
+ */
+static lp5250d_device* load_devices(int argc, char** argv, const char* list,
+                                    int* count) {
+    lp5250d_device* devices;
+    char* names;
+    char* name;
+    int n = 1;
+    const char* p;
+    const char* spooldir;
+
+    for (p = list; *p != '\0'; p++) {
+        if (*p == ',') {
+            n++;
+        }
     }
+    devices = tn5250_new(lp5250d_device, n);
+    names = (char*)malloc(strlen(list) + 1);
+    if (devices == NULL || names == NULL) {
+        printf("Out of memory\n");
+        return NULL;
+    }
+    strcpy(names, list);
 
-    tn5250_print_session_destroy(printsess);
-    tn5250_stream_destroy(stream);
-    if (config != NULL) {
-        tn5250_config_unref(config);
+    *count = 0;
+    for (name = strtok(names, ", "); name != NULL; name = strtok(NULL, ", ")) {
+        lp5250d_device* device = &devices[*count];
+
+        device->name = (char*)malloc(strlen(name) + 1);
+        if (device->name == NULL) {
+            return NULL;
+        }
+        strcpy(device->name, name);
+        device->config = tn5250_config_new();
+        if (tn5250_config_load_default(device->config) == -1 ||
+            tn5250_config_parse_argv(device->config, argc, argv) == -1) {
+            return NULL;
+        }
+        tn5250_config_promote(device->config, name);
+        if (!tn5250_config_get(device->config, "host")) {
+            printf("No host for device %s\n", name);
+            return NULL;
+        }
+        if ((spooldir = tn5250_config_get(device->config, "spooldir"))) {
+            char* dir = (char*)malloc(strlen(spooldir) + strlen(name) + 2);
+
+            if (dir == NULL) {
+                printf("Out of memory\n");
+                return NULL;
+            }
+            sprintf(dir, "%s/%s", spooldir, name);
+            if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+                printf("Can't create %s: %s\n", dir, strerror(errno));
+                return NULL;
+            }
+            tn5250_config_set(device->config, "spooldir", dir);
+            free(dir);
+        }
+        device->backoff = 1;
+        device->trace_async =
+            tn5250_config_get_bool(device->config, "trace_async");
+        (*count)++;
+    }
+    free(names);
+    if (*count == 0) {
+        printf("No devices in devices=%s\n", list);
+        return NULL;
+    }
+    return devices;
+}
+
+/* This serves all the devices from one event loop until we are told to
+ * quit.  Jobs are converted by a pool of converters= threads shared by
+ * all of them, or by the output command if the pool can't be started.
+ * Each device connects on a thread of its own, so that a slow host
+ * doesn't hold up the others.  A device whose converter has fallen
+ * behind isn't read until it catches up, which holds up that device's
+ * host writer rather than filling memory.  A device which can't connect,
+ * or whose connection is closed, is tried again after a delay which
+ * doubles each time, up to LP5250D_MAX_BACKOFF seconds.
+ */
+static int serve_devices(lp5250d_device* devices, int count,
+                         Tn5250Config* config) {
+    Tn5250PrintPool* pool;
+    Tn5250PrintSession* printsess;
+    const char* statusfile = tn5250_config_get(config, "statusfile");
+    time_t now, last_status;
+    struct timeval tv;
+    fd_set fdr;
+    int threads = 4;
+    int maxfd, behind, fd, ret, i;
+
+    if (tn5250_config_get(config, "converters")) {
+        threads = tn5250_config_get_int(config, "converters");
+    }
+    pool = tn5250_print_pool_new(threads);
+    if (pool == NULL) {
+        syslog(LOG_INFO, "Couldn't start converters, using output command");
+    }
+#ifdef HAVE_PTHREAD_H
+    if (pipe(connect_pipe) != 0) {
+        syslog(LOG_INFO, "pipe: %s, connecting devices one at a time",
+               strerror(errno));
+        connect_pipe[0] = connect_pipe[1] = -1;
     }
-#ifndef NDEBUG
-    tn5250_log_close();
 #endif
+
+    for (i = 0; i < count; i++) {
+        syslog(LOG_INFO, "Device %s on %s", devices[i].name,
+               tn5250_config_get(devices[i].config, "host"));
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGTERM, request_quit);
+    signal(SIGINT, request_quit);
+
+    now = last_status = time(NULL);
+    while (!quit) {
+        now = time(NULL);
+        FD_ZERO(&fdr);
+        maxfd = connect_pipe[0];
+        behind = 0;
+        if (connect_pipe[0] != -1) {
+            FD_SET(connect_pipe[0], &fdr);
+        }
+
+        for (i = 0; i < count; i++) {
+            if (devices[i].printsess == NULL && !devices[i].connecting &&
+                now >= devices[i].retry) {
+                trace_device(&devices[i]);
+                connect_device(&devices[i], pool, now);
+            }
+            if ((printsess = devices[i].printsess) == NULL) {
+                continue;
+            }
+            if (printsess->pipe != NULL &&
+                tn5250_print_pipe_capacity(printsess->pipe) > 0 &&
+                tn5250_print_pipe_depth(printsess->pipe) * 2 >=
+                    tn5250_print_pipe_capacity(printsess->pipe)) {
+                behind = 1;
+                continue;
+            }
+            fd = printsess->conn_fd;
+            FD_SET(fd, &fdr);
+            if (fd > maxfd) {
+                maxfd = fd;
+            }
+        }
+
+        /* Wake up now and then to reconnect devices and write the status,
+         * and sooner if a converter is catching up. */
+        tv.tv_sec = behind ? 0 : 1;
+        tv.tv_usec = behind ? 10000 : 0;
+        if (select(maxfd + 1, &fdr, NULL, NULL, &tv) < 0) {
+            if (errno != EINTR) {
+                syslog(LOG_INFO, "select: %s", strerror(errno));
+                break;
+            }
+            continue;
+        }
+
+        now = time(NULL);
+        for (i = 0; i < count; i++) {
+            printsess = devices[i].printsess;
+            if (printsess == NULL || !FD_ISSET(printsess->conn_fd, &fdr)) {
+                continue;
+            }
+            trace_device(&devices[i]);
+            ret = tn5250_print_session_handle_receive(printsess);
+            if (ret != 1) {
+                if (ret == -1) {
+                    syslog(LOG_INFO, "Device %s was not started",
+                           devices[i].name);
+                }
+                disconnect_device(&devices[i], now);
+            }
+            else if (printsess->started) {
+                devices[i].backoff = 1;
+            }
+        }
+
+#ifdef HAVE_PTHREAD_H
+        if (connect_pipe[0] != -1 && FD_ISSET(connect_pipe[0], &fdr)) {
+            lp5250d_device* device;
+
+            if (read(connect_pipe[0], &device, sizeof(device)) ==
+                sizeof(device)) {
+                pthread_join(device->connector, NULL);
+                device->connecting = 0;
+                connected_device(device, device->stream, pool, now);
+                device->stream = NULL;
+            }
+        }
+#endif
+
+        if (statusfile != NULL &&
+            now - last_status >= LP5250D_STATUS_INTERVAL) {
+            write_status(statusfile, devices, count, now, last_status);
+            last_status = now;
+        }
+    }
+
+    syslog(LOG_INFO, "Shutting down");
+    for (i = 0; i < count; i++) {
+#ifdef HAVE_PTHREAD_H
+        if (devices[i].connecting) {
+            pthread_join(devices[i].connector, NULL);
+            if (devices[i].stream != NULL) {
+                tn5250_stream_destroy(devices[i].stream);
+            }
+        }
+#endif
+        if (devices[i].printsess != NULL) {
+            trace_device(&devices[i]);
+            disconnect_device(&devices[i], now);
+        }
+        tn5250_config_unref(devices[i].config);
+        free(devices[i].name);
+    }
+    /* Waits for the converters to finish the jobs they were given. */
+    if (pool != NULL) {
+        tn5250_print_pool_destroy(pool);
+    }
+    if (connect_pipe[0] != -1) {
+        close(connect_pipe[0]);
+        close(connect_pipe[1]);
+    }
+    free(devices);
     return 0;
 }
 
+/* This starts connecting a device.  The connection is opened on a
+ * connector thread, and connected_device() is called from the event loop
+ * once it is done.  Without one, the device is connected here and now.
+ */
+static void connect_device(lp5250d_device* device, Tn5250PrintPool* pool,
+                           time_t now) {
+#ifdef HAVE_PTHREAD_H
+    if (connect_pipe[1] != -1) {
+        device->connecting = 1;
+        device->stream = NULL;
+        if (pthread_create(&device->connector, NULL, connect_thread,
+                           device) == 0) {
+            return;
+        }
+        device->connecting = 0;
+    }
+#endif
+    connected_device(device,
+                     tn5250_stream_open(
+                         tn5250_config_get(device->config, "host"),
+                         device->config),
+                     pool, now);
+    return;
+}
+
+/* This starts a device's print session on the stream opened for it.  If
+ * the connection failed, the device is tried again later.
+ */
+static void connected_device(lp5250d_device* device, Tn5250Stream* stream,
+                             Tn5250PrintPool* pool, time_t now) {
+    if (stream == NULL) {
+        syslog(LOG_INFO, "Couldn't connect %s to %s, retrying in %ds",
+               device->name, tn5250_config_get(device->config, "host"),
+               device->backoff);
+        device->retry = now + device->backoff;
+        device->backoff *= 2;
+        if (device->backoff > LP5250D_MAX_BACKOFF) {
+            device->backoff = LP5250D_MAX_BACKOFF;
+        }
+        return;
+    }
+
+    device->printsess = tn5250_print_session_new();
+    if (pool != NULL) {
+        tn5250_print_session_set_pool(device->printsess, pool);
+    }
+    setup_session(device->printsess, stream, device->config);
+    return;
+}
+
+#ifdef HAVE_PTHREAD_H
+/* This is the connector thread of a device.  It looks up the host and
+ * connects to it, which may take a while, then hands the stream back to
+ * the event loop.
+ */
+static void* connect_thread(void* arg) {
+    lp5250d_device* device = (lp5250d_device*)arg;
+
+    trace_device(device);
+    device->stream = tn5250_stream_open(
+        tn5250_config_get(device->config, "host"), device->config);
+    if (write(connect_pipe[1], &device, sizeof(device)) != sizeof(device)) {
+        syslog(LOG_INFO, "Can't wake up for device %s: %s", device->name,
+               strerror(errno));
+    }
+    return NULL;
+}
+#endif
+
+/* This ends a device's print session, finishing any job in progress, and
+ * arranges to connect it again.
+ */
+static void disconnect_device(lp5250d_device* device, time_t now) {
+    device->jobs += device->printsess->jobs;
+    device->bytes += device->printsess->bytes;
+    tn5250_print_session_destroy(device->printsess);
+    device->printsess = NULL;
+
+    syslog(LOG_INFO, "Device %s disconnected, retrying in %ds", device->name,
+           device->backoff);
+    device->retry = now + device->backoff;
+    device->backoff *= 2;
+    if (device->backoff > LP5250D_MAX_BACKOFF) {
+        device->backoff = LP5250D_MAX_BACKOFF;
+    }
+    return;
+}
+
+/* This writes a line for each device to the status file: its name, state,
+ * the records waiting to be converted, the jobs and bytes printed, and
+ * the bytes per second since the last update.  The file is replaced in
+ * one go, so a reader never sees half of it.
+ */
+static void write_status(const char* filename, lp5250d_device* devices,
+                         int count, time_t now, time_t last) {
+    Tn5250PrintSession* printsess;
+    const char* state;
+    unsigned long jobs, bytes;
+    char* tmpname;
+    FILE* f;
+    int depth, i;
+
+    tmpname = (char*)malloc(strlen(filename) + 5);
+    if (tmpname == NULL) {
+        return;
+    }
+    sprintf(tmpname, "%s.tmp", filename);
+    if ((f = fopen(tmpname, "w")) == NULL) {
+        syslog(LOG_INFO, "Can't write %s: %s", tmpname, strerror(errno));
+        free(tmpname);
+        return;
+    }
+
+    fprintf(f, "# device state depth jobs bytes bytes/s\n");
+    for (i = 0; i < count; i++) {
+        printsess = devices[i].printsess;
+        jobs = devices[i].jobs;
+        bytes = devices[i].bytes;
+        depth = 0;
+        if (printsess == NULL) {
+            state = "down";
+        }
+        else {
+            state = printsess->started ? "up" : "starting";
+            depth = tn5250_print_session_queue_depth(printsess);
+            jobs += printsess->jobs;
+            bytes += printsess->bytes;
+        }
+        fprintf(f, "%s %s %d %lu %lu %lu\n", devices[i].name, state, depth,
+                jobs, bytes,
+                (bytes - devices[i].status_bytes) /
+                    (unsigned long)(now > last ? now - last : 1));
+        devices[i].status_bytes = bytes;
+    }
+
+    if (fclose(f) != 0 || rename(tmpname, filename) != 0) {
+        syslog(LOG_INFO, "Can't write %s: %s", filename, strerror(errno));
+        remove(tmpname);
+    }
+    free(tmpname);
+    return;
+}
+
+/* This makes the trace records written while handling a device queued or
+ * not, as its trace_async setting asks.
+ */
+static void trace_device(lp5250d_device* device) {
+#ifndef NDEBUG
+    tn5250_log_set_async(device->trace_async);
+#endif
+    return;
+}
+
+static void request_quit(int sig) {
+    quit = 1;
+    return;
+}
+
 static void syntax() {
     printf("Usage:  lp5250d [options] host[:port]\n"
+           "        lp5250d [options] devices=NAME,NAME...\n"
            "Options:\n"
            "\ttrace=FILE                 specify FULL path to log file\n"
            "\tmap=NAME                   specify translation map\n"
            "\tenv.DEVNAME=NAME           specify session name\n"
            "\tenv.IBMMFRTYPMDL=NAME      specify host print transform name\n"
            "\toutputcommand=CMD          specify the print output command\n"
+           "\tconverters=N               converter threads shared by all "
+           "devices\n"
+           "\tstatusfile=FILE            write device counters to FILE\n"
+           "\tspooldir=DIR               spool jobs to DIR before printing\n"
            "\t-u,--user=NAME             display user to run as\n"
            "\t-v,--version               display version\n"
            "\t-N,--nodaemon              do not run as daemon (run in "
@@ -184,7 +680,7 @@ static void syntax() {
  */
 int check_options(int argc, char** argv, char** user, int* nodaemon) {
 #ifdef HAVE_GETOPT_H
-    struct option options[4];
+    struct option options[5];
 #endif
     int i;
     extern char* optarg;
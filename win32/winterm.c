@@ -2723,6 +2723,8 @@ void win32_paste_text_selection(HWND hwnd, Tn5250Terminal* term,
         int dump_count = MAX_K_BUF_LEN;
         size = strlen(pNewBuf);
         thisrow = 0;
+        /* Draw the whole paste once rather than after every chunk. */
+        tn5250_display_begin_batch(display);
         for (pos = 0; pos < size; pos++) {
             switch (pNewBuf[pos]) {
             case '\r':
@@ -2748,6 +2750,7 @@ void win32_paste_text_selection(HWND hwnd, Tn5250Terminal* term,
                 tn5250_display_do_keys(display);
             }
         }
+        tn5250_display_end_batch(display);
         free(pNewBuf);
         PostMessage(hwnd, WM_TN5250_KEY_DATA, 0, 0);
     }